@@ -11,11 +11,16 @@
 #include "hardware/clocks.h"
 #include "backscatter.pio.h"
 #include "packet_generation.h"
+#include "low_power.h"
 
 #define TX_DURATION 250 // send a packet every 250ms (when changing baud-rate, ensure that the TX delay is larger than the transmission time)
 #define RECEIVER 1352 // define the receiver board either 2500 or 1352
+#define FRAME_CRC_LEN ((RECEIVER == 2500) ? CRC_LEN : 0) // the CC2500 checks a CRC-16 (PKTCTRL0.CRC_EN), the CC1352 setup expects none
 #define PIN_TX1 6
 #define PIN_TX2 27
+#define LOW_POWER_MODE LOW_POWER_SLEEP // between frames: LOW_POWER_OFF (all clocks running), LOW_POWER_SLEEP or LOW_POWER_SLEEP_PLL_OFF (see low_power.h)
+#define REPORT_INTERVAL 40 // print the power statistics every 40 frames over USB (0: USB is switched off)
+#define FILE_START_POSITION 0 // first file_position (even), e.g. to continue the file after a restart of the tag
 
 int main() {
     PIO pio = pio0;
@@ -25,11 +30,20 @@ int main() {
     //backscatter_program_init(pio, sm, offset, PIN_TX1); // one antenna setup
 
     static uint8_t message[buffer_size(PAYLOADSIZE+2, HEADER_LEN)*4] = {0};  // include 10 header bytes
-    static uint32_t buffer[buffer_size(PAYLOADSIZE, HEADER_LEN)] = {0}; // initialize the buffer
+    static uint32_t buffer[buffer_size(PAYLOADSIZE+FRAME_CRC_LEN, HEADER_LEN)] = {0}; // initialize the buffer
     static uint8_t seq = 0;
     uint8_t *header_tmplate = packet_hdr_template(RECEIVER);
     uint8_t tx_payload_buffer[PAYLOADSIZE];
 
+    /* stop unused clocks (the report requires USB) */
+    if (REPORT_INTERVAL > 0) {
+        stdio_init_all();
+    }
+    static struct low_power lp;
+    low_power_init(&lp, LOW_POWER_MODE, REPORT_INTERVAL > 0);
+    absolute_time_t next_frame = make_timeout_time_ms(TX_DURATION);
+    file_position = FILE_START_POSITION; // the generator jumps to it (O(log n), see rnd_jump)
+
     while (true) {
         /* generate new data */
         generate_data(tx_payload_buffer, PAYLOADSIZE, true);
@@ -38,14 +52,38 @@ int main() {
         add_header(&message[0], seq, header_tmplate);
         /* add payload to packet */
         memcpy(&message[HEADER_LEN], tx_payload_buffer, PAYLOADSIZE);
+        /* add the CRC over length byte, sequence number and payload */
+        if (FRAME_CRC_LEN > 0) {
+            uint16_t crc = packet_crc16(&message[HEADER_LEN-2], 2 + PAYLOADSIZE);
+            message[HEADER_LEN+PAYLOADSIZE]   = (uint8_t) (crc >> 8);
+            message[HEADER_LEN+PAYLOADSIZE+1] = (uint8_t) (crc & 0x00FF);
+        }
 
         /* casting for 32-bit fifo */
-        for (uint8_t i=0; i < buffer_size(PAYLOADSIZE, HEADER_LEN); i++) {
+        for (uint8_t i=0; i < buffer_size(PAYLOADSIZE+FRAME_CRC_LEN, HEADER_LEN); i++) {
             buffer[i] = ((uint32_t) message[4*i+3]) | (((uint32_t) message[4*i+2]) << 8) | (((uint32_t) message[4*i+1]) << 16) | (((uint32_t)message[4*i]) << 24);
         }
+
+        /* the frame is prepared: sleep until it is due (drift-free period) */
+        low_power_sleep_until(&lp, next_frame);
+        next_frame = delayed_by_ms(next_frame, TX_DURATION);
+
         /* put the data to FIFO */
-        backscatter_send(pio,sm,buffer,buffer_size(PAYLOADSIZE, HEADER_LEN));
+        for (uint8_t i=0; i < buffer_size(PAYLOADSIZE+FRAME_CRC_LEN, HEADER_LEN); i++) {
+            pio_sm_put_blocking(pio, sm, buffer[i]);
+            if (i == 0) {
+                while (!pio_sm_is_tx_fifo_empty(pio, sm)); // first word pulled: the first symbol is sent
+                low_power_first_symbol(&lp);
+                pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm); // clear the stall flag of the previous frame
+            }
+        }
+        /* wait for the last symbol (the state-machine stalls on the empty FIFO) before its clock is gated */
+        while (!(pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + sm))));
         seq++;
-        sleep_ms(TX_DURATION);
+
+        if (REPORT_INTERVAL > 0 && lp.stats.frames >= REPORT_INTERVAL) {
+            low_power_report(&lp);
+            low_power_reset_stats(&lp);
+        }
     }
 }
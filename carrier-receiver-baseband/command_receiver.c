@@ -4,7 +4,11 @@
 #include "pico/stdlib.h"
 #include "pico/sync.h"
 #include "pico/util/queue.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
 #include "command_receiver.h"
+#include "benchmark.h"
+#include "protocol.h"
 
 void printControlInfo(){
     mutex_enter_blocking(&setting_mutex);
@@ -17,7 +21,7 @@ void printControlInfo(){
     uint32_t _current_BAUD = current_BAUD;
     uint32_t _current_DURATION = current_DURATION;
     mutex_exit(&setting_mutex);
-    printf("The configuration can be changed using the following commands:\n   h (print this help message)\n   s (start receiving)\n   t (terminate/stop receiving)\n   c A B C D (configure receiver A=center, B=deviation, C=baud, D=bandswidth all in Hz)\n   b A B C (configure backscatter A=divider1, B=divider2, C=baud)\n\n");
+    printf("The configuration can be changed using the following commands:\n   h (print this help message)\n   s (start receiving)\n   t (terminate/stop receiving)\n   c A B C D (configure receiver A=center, B=deviation, C=baud, D=bandswidth all in Hz)\n   b A B C (configure backscatter A=divider1, B=divider2, C=baud)\n   l (print link statistics, bit error rate and frequency tracking)\n   q (toggle per-frame output, periodic summaries while disabled)\n   f (toggle automatic frequency tracking)\n   a (toggle adaptive rate control, disabled by b)\n   r (toggle selective retransmission)\n   n C B O1 O2 O3 (plan dividers for the subcarrier center C [Hz] and baud B, O1-O3 optional occupied channels [Hz from the carrier, negative below])\n   m N (modulation for the current b configuration N=0: restarting FSK, 1: phase-continuous FSK, 2/3: single-sideband upper/lower, m alone toggles 0/1)\n   p A B C D E (add a benchmark point A=divider1, B=divider2, C=baud, D=carrier power [dBm, default 0], E=payload length [default %u], p alone clears the grid)\n   g N (run the benchmark grid with N frames per point, default %u, g again aborts)\n   u T S A B C (add a sequencer step T=type 1:config A=divider1 B=divider2 C=baud, 2:power A=dBm, 3:frames A=count B=length, 4:pause A=us; S=start offset in us, 0: after the previous step; unused values can be omitted, u alone clears)\n   x N (run the sequence N times, x again aborts)\n   k (calibrate the tag clock: measure the frequency offset and pre-compensate it, k 0 removes the calibration)\n   d (remove the persisted configuration, b/c/f/a/r/m changes are restored at boot)\n   z (dump and restart the event trace, build option TRACE)\n\n", PAYLOADSIZE, BENCH_DEFAULT_FRAMES);
     printf("The current receiver configuration is:\n  c %u ", _current_CENTER);
     printf("%u ", _current_DEVIATION);
     printf("%u ", _current_BAUDRATE);
@@ -29,25 +33,100 @@ void printControlInfo(){
 }
 
 queue_t command_queue;
-static char command[100];
+static char command[COMMAND_LENGTH];
 static int buff_pos = 0;  
+static bool overflow = false;
+
+/* binary command (see protocol.h): the values are passed as in the text commands, errors are acknowledged by core 0 */
+static void readFrame(){
+    struct protocol_decoder decoder;
+    struct protocol_frame frame = {0};
+    command_struct cmd_event = {0};
+    uint8_t result = PROTOCOL_PENDING;
+    protocol_decoder_reset(&decoder);
+    while(result == PROTOCOL_PENDING){
+        int input = getchar_timeout_us(PROTOCOL_BYTE_TIMEOUT_US);
+        if(input == PICO_ERROR_TIMEOUT){
+            return; // incomplete frame: not acknowledged
+        }
+        result = protocol_feed(&decoder, (uint8_t) input, &frame);
+    }
+    cmd_event.binary = true;
+    cmd_event.seq    = frame.seq;
+    if(result != PROTOCOL_OK){
+        cmd_event.cmd    = 'e';
+        cmd_event.value1 = result;
+    }else{
+        cmd_event.cmd    = frame.type;
+        cmd_event.value1 = frame.values[0];
+        cmd_event.value2 = frame.values[1];
+        cmd_event.value3 = frame.values[2];
+        cmd_event.value4 = frame.values[3];
+        cmd_event.value5 = frame.values[4];
+        if(frame.count == 0 && frame.type == 'g'){
+            cmd_event.value1 = BENCH_DEFAULT_FRAMES;
+        }
+        if(frame.count == 0 && (frame.type == 'x' || frame.type == 'k')){
+            cmd_event.value1 = 1;
+        }
+        if(frame.count == 0 && frame.type == 'm'){
+            cmd_event.value1 = 255;
+        }
+    }
+    queue_try_add(&command_queue, &cmd_event);
+}
 
 void readInput_core1(){
-    
+    multicore_lockout_victim_init(); // core 0 pauses this core while writing the configuration to flash
     queue_init(&command_queue, sizeof(command_struct), COMMAND_QUEUE_LENGTH); /* command queue setup */
     while(queue_try_remove(&command_queue, NULL));                            /* Reset the queue     */
 
     while(true){
         /* read input, parse input and put commands into the command queue */
         int input = getchar();
-        if ((input == '\n' || input == '\r' || input == EOF) && buff_pos > 0) {
+        if (buff_pos == 0 && !overflow && input == PROTOCOL_SOF) {
+            readFrame();
+            __sev(); // wake up core 0 (waiting in __wfe)
+        } else if ((input == '\n' || input == '\r' || input == EOF) && (buff_pos > 0 || overflow)) {
             command[buff_pos] = '\0'; 
 
             /* parse input and put to queue */
-            command_struct cmd_event;
+            command_struct cmd_event = {0};
             char cmd;
-            uint32_t  value1, value2, value3, value4;
-            if(sscanf(command, "%c %u %u %u %u", &cmd, &value1, &value2, &value3, &value4) != 5){
+            uint32_t  value1, value2, value3, value4, value5;
+            if(overflow){
+                cmd_event.cmd = 'e'; // e for invalid input (error)
+                queue_try_add(&command_queue, &cmd_event);
+            }else if(command[0] == 'n'){
+                // planner: n C B [O1 [O2 [O3]]] (2 to 5 values, occupied channel offsets may be negative)
+                int32_t occupied[3] = {0};
+                if(sscanf(command, "%c %u %u %d %d %d", &cmd, &value1, &value2, &occupied[0], &occupied[1], &occupied[2]) >= 3){
+                    cmd_event.cmd = 'n';
+                    cmd_event.value1 = value1;
+                    cmd_event.value2 = value2;
+                    cmd_event.value3 = (uint32_t) occupied[0]; // negative values wrap around (int32_t)
+                    cmd_event.value4 = (uint32_t) occupied[1];
+                    cmd_event.value5 = (uint32_t) occupied[2];
+                }else{
+                    cmd_event.cmd = 'e'; // e for invalid input (error)
+                }
+                queue_try_add(&command_queue, &cmd_event);
+            }else if(command[0] == 'p' || command[0] == 'u'){
+                // p A B C [D [E]] and u T S A [B [C]]: 3 to 5 values, the missing ones are zero as in a binary frame, alone: clear
+                value1 = value2 = value3 = value4 = value5 = 0;
+                int count = sscanf(command, "%c %u %u %u %u %u", &cmd, &value1, &value2, &value3, &value4, &value5);
+                if(count == 1 || count >= 4){
+                    cmd_event.cmd = cmd;
+                    cmd_event.value1 = value1;
+                    cmd_event.value2 = value2;
+                    cmd_event.value3 = value3;
+                    cmd_event.value4 = value4; // p: negative power values wrap around (int32_t)
+                    cmd_event.value5 = value5;
+                }else{
+                    cmd_event.cmd = 'e'; // e for invalid input (error)
+                }
+                queue_try_add(&command_queue, &cmd_event);
+            }else if(sscanf(command, "%c %u %u %u %u", &cmd, &value1, &value2, &value3, &value4) != 5){
                 if(sscanf(command, "%c %u %u %u", &cmd, &value1, &value2, &value3) != 4){
                     if(sscanf(command, "%c", &cmd) != 1){
                         cmd_event.cmd = 'e'; // e for invalid input (error)
@@ -82,6 +161,106 @@ void readInput_core1(){
                                 cmd_event.value4 = 0;
                                 queue_try_add(&command_queue, &cmd_event);
                                 break;
+                            case 'd':
+                                cmd_event.cmd = 'd';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'l':
+                                cmd_event.cmd = 'l';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'q':
+                                cmd_event.cmd = 'q';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'z':
+                                cmd_event.cmd = 'z';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'a':
+                                cmd_event.cmd = 'a';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'm':
+                                cmd_event.cmd = 'm';
+                                if(sscanf(command, "%c %u", &cmd, &value1) != 2){
+                                    value1 = 255; // m alone: toggle phase-continuous FSK
+                                }
+                                cmd_event.value1 = value1;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'r':
+                                cmd_event.cmd = 'r';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'g':
+                                cmd_event.cmd = 'g';
+                                if(sscanf(command, "%c %u", &cmd, &value1) != 2){
+                                    value1 = BENCH_DEFAULT_FRAMES;
+                                }
+                                cmd_event.value1 = value1;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'x':
+                                cmd_event.cmd = 'x';
+                                if(sscanf(command, "%c %u", &cmd, &value1) != 2){
+                                    value1 = 1;
+                                }
+                                cmd_event.value1 = value1;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'k':
+                                cmd_event.cmd = 'k';
+                                if(sscanf(command, "%c %u", &cmd, &value1) != 2){
+                                    value1 = 1; // k alone: calibrate
+                                }
+                                cmd_event.value1 = value1;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
+                            case 'f':
+                                cmd_event.cmd = 'f';
+                                cmd_event.value1 = 0;
+                                cmd_event.value2 = 0;
+                                cmd_event.value3 = 0;
+                                cmd_event.value4 = 0;
+                                queue_try_add(&command_queue, &cmd_event);
+                                break;
                             default:
                                 cmd_event.cmd = 'e'; // e for invalid input (error)
                                 cmd_event.value1 = 0;
@@ -133,9 +312,15 @@ void readInput_core1(){
                 }
             }
             buff_pos = 0; 
-        } else {
+            overflow = false;
+            __sev(); // wake up core 0 (waiting in __wfe)
+        } else if (input == '\n' || input == '\r' || input == EOF) {
+            // empty line (e.g. the second byte of CRLF)
+        } else if (buff_pos < COMMAND_LENGTH - 1) {
             command[buff_pos] = (char) input; 
             buff_pos++; 
+        } else {
+            overflow = true; // too long: rejected at the end of the line
         }
     }
 }
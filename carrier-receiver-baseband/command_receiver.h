@@ -12,12 +12,16 @@ extern uint32_t current_CENTER, current_DEVIATION, current_BAUDRATE, current_MIN
 extern mutex_t setting_mutex;
 
 # define COMMAND_QUEUE_LENGTH 10
+# define COMMAND_LENGTH      100 // text commands (longer lines are rejected)
 struct cmd_struct {
   char cmd;
+  bool binary;      // received as protocol frame (acknowledged with seq)
+  uint8_t seq;
   uint32_t  value1;
   uint32_t  value2;
   uint32_t  value3;
   uint32_t  value4;
+  uint32_t  value5;
 };
 typedef struct cmd_struct command_struct;
 
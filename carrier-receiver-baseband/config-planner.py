@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+'''
+Tobias Mages & Wenqing Yan
+Configuration planner (host version of project_pico_libs/config_planner.c, same scoring):
+searches all even divider pairs d0 > d1 (and several baud-rates) in parallel and prints the best configurations
+for a target subcarrier center offset, ranked by quantisation error, instruction fit, receiver limits and
+collisions of the subcarrier harmonics (and the mirror image) with occupied channels, the own receiver channel
+and the carrier.
+
+usage example: python config-planner.py 6600000 100000
+usage example: python config-planner.py 6600000 50000 100000 --occupied -6600000 18000000:800000 --twoAntennas --modulation 2
+'''
+
+import argparse
+from multiprocessing import Pool
+
+CLKFREQ = 125 # MHz
+CLK = CLKFREQ * 1000000
+HARMONICS = 7
+CARRIER_GUARD = 1000000
+COLLISION_PENALTY = 700
+LOW_INDEX_PENALTY = 50
+CP_BOUNDARY_CYCLES = 4
+MODULATIONS = ['restarting', 'phase-continuous', 'SSB upper', 'SSB lower']
+
+def achievable_baud(baud):
+    if CLK % baud == 0:
+        return baud
+    cycles = (2*CLK + baud) // (2*baud)
+    return (2*CLK + cycles) // (2*cycles)
+
+def instruction_count(delay, max_delay):
+    return delay // max_delay + (1 if delay % max_delay != 0 else 0) if delay > 0 else 0
+
+def count_bits(d0, d1, baud):
+    max_count = (CLK // baud) // min(d0, d1)
+    for bits in (3, 7, 15):
+        if max_count < (1 << bits):
+            return bits
+    return 0
+
+# instructions of the generated program (backscatter_program_length), 0 if it cannot be generated
+def program_length(d0, d1, baud, two_antennas, modulation):
+    ic = lambda delay: instruction_count(delay, 8 if two_antennas else 32)
+    if modulation >= 1:
+        quadrature = modulation >= 2
+        low  = lambda d: d//4 if quadrature else d//2
+        high = lambda d: ic(d//2 - d//4) + ic(d//4) + ic(d//2 - d//4 - 1) if quadrature else ic(d//2 - 1)
+        if (quadrature and not two_antennas) or count_bits(d0, d1, baud) == 0 or low(min(d0, d1)) < CP_BOUNDARY_CYCLES:
+            return 0
+        length = 1 + ic(low(d1) - 1) + 1 + 1 + ic(low(d1) - CP_BOUNDARY_CYCLES) + high(d1) + 1 + 3 \
+                   + 1 + ic(low(d0) - CP_BOUNDARY_CYCLES) + high(d0) + 1 + ic(low(d0) - 1) + 1
+        return 0 if length > 32 else length
+    last1 = (CLK // baud - 4) % d1
+    last0 = (CLK // baud - 4) % d0
+    tmp1, tmp0 = min(last1, d1//2), min(last0, d0//2)
+    length = 6 + ic(d1//2) + ic(d1//2 - 1) + 1 + ic(tmp1) + ic(max(0, last1 - tmp1)) + 1 \
+               + 1 + ic(d0//2) + ic(d0//2 - 1) + 1 + ic(tmp0) + ic(max(0, last0 - tmp0)) + 1
+    return 0 if length >= 32 else length
+
+def deviation(d0, d1):
+    fcenter = (CLK // d0 + CLK // d1) // 2
+    return (2*abs(CLK - fcenter*d1) + d1) // (2*d1)
+
+def overlaps(low, high, center, bw):
+    return low < center + bw//2 and high > center - bw//2
+
+def collisions(args, d0, d1, baud, center, rx_bw):
+    used_side = -1 if args.modulation == 3 else 1
+    own = used_side * center
+    hits_total, penalty = 0, 0
+    for n in range(1, HARMONICS + 1, 2):
+        low  = n * (CLK // d0) - baud // 2
+        high = n * (CLK // d1) + baud // 2
+        for side in (-1, 1):
+            # single-sideband (I/Q square waves): n = 4m+1 on the used side, n = 4m+3 on the mirror side
+            if args.modulation >= 2 and side != (1 if n % 4 == 1 else -1) * used_side:
+                continue
+            band_low, band_high = (low, high) if side > 0 else (-high, -low)
+            hits = 0
+            if not (n == 1 and side == used_side) and overlaps(band_low, band_high, own, rx_bw):
+                hits += 1
+            if overlaps(band_low, band_high, 0, 2*CARRIER_GUARD):
+                hits += 1
+            for channel, bw in args.occupied:
+                if overlaps(band_low, band_high, channel, bw if bw > 0 else rx_bw):
+                    hits += 1
+            hits_total += hits
+            penalty += hits * (COLLISION_PENALTY // n)
+    return hits_total, penalty
+
+def evaluate(args, d0, d1, requested):
+    baud = achievable_baud(requested)
+    instructions = program_length(d0, d1, baud, args.twoAntennas, args.modulation)
+    center = (CLK // d0 + CLK // d1) // 2
+    dev = deviation(d0, d1)
+    rx_bw = baud + 2*dev
+    if instructions == 0 or dev > args.maxDeviation or rx_bw > args.maxRxBw:
+        return None
+    score = abs(center - args.center) // 1000 + abs(baud - requested) * 1000 // requested + instructions // 4
+    if 2*dev < baud // 2:
+        score += LOW_INDEX_PENALTY
+    hits, penalty = collisions(args, d0, d1, baud, center, rx_bw)
+    return (score + penalty, d0, d1, baud, center, dev, rx_bw, instructions, hits)
+
+# one worker per d1 (all d0 > d1 and all baud-rates)
+def search(job):
+    args, d1 = job
+    results = []
+    for d0 in range(d1 + 2, args.maxDiv + 1, 2):
+        for baud in args.baud:
+            result = evaluate(args, d0, d1, baud)
+            if result is not None:
+                results.append(result)
+    return results
+
+def occupied_channel(text):
+    center, _, bw = text.partition(':')
+    return (int(center), int(bw) if bw else 0)
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(prog='config-planner', description='Rank divider/baud-rate configurations for a target subcarrier center offset')
+    parser.add_argument('center', type=int, help='target subcarrier center offset [Hz] e.g. 6600000')
+    parser.add_argument('baud', type=int, nargs='+', help='baud-rate(s) [baud] e.g. 50000 100000')
+    parser.add_argument('--occupied', type=occupied_channel, nargs='*', default=[], help='occupied channels CENTER[:BW] in Hz relative to the carrier (negative: below), BW default: own RX bandwidth')
+    parser.add_argument('--twoAntennas', action='store_true', help='program for two antennas (8 instead of 32 cycles delay per instruction)')
+    parser.add_argument('--modulation', type=int, default=0, choices=range(4), help='0 restarting, 1 phase-continuous, 2/3 single-sideband upper/lower (command m)')
+    parser.add_argument('--minDiv', type=int, default=4)
+    parser.add_argument('--maxDiv', type=int, default=200)
+    parser.add_argument('--maxDeviation', type=int, default=380000, help='receiver limit (default: CC2500)')
+    parser.add_argument('--maxRxBw', type=int, default=812500, help='receiver limit (default: CC2500)')
+    parser.add_argument('--top', type=int, default=10)
+    args = parser.parse_args()
+
+    with Pool() as pool:
+        jobs = [(args, d1) for d1 in range(args.minDiv + args.minDiv % 2, args.maxDiv + 1, 2)]
+        results = sorted((r for part in pool.map(search, jobs) for r in part), key=lambda r: (r[0], r[2], r[1])) # ties: search order of the firmware
+
+    print(f'target center {args.center} Hz | {MODULATIONS[args.modulation]} | {len(args.occupied)} occupied channels | {len(results)} valid configurations')
+    print('rank  d0  d1   baud |  center[Hz] dev[Hz] rxbw[Hz] | instr | collisions | score')
+    for rank, (score, d0, d1, baud, center, dev, rx_bw, instructions, hits) in enumerate(results[:args.top], 1):
+        print(f'{rank:4} {d0:3} {d1:3} {baud:6} | {center:11} {dev:7} {rx_bw:8} | {instructions:5} | {hits:10} | {score:5}   (b {d0} {d1} {baud})')
@@ -21,6 +21,7 @@
 #include "pico/binary_info.h"
 #include "pico/util/datetime.h"
 #include "hardware/spi.h"
+#include "hardware/sync.h"
 
 #include "hardware/pio.h"
 #include "hardware/clocks.h"
@@ -29,6 +30,20 @@
 #include "carrier_CC2500.h"
 #include "receiver_CC2500.h"
 #include "packet_generation.h"
+#include "link_stats.h"
+#include "bit_errors.h"
+#include "scheduler.h"
+#include "rate_control.h"
+#include "retransmission.h"
+#include "benchmark.h"
+#include "sequencer.h"
+#include "protocol.h"
+#include "config_store.h"
+#include "usb_stream.h"
+#include "tag_calibration.h"
+#include "config_planner.h"
+#include "trace.h"
+#include "spi_bus.h"
 
 
 #define RADIO_SPI             spi0
@@ -44,8 +59,22 @@
 #define CLOCK_DIV1              18 // smaller
 #define DESIRED_BAUD         50000
 #define TWOANTENNAS           true
+#define MODULATION               0 // start with 0: restarting FSK, 1: phase-continuous FSK, 2/3: single-sideband upper/lower (select with 'm', see backscatter.h)
 
 #define CARRIER_FEQ     2450000000
+#define STATS_INTERVAL_MS    10000 // link statistics summary interval while the per-frame output is disabled (0: only on command)
+#define AFC_ENABLED         true // track the frequency offset of the tag (FREQEST -> FSCTRL0)
+#define BER_PATTERN             0xA5 // FOR DEMO: fixed payload of 0xA5 (see below)
+#define CARRIER_STANDBY      true // keep the carrier synthesizer locked (FSTXON) between frames
+#define FRAME_GUARD_US          200 // the carrier is stopped at the latest this long after the computed frame airtime
+#define OUTPUT_PERIOD_MS        100 // check for periodic link statistics summaries
+#define OUTPUT_QUEUE_LENGTH       8 // received frames waiting to be printed
+#define RATE_ADAPTIVE         false // start with the adaptive rate control enabled (toggle with 'a')
+#define RELIABLE_DELIVERY     false // start with selective retransmission enabled (toggle with 'r')
+#define BENCH_RX_TIMEOUT_US    2000 // benchmark: wait this long after the frame for the receiver to complete
+#define PERSIST_CONFIG        true // save b/c/f/a/r/m changes in flash and restore them at boot ('d' restores the defaults)
+#define USB_WAIT_MS           5000 // without a persisted configuration: wait at most this long for the USB serial connection at boot (0: no wait)
+#define CONFIG_VERSION           4 // layout of struct persisted_config
 
 /* Event queue for commands (start/stop uses zero values) */
 
@@ -58,13 +87,242 @@
 uint32_t current_CENTER, current_DEVIATION, current_BAUDRATE, current_MIN_RX_BW, current_DIV0, current_DIV1, current_BAUD, current_DURATION;
 mutex_t setting_mutex;
 
+struct link_stats stats;
+struct ber_engine ber;
+struct afc_state afc;
+struct tag_calibration tag_cal;
+int8_t last_freqest = 0; // FREQEST of the last frame received by measure_frame
+struct backscatter_config backscatter_conf = {.phase_continuous = MODULATION >= 1, .quadrature = MODULATION >= 2, .lower_sideband = MODULATION == 3}; // active configuration (updated by 'b'/'m')
+uint32_t frame_timeouts = 0;
+#if SPI_BUS
+struct spi_bus radio_bus; // shared by the receiver and the carrier
+#endif
+bool print_frames = true;
+
+/* scheduler tasks (in order of priority) */
+struct scheduler sched;
+int8_t tx_task_id, rx_task_id, command_task_id, bench_task_id, sequencer_task_id, output_task_id;
+
+/* received frames are printed by the output task (printing must not delay the TX release) */
+struct frame_record {
+  uint8_t       buffer[RX_BUFFER_SIZE];
+  Packet_status status;
+  uint64_t      time_us;
+};
+queue_t output_queue;
+uint32_t output_dropped = 0;
+
+/* backscatter state */
+PIO pio = pio0;
+uint sm = 0;
+uint16_t instructionBuffer[32] = {0}; // generated program of the active configuration (maximal instruction size: 32)
+bool rx_ready = true;
+struct rate_control rate;
+struct arq arq;
+struct benchmark bench;
+struct sequencer sequence;
+struct bench_point saved_config; // configuration before the benchmark/sequence
+
+/* modulation ('m'): 0 restarting FSK, 1 phase-continuous FSK, 2/3 single-sideband upper/lower */
+const char *modulation_names[] = {"restarting FSK", "phase-continuous FSK", "single-sideband FSK (upper)", "single-sideband FSK (lower)"};
+
+uint8_t modulation(){
+    return backscatter_conf.quadrature ? (backscatter_conf.lower_sideband ? 3 : 2) : backscatter_conf.phase_continuous;
+}
+
+void set_modulation_flags(uint8_t mode){
+    backscatter_conf.phase_continuous = mode >= 1;
+    backscatter_conf.quadrature       = mode >= 2;
+    backscatter_conf.lower_sideband   = mode == 3;
+}
+
+/* the receiver listens on the used sideband (the lower one mirrors the subcarriers below the carrier) */
+uint32_t rx_center_frequency(){
+    return backscatter_conf.lower_sideband ? CARRIER_FEQ - backscatter_conf.center_offset : CARRIER_FEQ + backscatter_conf.center_offset;
+}
+
+/* tag clock pre-compensation for the active configuration (after loading a program or resetting the frequency tracking) */
+void apply_tag_calibration(){
+    // on the lower sideband a slower tag clock raises the tones: the receiver compensates the whole offset
+    tag_cal_split(&tag_cal, backscatter_conf.lower_sideband ? 0 : backscatter_conf.center_offset);
+    tag_cal_apply(&tag_cal, pio, sm, &afc);
+}
+
+/* reconfigure the tag and the receiver together (the receiver is not listening inbetween) */
+bool apply_backscatter_config(uint16_t d0, uint16_t d1, uint32_t baud){
+    cc2500_stop_listen(&radio_rx);
+    if(!backscatter_program_init(pio, sm, PIN_TX1, PIN_TX2, d0, d1, baud, &backscatter_conf, instructionBuffer, TWOANTENNAS)){
+        cc2500_start_listen(&radio_rx);
+        return false;
+    }
+    uint32_t conf_CENTER    = set_frecuency_rx(rx_center_frequency());
+    uint32_t conf_DEVIATION = set_frequency_deviation_rx(backscatter_conf.deviation);
+    uint32_t conf_BAUDRATE  = set_datarate_rx(backscatter_conf.baudrate);
+    uint32_t conf_MIN_RX_BW = set_filter_bandwidth_rx(backscatter_conf.minRxBw);
+    afc_init_rx(&afc, afc.enabled);
+    apply_tag_calibration();
+    mutex_enter_blocking(&setting_mutex);
+    current_CENTER    = conf_CENTER;
+    current_DEVIATION = conf_DEVIATION;
+    current_BAUDRATE  = conf_BAUDRATE;
+    current_MIN_RX_BW = conf_MIN_RX_BW;
+    current_DIV0      = d0;
+    current_DIV1      = d1;
+    current_BAUD      = backscatter_conf.baudrate;
+    mutex_exit(&setting_mutex);
+    ber_new_configuration(&ber, stats.total.sent - min(stats.total.sent, stats.total.received));
+    cc2500_start_listen(&radio_rx);
+    rx_ready = true;
+    return true;
+}
+
+/* TX period: TX_DURATION, or the period of the step while the adaptive rate control runs (restarts the timer on a change) */
+void update_tx_period(){
+    static uint32_t period_us = 0;
+    uint32_t next = rate.enabled ? rate_control_period_us(rate.step) : TX_DURATION * 1000;
+    if(next == period_us){
+        return;
+    }
+    period_us = next;
+    scheduler_set_period(&sched, tx_task_id, period_us);
+    mutex_enter_blocking(&setting_mutex);
+    current_DURATION = period_us / 1000;
+    mutex_exit(&setting_mutex);
+}
+
+/* reconfigure the tag and the receiver for a step of the rate ladder */
+bool apply_rate_step(uint8_t step){
+    const struct rate_step *r = &rate_ladder[step];
+    return apply_backscatter_config(r->d0, r->d1, r->baud);
+}
+
+/*
+ * persisted configuration: the generated PIO program and the receiver registers are restored at boot
+ * without computing them again (see USB_WAIT_MS)
+ */
+struct persisted_config {
+  uint16_t div0;
+  uint16_t div1;
+  uint32_t baud;                                 // achieved baud-rate of the program
+  uint16_t instructions[32];
+  uint8_t  program_length;
+  uint8_t  rx_registers[PROFILE_BLOCK_SIZE];     // FREQ2 ... FSCAL1
+  uint32_t center, deviation, baudrate, min_rx_bw;
+  bool     afc;
+  bool     rate;
+  uint8_t  rate_step;
+  bool     arq;
+  bool     tag_cal;                              // tag clock calibration (per board)
+  int32_t  tag_cal_offset_hz;
+  uint8_t  modulation;                           // of the program ('m')
+};
+uint32_t boot_us = 0; // time until the scheduler started
+
+void persist_configuration(){
+    if(!PERSIST_CONFIG){
+        return;
+    }
+    struct persisted_config persisted;
+    memset(&persisted, 0, sizeof(struct persisted_config));
+    mutex_enter_blocking(&setting_mutex);
+    persisted.div0      = current_DIV0;
+    persisted.div1      = current_DIV1;
+    persisted.center    = current_CENTER;
+    persisted.deviation = current_DEVIATION;
+    persisted.baudrate  = current_BAUDRATE;
+    persisted.min_rx_bw = current_MIN_RX_BW;
+    mutex_exit(&setting_mutex);
+    persisted.baud           = backscatter_conf.baudrate;
+    persisted.program_length = backscatter_conf.program_length;
+    memcpy(persisted.instructions, instructionBuffer, sizeof(instructionBuffer));
+    read_burst_rx(PROFILE_FIRST_REGISTER, persisted.rx_registers, PROFILE_BLOCK_SIZE);
+    persisted.afc       = afc.enabled;
+    persisted.rate      = rate.enabled;
+    persisted.rate_step = rate.step;
+    persisted.arq       = arq.enabled;
+    persisted.tag_cal           = tag_cal.valid;
+    persisted.tag_cal_offset_hz = tag_cal.offset_hz;
+    persisted.modulation        = modulation();
+    config_store_save(&persisted, sizeof(struct persisted_config), CONFIG_VERSION, true);
+}
+
+/* the benchmark and the sequencer send their own frames (the tx and rx tasks are idle meanwhile) */
+bool measurement_running(){
+    return bench.running || sequence.running;
+}
+
+/* keep the configuration before a benchmark/sequence changes it */
+void save_configuration(){
+    if(rate.enabled){
+        rate.enabled = false;
+        update_tx_period();
+        printf("Adaptive rate control disabled.\n");
+    }
+    mutex_enter_blocking(&setting_mutex);
+    saved_config.d0 = current_DIV0;
+    saved_config.d1 = current_DIV1;
+    mutex_exit(&setting_mutex);
+    saved_config.baud      = backscatter_conf.baudrate;
+    saved_config.power_dbm = get_tx_power_dbm();
+}
+
+void restore_configuration(){
+    apply_backscatter_config(saved_config.d0, saved_config.d1, saved_config.baud);
+    set_tx_power_dbm(saved_config.power_dbm);
+    link_stats_init(&stats, to_us_since_boot(get_absolute_time())); // the measurement frames are not part of the statistics
+}
+
+/* start a benchmark run (or abort the running one) */
+uint8_t start_benchmark(uint32_t frames){
+    if(bench.running){
+        bench_stop(&bench);
+        restore_configuration();
+        return PROTOCOL_OK;
+    }
+    if(sequence.running){
+        return PROTOCOL_BUSY;
+    }
+    save_configuration();
+    bench_start(&bench, frames);
+    scheduler_release(&sched, bench_task_id);
+    return PROTOCOL_OK;
+}
+
+/* start the sequence (or abort the running one) */
+uint8_t start_sequence(uint32_t repeat, bool binary){
+    if(sequence.running){
+        seq_stop(&sequence);
+        restore_configuration();
+        return PROTOCOL_OK;
+    }
+    if(bench.running){
+        return PROTOCOL_BUSY;
+    }
+    save_configuration();
+    if(!seq_start(&sequence, repeat, binary, to_us_since_boot(get_absolute_time()))){
+        return PROTOCOL_INVALID;
+    }
+    scheduler_release(&sched, sequencer_task_id);
+    return PROTOCOL_OK;
+}
+
+bool calibrate_tag(); // sends frames (see below)
+
 void do_commands(){
+    static int16_t last_seq = -1; // binary commands: a repeated frame (lost acknowledgement) is only acknowledged again
+    static uint8_t last_status = PROTOCOL_OK; // ... with the status of its first execution
     command_struct cmd_event;
+    uint8_t status = PROTOCOL_OK;
     if(queued_command()){
         if (get_command(&cmd_event)){
+            if(cmd_event.binary && cmd_event.cmd != 'e' && cmd_event.seq == last_seq){
+                protocol_send_ack(cmd_event.seq, cmd_event.cmd, last_status);
+                return;
+            }
             switch (cmd_event.cmd){
                 case 'e':
                     printf("The input was invalid. Enter 'h' for further information on the interface.\n");
+                    status = (cmd_event.value1 != PROTOCOL_OK) ? cmd_event.value1 : PROTOCOL_INVALID;
                     break;
                 case 'h':
                     printControlInfo();
@@ -83,6 +341,8 @@ void do_commands(){
                     conf_DEVIATION = set_frequency_deviation_rx(cmd_event.value2);
                     conf_BAUDRATE = set_datarate_rx(cmd_event.value3);
                     conf_MIN_RX_BW = set_filter_bandwidth_rx(cmd_event.value4);
+                    afc_init_rx(&afc, afc.enabled);
+                    apply_tag_calibration();
                     mutex_enter_blocking(&setting_mutex);
                     current_CENTER=conf_CENTER;
                     current_DEVIATION=conf_DEVIATION;
@@ -93,36 +353,470 @@ void do_commands(){
                     printf("%u ", conf_DEVIATION);
                     printf("%u ", conf_BAUDRATE);
                     printf("%u\n", conf_MIN_RX_BW);
+                    ber_new_configuration(&ber, stats.total.sent - min(stats.total.sent, stats.total.received));
+                    link_stats_init(&stats, to_us_since_boot(get_absolute_time())); // new configuration: restart statistics
                     RX_start_listen();
+                    persist_configuration();
                     break;
                 case 'b':
+                    if(measurement_running()){
+                        printf("A benchmark/sequence is running, abort it with g/x first.\n");
+                        status = PROTOCOL_BUSY;
+                        break;
+                    }
+                    if(rate.enabled){
+                        rate.enabled = false;
+                        update_tx_period();
+                        printf("Adaptive rate control disabled.\n");
+                    }
                     printf("Changing pio-state machine...\n");
                     mutex_enter_blocking(&setting_mutex);
                     current_DIV0 = cmd_event.value1;
                     current_DIV1 = cmd_event.value2;
                     current_BAUD = cmd_event.value3;
                     mutex_exit(&setting_mutex);
-                    PIO pio = pio0;
-                    uint sm = 0;
-                    struct backscatter_config backscatter_conf;
-                    uint16_t instructionBuffer[32] = {0}; // maximal instruction size: 32
                     if(backscatter_program_init(pio, sm, PIN_TX1, PIN_TX2, cmd_event.value1, cmd_event.value2, cmd_event.value3, &backscatter_conf, instructionBuffer, TWOANTENNAS)){
+                        apply_tag_calibration();
+                        ber_new_configuration(&ber, stats.total.sent - min(stats.total.sent, stats.total.received));
+                        link_stats_init(&stats, to_us_since_boot(get_absolute_time())); // new configuration: restart statistics
                         printf("Pio-state machine successfully changed.\n");
+                        persist_configuration();
                     }else{
                         printf("Issue encountered. The state-machine has not been updated.\n");
+                        status = PROTOCOL_INVALID;
+                    }
+                    break;
+                case 'm':
+                    if(measurement_running()){
+                        printf("A benchmark/sequence is running, abort it with g/x first.\n");
+                        status = PROTOCOL_BUSY;
+                        break;
+                    }
+                    if(cmd_event.value1 == 255){
+                        cmd_event.value1 = (modulation() == 1) ? 0 : 1; // m alone: toggle phase-continuous FSK
+                    }else if(cmd_event.value1 > 3){
+                        printf("Invalid modulation (0-3).\n");
+                        status = PROTOCOL_INVALID;
+                        break;
                     }
+                    uint8_t previous = modulation();
+                    set_modulation_flags(cmd_event.value1);
+                    mutex_enter_blocking(&setting_mutex);
+                    uint16_t m_d0 = current_DIV0, m_d1 = current_DIV1;
+                    uint32_t m_baud = current_BAUD;
+                    mutex_exit(&setting_mutex);
+                    if(apply_backscatter_config(m_d0, m_d1, m_baud)){
+                        link_stats_init(&stats, to_us_since_boot(get_absolute_time())); // new configuration: restart statistics
+                        printf("Modulation: %s.\n", modulation_names[modulation()]);
+                        persist_configuration();
+                    }else{
+                        set_modulation_flags(previous);
+                        apply_backscatter_config(m_d0, m_d1, m_baud);
+                        printf("Issue encountered. The previous program has been restored.\n");
+                        status = PROTOCOL_INVALID;
+                    }
+                    break;
+                case 'n':
+                    if(cmd_event.value1 == 0 || cmd_event.value2 == 0){
+                        status = PROTOCOL_INVALID;
+                        break;
+                    }
+                    struct plan_request plan;
+                    struct plan_result plans[PLAN_MAX_RESULTS];
+                    plan_request_init(&plan, cmd_event.value1, cmd_event.value2, TWOANTENNAS, modulation());
+                    uint32_t occupied[] = {cmd_event.value3, cmd_event.value4, cmd_event.value5};
+                    for(uint8_t i = 0; i < count_of(occupied); i++){
+                        if(occupied[i] != 0){
+                            plan_add_occupied(&plan, (int32_t) occupied[i], 0);
+                        }
+                    }
+                    plan_print(&plan, plans, plan_configurations(&plan, plans, PLAN_MAX_RESULTS));
+                    break;
+                case 'l':
+                    link_stats_report(&stats, to_us_since_boot(get_absolute_time()));
+                    ber_report(&ber, stats.total.sent - min(stats.total.sent, stats.total.received));
+                    afc_print_rx(&afc);
+                    tag_cal_print(&tag_cal, backscatter_conf.baudrate);
+                    carrier_timing_print_tx();
+                    scheduler_report(&sched);
+                    printf("output | dropped frames %u\n", output_dropped);
+                    usb_stream_report();
+#if SPI_BUS
+                    spi_bus_report(&radio_bus);
+#endif
+                    arq_report(&arq, to_us_since_boot(get_absolute_time()), PAYLOADSIZE);
+                    printf("backscatter | airtime %u us | timeouts %u\n", backscatter_airtime_us(&backscatter_conf, buffer_size(PAYLOADSIZE+CRC_LEN, HEADER_LEN)), frame_timeouts);
+                    printf("config | boot %u us | flash writes %u\n", boot_us, config_store_writes());
+                    break;
+                case 'k':
+                    if(measurement_running()){
+                        printf("A benchmark/sequence is running, abort it with g/x first.\n");
+                        status = PROTOCOL_BUSY;
+                        break;
+                    }
+                    if(cmd_event.value1 == 0){
+                        tag_cal_restore(&tag_cal, false, 0);
+                        apply_tag_calibration();
+                        printf("Tag calibration removed.\n");
+                    }else if(!calibrate_tag()){
+                        status = PROTOCOL_INVALID;
+                        break;
+                    }
+                    persist_configuration();
+                    break;
+                case 'd':
+                    config_store_erase(true);
+                    printf("Persisted configuration removed, the next boot uses the defaults.\n");
+                    break;
+                case 'f':
+                    RX_stop_listen();
+                    afc_init_rx(&afc, !afc.enabled);
+                    apply_tag_calibration();
+                    afc_print_rx(&afc);
+                    RX_start_listen();
+                    persist_configuration();
+                    break;
+                case 'a':
+                    rate_control_init(&rate, !rate.enabled, rate.step);
+                    if(rate.enabled && !apply_rate_step(rate.step)){
+                        printf("Issue encountered. The state-machine has not been updated.\n");
+                    }
+                    update_tx_period();
+                    printf("Adaptive rate control %s (step %u).\n", rate.enabled ? "enabled" : "disabled", rate.step);
+                    persist_configuration();
+                    break;
+                case 'p':
+                    if(bench.running){
+                        printf("The benchmark is running, abort it with g first.\n");
+                        status = PROTOCOL_BUSY;
+                    }else if(cmd_event.value1 == 0){
+                        bench_clear(&bench);
+                        printf("Benchmark grid cleared.\n");
+                    }else if(bench_add_point(&bench, (struct bench_point){.d0 = cmd_event.value1, .d1 = cmd_event.value2, .baud = cmd_event.value3,
+                                                                          .power_dbm = (int32_t) cmd_event.value4, .len = cmd_event.value5 ? min(cmd_event.value5, 255) : PAYLOADSIZE})){
+                        printf("Benchmark point %u added.\n", bench.points);
+                    }else{
+                        printf("Benchmark point rejected (max. %u points, payload length 1-%u).\n", BENCH_MAX_POINTS, MAX_PAYLOADSIZE);
+                        status = PROTOCOL_INVALID;
+                    }
+                    break;
+                case 'g':
+                    status = start_benchmark(cmd_event.value1);
+                    break;
+                case 'u':
+                    if(sequence.running){
+                        printf("The sequence is running, abort it with x first.\n");
+                        status = PROTOCOL_BUSY;
+                    }else if(cmd_event.value1 == 0){
+                        seq_clear(&sequence);
+                        printf("Sequence cleared.\n");
+                    }else if(seq_add_step(&sequence, (struct seq_step){.type = cmd_event.value1, .start_us = cmd_event.value2,
+                                                                       .arg = {cmd_event.value3, cmd_event.value4, cmd_event.value5}})){
+                        printf("Sequence step %u added.\n", sequence.count);
+                    }else{
+                        printf("Sequence step rejected (max. %u steps, frames 1-%u with payload length 1-%u).\n", SEQ_MAX_STEPS, SEQ_MAX_FRAMES, MAX_PAYLOADSIZE);
+                        status = PROTOCOL_INVALID;
+                    }
+                    break;
+                case 'x':
+                    status = start_sequence(cmd_event.value1, cmd_event.binary);
+                    if(status == PROTOCOL_INVALID){
+                        printf("The sequence is empty.\n");
+                    }else if(status == PROTOCOL_BUSY){
+                        printf("The benchmark is running, abort it with g first.\n");
+                    }
+                    break;
+                case 'r':
+                    arq_init(&arq, !arq.enabled, to_us_since_boot(get_absolute_time()));
+                    printf("Selective retransmission %s.\n", arq.enabled ? "enabled" : "disabled");
+                    persist_configuration();
+                    break;
+                case 'q':
+                    print_frames = !print_frames;
+                    printf("Per-frame output %s.\n", print_frames ? "enabled" : "disabled");
+                    break;
+                case 'z':
+                    trace_dump();
                     break;
                 default:
                     printf("Invalid command obtained.\n");
+                    status = PROTOCOL_INVALID;
                     break;
             }
+            if(cmd_event.binary){
+                protocol_send_ack(cmd_event.seq, cmd_event.cmd, status);
+                if(cmd_event.cmd != 'e'){
+                    last_seq    = cmd_event.seq;
+                    last_status = status;
+                }
+            }
         }
     }
 }
 
+/* backscatter one frame: the carrier is only on while the state-machine is sending */
+void send_frame(uint32_t *buffer, uint8_t words){
+    static uint32_t symbols[buffer_size(MAX_PAYLOADSIZE+CRC_LEN, HEADER_LEN) * BACKSCATTER_ENCODE_FACTOR];
+    uint32_t symbol_words = backscatter_encode(&backscatter_conf, buffer, words, symbols);
+    start_carrier_tx(); // returns once the carrier is transmitting
+    absolute_time_t frame_end = delayed_by_us(get_absolute_time(), tag_cal_airtime_us(&tag_cal, backscatter_airtime_us(&backscatter_conf, words)) + FRAME_GUARD_US);
+    backscatter_start(pio,sm,symbols,symbol_words);
+    if(!backscatter_wait(pio, sm, frame_end)){ // the state-machine stalls after the last symbol
+        frame_timeouts++;
+    }
+    stop_carrier_tx();
+}
+
+/* periodic TX release: backscatter a new packet if the receiver is listening */
+void tx_task(void *context){
+    static uint32_t buffer[buffer_size(PAYLOADSIZE+CRC_LEN, HEADER_LEN)] = {0}; // initialize the buffer
+    static uint8_t seq = 0;
+    uint8_t *header_tmplate = packet_hdr_template(RECEIVER);
+    uint8_t tx_payload_buffer[PAYLOADSIZE];
+
+    if (!rx_ready || measurement_running()){
+        return;
+    }
+    /* adaptive rate: reconfigure between frames */
+    if(rate_control_window_done(&rate)){
+        uint8_t previous = rate.step;
+        uint8_t next = rate_control_decide(&rate, to_us_since_boot(get_absolute_time()));
+        if(next != previous && !apply_rate_step(next)){
+            rate_control_set_step(&rate, previous);
+            apply_rate_step(previous);
+        }
+        update_tx_period();
+    }
+    /* generate new data */
+    // generate_data(tx_payload_buffer, PAYLOADSIZE, true);
+    for(uint8_t i = 0; i < PAYLOADSIZE; i++){
+        tx_payload_buffer[i] = BER_PATTERN;                              // FOR DEMO: fixed payload of 0xA5
+    }
+
+    /* header (10 byte), payload and CRC */
+    uint8_t words;
+    if(arq.enabled){
+        bool retransmission;
+        words = build_frame(buffer, arq_next_frame(&arq, &retransmission), tx_payload_buffer, PAYLOADSIZE, header_tmplate); // sequence number of a new frame or of a lost one
+    }else{
+        words = build_frame(buffer, 0xA5, tx_payload_buffer, PAYLOADSIZE, header_tmplate);           // FOR DEMO: fixed sequence number of 0xA5
+    }
+    /* put the data to FIFO (start backscattering) */
+    send_frame(buffer, words);
+    link_stats_sent(&stats);
+    rate_control_sent(&rate, to_us_since_boot(get_absolute_time()));
+    /* increase seq number*/ 
+    seq++;
+}
+
+/*
+ * send one frame with len payload bytes and wait for the receiver (benchmark and sequencer)
+ * returns true if a frame has been received, record/status then contain it
+ */
+bool measure_frame(uint8_t len, uint8_t *record, Packet_status *status){
+    static uint32_t buffer[buffer_size(MAX_PAYLOADSIZE+CRC_LEN, HEADER_LEN)] = {0};
+    static uint8_t seq = 0;
+    uint8_t payload[MAX_PAYLOADSIZE];
+    event_t evt;
+
+    memset(payload, BER_PATTERN, len);
+    uint8_t words = build_frame(buffer, seq++, payload, len, packet_hdr_template(RECEIVER));
+    /* discard a frame which completed after the previous timeout */
+    while((evt = get_event()) != no_evt){
+        if(evt == rx_deassert_evt){
+            readPacket(record);
+            cc2500_start_listen(&radio_rx);
+        }
+    }
+    send_frame(buffer, words);
+    /* wait for the receiver (the rx task is idle meanwhile) */
+    absolute_time_t timeout = make_timeout_time_us(BENCH_RX_TIMEOUT_US);
+    while(!time_reached(timeout)){
+        if(get_event() == rx_deassert_evt){
+            *status = readPacket(record);
+            last_freqest = (int8_t) read_status_rx(FREQEST);
+            cc2500_start_listen(&radio_rx);
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * tag clock calibration: mean FREQEST of TAG_CAL_FRAMES frames sent without correction (blocking, the tx and rx tasks
+ * are idle meanwhile), returns false if too few frames were received (the previous calibration is kept)
+ */
+bool calibrate_tag(){
+    uint8_t record[RX_BUFFER_SIZE];
+    Packet_status status;
+    struct tag_calibration previous = tag_cal;
+
+    tag_cal_restore(&tag_cal, false, 0);
+    apply_tag_calibration();
+    tag_cal_start(&tag_cal);
+    for(uint16_t i = 0; i < TAG_CAL_FRAMES; i++){
+        bool received = measure_frame(PAYLOADSIZE, record, &status) && !status.overflowed && status.CRCcheck;
+        tag_cal_add(&tag_cal, received, last_freqest);
+    }
+    if(!tag_cal_finish(&tag_cal)){
+        printf("calibration | failed: %u of %u frames received (min. %u), keeping the previous calibration\n", tag_cal.frames, tag_cal.sent, TAG_CAL_MIN_FRAMES);
+        tag_cal = previous;
+        apply_tag_calibration();
+        return false;
+    }
+    apply_tag_calibration();
+    tag_cal_print(&tag_cal, backscatter_conf.baudrate);
+    return true;
+}
+
+/* benchmark: one frame per run (configuring the next grid point first), released again until the grid is done */
+void bench_task(void *context){
+    uint8_t record[RX_BUFFER_SIZE];
+    Packet_status status;
+
+    if(!bench.running){
+        return;
+    }
+    if(!bench.configured){
+        const struct bench_point *p = bench_point(&bench);
+        bool applied = apply_backscatter_config(p->d0, p->d1, p->baud);
+        int8_t power = set_tx_power_dbm(p->power_dbm);
+        bench_point_start(&bench, applied, backscatter_conf.baudrate, power,
+                          backscatter_airtime_us(&backscatter_conf, buffer_size(p->len+CRC_LEN, HEADER_LEN)), to_us_since_boot(get_absolute_time()));
+    }
+    if(!bench_point_done(&bench)){
+        bool received = measure_frame(bench_point(&bench)->len, record, &status);
+        bench_sent(&bench);
+        if(received){
+            bench_received(&bench, record, status);
+        }
+    }
+    if(bench_point_done(&bench) && !bench_next_point(&bench, to_us_since_boot(get_absolute_time()))){
+        restore_configuration();
+        return;
+    }
+    scheduler_release(&sched, bench_task_id);
+}
+
+/* sleep until shortly before time_us (hardware alarm) or busy-wait the rest, returns false if the task has to wait for the alarm */
+bool sequencer_wait(uint64_t time_us){
+    if(time_us > time_us_64() + SEQ_SPIN_US){
+        scheduler_release_at(&sched, sequencer_task_id, from_us_since_boot(time_us - SEQ_SPIN_US));
+        return false;
+    }
+    busy_wait_until(from_us_since_boot(time_us));
+    return true;
+}
+
+/* sequencer: starts the steps on time, one frame per run */
+void sequencer_task(void *context){
+    uint8_t record[RX_BUFFER_SIZE];
+    Packet_status status;
+
+    if(!sequence.running){
+        return;
+    }
+    if(!sequence.started){
+        if(!sequencer_wait(seq_due_us(&sequence))){
+            return;
+        }
+        seq_step_begin(&sequence, time_us_64());
+        const struct seq_step *step = seq_current(&sequence);
+        switch(step->type){
+            case SEQ_STEP_CONFIG:
+                if(!apply_backscatter_config(step->arg[0], step->arg[1], step->arg[2])){
+                    seq_step_rejected(&sequence);
+                }
+                break;
+            case SEQ_STEP_POWER:
+                set_tx_power_dbm((int32_t) step->arg[0]);
+                break;
+            default:
+                break;
+        }
+    }
+    const struct seq_step *step = seq_current(&sequence);
+    if(step->type == SEQ_STEP_FRAMES && !seq_step_done(&sequence, time_us_64())){
+        bool received = measure_frame(step->arg[1], record, &status);
+        seq_sent(&sequence);
+        if(received){
+            seq_received(&sequence, record, status);
+        }
+    }
+    if(step->type == SEQ_STEP_PAUSE && !sequencer_wait(seq_step_end_us(&sequence))){
+        return;
+    }
+    if(seq_step_done(&sequence, time_us_64()) && !seq_next_step(&sequence, time_us_64())){
+        restore_configuration();
+        return;
+    }
+    scheduler_release(&sched, sequencer_task_id);
+}
+
+/* RX completion: released by the GDO0 interrupt */
+void rx_task(void *context){
+    event_t evt;
+    if(measurement_running()){
+        return; // the events are handled by the benchmark/sequencer task
+    }
+    while((evt = get_event()) != no_evt){
+        if(evt == rx_assert_evt){
+            // started receiving
+            rx_ready = false;
+        }else if(evt == rx_deassert_evt){
+            // finished receiving
+            struct frame_record record;
+            record.time_us = to_us_since_boot(get_absolute_time());
+            record.status  = readPacket(record.buffer);
+            link_stats_add(&stats, record.buffer, record.status, record.time_us);
+            ber_add_frame(&ber, record.buffer, record.status);
+            afc_update_rx(&afc, record.status);
+            rate_control_received(&rate, record.status);
+            if(arq.enabled){
+                arq_received(&arq, record.buffer, record.status);
+            }
+            cc2500_start_listen(&radio_rx);
+            rx_ready = true;
+            if(print_frames && usb_stream_active()){
+                usb_stream_add_frame(record.buffer, record.status, record.time_us); // binary record, without the output task
+            }else if(print_frames){
+                if(!queue_try_add(&output_queue, &record)){
+                    output_dropped++;
+                }
+                scheduler_release(&sched, output_task_id);
+            }
+        }
+    }
+}
+
+void radio_event(CC2500 *radio){
+    scheduler_release(&sched, rx_task_id);
+}
+
+/* command handling: released when core 1 queued a command */
+void command_task(void *context){
+    do_commands();
+}
+
+/* output: one received frame per run (to keep the TX release latency low) and periodic summaries */
+void output_task(void *context){
+    struct frame_record record;
+    if(queue_try_remove(&output_queue, &record)){
+        printPacket(record.buffer, record.status, record.time_us);
+        if(!queue_is_empty(&output_queue)){
+            scheduler_release(&sched, output_task_id);
+        }
+    }
+    if(!print_frames && STATS_INTERVAL_MS > 0 && link_stats_window_elapsed(&stats, to_us_since_boot(get_absolute_time()), STATS_INTERVAL_MS)){
+        link_stats_report(&stats, to_us_since_boot(get_absolute_time()));
+        ber_report(&ber, stats.total.sent - min(stats.total.sent, stats.total.received));
+    }
+}
+
 int main() {
     /* setup SPI */
     stdio_init_all();
+    usb_stream_init();
     // Setup USB input on second core
     mutex_init(&setting_mutex);
     mutex_enter_blocking(&setting_mutex);
@@ -157,98 +851,85 @@ int main() {
     gpio_set_dir(CARRIER_CSN, GPIO_OUT);
     gpio_put(CARRIER_CSN, 1);
     bi_decl(bi_1pin_with_name(CARRIER_CSN, "SPI Carrier CS"));
-
-    sleep_ms(5000);
+#if SPI_BUS
+    spi_bus_init(&radio_bus, RADIO_SPI);
+    radio_rx.bus      = &radio_bus;
+    radio_carrier.bus = &radio_bus;
+#endif
 
     /* setup backscatter state machine */
-    PIO pio = pio0;
-    uint sm = 0;
-    struct backscatter_config backscatter_conf;
-    uint16_t instructionBuffer[32] = {0}; // maximal instruction size: 32
-    backscatter_program_init(pio, sm, PIN_TX1, PIN_TX2, CLOCK_DIV0, CLOCK_DIV1, DESIRED_BAUD, &backscatter_conf, instructionBuffer, TWOANTENNAS);
-
-    static uint8_t message[buffer_size(PAYLOADSIZE+2, HEADER_LEN)*4] = {0};  // include 10 header bytes
-    static uint32_t buffer[buffer_size(PAYLOADSIZE, HEADER_LEN)] = {0}; // initialize the buffer
-    static uint8_t seq = 0;
-    uint8_t *header_tmplate = packet_hdr_template(RECEIVER);
-    uint8_t tx_payload_buffer[PAYLOADSIZE];
+    struct persisted_config persisted;
+    bool restored = PERSIST_CONFIG && config_store_load(&persisted, sizeof(struct persisted_config), CONFIG_VERSION);
+    tag_cal_restore(&tag_cal, restored && persisted.tag_cal, restored ? persisted.tag_cal_offset_hz : 0);
+    if(restored){
+        memcpy(instructionBuffer, persisted.instructions, sizeof(instructionBuffer));
+        set_modulation_flags(persisted.modulation);
+        backscatter_program_load(pio, sm, PIN_TX1, PIN_TX2, persisted.div0, persisted.div1, persisted.baud, instructionBuffer, persisted.program_length, &backscatter_conf, TWOANTENNAS);
+    }else{
+        if(USB_WAIT_MS > 0){
+            absolute_time_t usb_timeout = make_timeout_time_ms(USB_WAIT_MS);
+            while(!usb_stream_console_connected() && !time_reached(usb_timeout)){
+                sleep_ms(1);
+            }
+        }
+        backscatter_program_init(pio, sm, PIN_TX1, PIN_TX2, CLOCK_DIV0, CLOCK_DIV1, DESIRED_BAUD, &backscatter_conf, instructionBuffer, TWOANTENNAS);
+    }
 
     /* Setup carrier */
     setupCarrier();
     set_frecuency_tx(CARRIER_FEQ);
-    sleep_ms(1);
+    carrier_standby_tx(CARRIER_STANDBY);
 
     /* Start Receiver */
-    event_t evt = no_evt;
-    Packet_status status;
-    uint8_t rx_buffer[RX_BUFFER_SIZE];
-    uint64_t time_us;
     setupReceiver();
-    set_frecuency_rx(CARRIER_FEQ + backscatter_conf.center_offset);
-    set_frequency_deviation_rx(backscatter_conf.deviation);
-    set_datarate_rx(backscatter_conf.baudrate);
-    set_filter_bandwidth_rx(backscatter_conf.minRxBw);
-    sleep_ms(1);
+    if(restored){
+        write_burst_rx(PROFILE_FIRST_REGISTER, persisted.rx_registers, PROFILE_BLOCK_SIZE);
+        mutex_enter_blocking(&setting_mutex);
+        current_CENTER    = persisted.center;
+        current_DEVIATION = persisted.deviation;
+        current_BAUDRATE  = persisted.baudrate;
+        current_MIN_RX_BW = persisted.min_rx_bw;
+        current_DIV0      = persisted.div0;
+        current_DIV1      = persisted.div1;
+        current_BAUD      = persisted.baud;
+        mutex_exit(&setting_mutex);
+    }else{
+        set_frecuency_rx(rx_center_frequency());
+        set_frequency_deviation_rx(backscatter_conf.deviation);
+        set_datarate_rx(backscatter_conf.baudrate);
+        set_filter_bandwidth_rx(backscatter_conf.minRxBw);
+        sleep_ms(1);
+    }
+    afc_init_rx(&afc, restored ? persisted.afc : AFC_ENABLED);
+    apply_tag_calibration();
     RX_start_listen();
     printf("started listening\n");
-    bool rx_ready = true;
+    link_stats_init(&stats, to_us_since_boot(get_absolute_time()));
+    ber_init(&ber, BER_FIXED_PATTERN, BER_PATTERN, PAYLOADSIZE);
+    rate_control_init(&rate, restored ? persisted.rate : RATE_ADAPTIVE, restored ? persisted.rate_step : RATE_LADDER_STEPS-1);
+    arq_init(&arq, restored ? persisted.arq : RELIABLE_DELIVERY, to_us_since_boot(get_absolute_time()));
+    bench_init(&bench, BER_PATTERN);
+    seq_init(&sequence, BER_PATTERN);
+    if(rate.enabled && !restored){
+        apply_rate_step(rate.step);
+    }
+    boot_us = (uint32_t) to_us_since_boot(get_absolute_time());
 
     printControlInfo();
 
-    /* loop */
-    absolute_time_t next_release_1 = delayed_by_ms(get_absolute_time(), TX_DURATION);
-    absolute_time_t next_release_2 = delayed_by_ms(next_release_1, TX_DURATION);
-    while (true) {
-        while(absolute_time_diff_us(get_absolute_time(), next_release_1));
-        next_release_1 = next_release_2;
-        next_release_2 = delayed_by_ms(next_release_1, TX_DURATION);
-
-        do_commands();
-        evt = get_event();
-        switch(evt){
-            case rx_assert_evt:
-                // started receiving
-                rx_ready = false;
-            break;
-            case rx_deassert_evt:
-                // finished receiving
-                time_us = to_us_since_boot(get_absolute_time());
-                status = readPacket(rx_buffer);
-                printPacket(rx_buffer,status,time_us);
-                RX_start_listen();
-                sleep_ms(1);
-                rx_ready = true;
-            //break;   // don't break still transmit next packet
-            case no_evt:
-                // backscatter new packet if receiver is listening
-                if (rx_ready){
-                    /* generate new data */
-                    // generate_data(tx_payload_buffer, PAYLOADSIZE, true);
-                    for(uint8_t i = 0; i < PAYLOADSIZE; i++){
-                        tx_payload_buffer[i] = 0xA5;                                    // FOR DEMO: fixed payload of 0xA5
-                    }
-
-                    /* add header (10 byte) to packet */
-                    add_header(&message[0], 0xA5, header_tmplate);                      // FOR DEMO: fixed sequence number of 0xA5
-                    /* add payload to packet */
-                    memcpy(&message[HEADER_LEN], tx_payload_buffer, PAYLOADSIZE);
-
-                    /* casting for 32-bit fifo */
-                    for (uint8_t i=0; i < buffer_size(PAYLOADSIZE, HEADER_LEN); i++) {
-                        buffer[i] = ((uint32_t) message[4*i+3]) | (((uint32_t) message[4*i+2]) << 8) | (((uint32_t) message[4*i+1]) << 16) | (((uint32_t)message[4*i]) << 24);
-                    }
-                    /* put the data to FIFO (start backscattering) */
-                    startCarrier();
-                    sleep_ms(1); // wait for carrier to start
-                    backscatter_send(pio,sm,buffer,buffer_size(PAYLOADSIZE, HEADER_LEN));
-                    sleep_ms(ceil((((double) buffer_size(PAYLOADSIZE, HEADER_LEN))*8000.0)/((double) DESIRED_BAUD))+3); // wait transmission duration (+3ms)
-                    stopCarrier();
-                    /* increase seq number*/ 
-                    seq++;
-                }
-            break;
-        }
-    }
+    /* scheduler: all work is done in the tasks, the core sleeps inbetween */
+    queue_init(&output_queue, sizeof(struct frame_record), OUTPUT_QUEUE_LENGTH);
+    scheduler_init(&sched);
+    tx_task_id        = scheduler_add_task(&sched, "tx",       tx_task,        NULL, NULL);
+    rx_task_id        = scheduler_add_task(&sched, "rx",       rx_task,        NULL, NULL);
+    command_task_id   = scheduler_add_task(&sched, "command",  command_task,   NULL, queued_command);
+    bench_task_id     = scheduler_add_task(&sched, "bench",    bench_task,     NULL, NULL); // re-released after every frame: below the commands
+    sequencer_task_id = scheduler_add_task(&sched, "sequence", sequencer_task, NULL, NULL);
+    output_task_id    = scheduler_add_task(&sched, "output",   output_task,    NULL, NULL);
+    cc2500_set_event_handler(radio_event);
+    update_tx_period();
+    scheduler_set_period(&sched, output_task_id, OUTPUT_PERIOD_MS * 1000);
+    scheduler_run(&sched);
 
     /* stop carrier and receiver - never reached */
     RX_stop_listen();
@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+'''
+Tobias Mages & Wenqing Yan
+Upload an experiment sequence to the carrier-receiver-baseband board using the binary command protocol
+(project_pico_libs/protocol.h), run it and print the streamed step results as CSV.
+
+The sequence file has one step per line (# starts a comment):
+    <start offset [us], 0: after the previous step> config <d0> <d1> <baud>
+    <start offset [us]> power <dBm>
+    <start offset [us]> frames <count> <payload length>
+    <start offset [us]> pause <duration [us]>
+
+usage: python sequence.py <sequence file> [repetitions] [serial port]
+'''
+
+import struct
+import sys
+import serial
+
+PORT = '/dev/tty.usbmodem101'
+SOF = 0x02
+ACK = ord('A')
+RESULT = ord('R')
+STATUS = ['ok', 'invalid', 'crc error', 'busy']
+STEP_TYPES = {'config': 1, 'power': 2, 'frames': 3, 'pause': 4}
+RESULT_FIELDS = ['iteration', 'step', 'type', 'status', 'start_us', 'late_us', 'duration_us',
+                 'sent', 'received', 'crc_pass', 'bit_errors', 'bits', 'rssi']
+
+def crc16(data):
+    # CC2500 CRC-16 (polynomial 0x8005, initial value 0xFFFF), see packet_crc16()
+    crc = 0xFFFF
+    for byte in data:
+        for _ in range(8):
+            if ((crc & 0x8000) >> 8) ^ (byte & 0x80):
+                crc = ((crc << 1) ^ 0x8005) & 0xFFFF
+            else:
+                crc = (crc << 1) & 0xFFFF
+            byte = (byte << 1) & 0xFF
+    return crc
+
+def encode(seq, command, values):
+    body = bytes([2 + 4*len(values), seq, ord(command)]) + b''.join(struct.pack('<I', v & 0xFFFFFFFF) for v in values)
+    return bytes([SOF]) + body + struct.pack('>H', crc16(body))
+
+class Board:
+    def __init__(self, port):
+        self.serial = serial.Serial(port, timeout=1)
+        self.seq = 0
+        self.text = b''
+
+    def read_frame(self):
+        # skip the text output until the next frame
+        while True:
+            byte = self.serial.read(1)
+            if len(byte) == 0:
+                return None
+            if byte[0] != SOF:
+                self.text += byte
+                continue
+            length = self.serial.read(1)
+            if len(length) == 0:
+                return None
+            rest = self.serial.read(length[0] + 2)
+            body = length + rest[:-2]
+            if len(rest) != length[0] + 2 or crc16(body) != struct.unpack('>H', rest[-2:])[0]:
+                continue
+            return body[1], body[2], body[3:]
+
+    def command(self, command, values=(), retries=3):
+        self.seq = (self.seq + 1) & 0xFF
+        for _ in range(retries):
+            self.serial.write(encode(self.seq, command, values))
+            while True:
+                frame = self.read_frame()
+                if frame is None:
+                    break # timeout: send again (the board acknowledges a repeated frame without executing it twice)
+                seq, kind, data = frame
+                if kind == ACK and seq == self.seq:
+                    if data[1] != 0:
+                        raise RuntimeError("command '%s' %s: %s" % (command, values, STATUS[min(data[1], len(STATUS)-1)]))
+                    return
+        raise RuntimeError("command '%s' not acknowledged" % command)
+
+    def results(self, count):
+        received = 0
+        while received < count:
+            frame = self.read_frame()
+            if frame is None:
+                continue # long steps
+            seq, kind, data = frame
+            if kind == RESULT:
+                received += 1
+                yield struct.unpack('<12Ii', data)
+
+def read_sequence(filename):
+    steps = []
+    for line in open(filename):
+        fields = line.split('#')[0].split()
+        if len(fields) == 0:
+            continue
+        args = [int(x) for x in fields[2:]] + [0, 0, 0]
+        steps.append([STEP_TYPES[fields[1]], int(fields[0])] + args[:3])
+    return steps
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+    steps = read_sequence(sys.argv[1])
+    repeat = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+    board = Board(sys.argv[3] if len(sys.argv) > 3 else PORT)
+
+    board.command('u') # clear
+    for step in steps:
+        board.command('u', step)
+    board.command('x', [repeat])
+    print(','.join(RESULT_FIELDS))
+    for result in board.results(len(steps) * repeat):
+        print(','.join(str(x) for x in result))
@@ -0,0 +1,117 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+'''
+Tobias Mages & Wenqing Yan
+Read the binary frame records of the USB packet stream (build option USB_STREAM, see project_pico_libs/usb_stream.h)
+and write them as CSV. The console (commands, summaries) stays available on the serial port of the board.
+
+A reader thread only collects large bulk transfers, parsing and writing the file happens in the main thread:
+the endpoint is therefore read continuously, even if the file system stalls.
+Once per second, the record rate, the throughput and the dropped records (sequence gaps) are printed.
+
+usage: python stream-reader.py [output file]
+requires pyusb (and libusb, on Windows with the WinUSB driver installed for the "Backscatter stream" interface)
+'''
+
+import queue
+import struct
+import sys
+import threading
+import time
+from datetime import datetime
+import usb.core
+import usb.util
+
+VID = 0xCAFE # USB_STREAM_VID
+PID = 0x4253 # USB_STREAM_PID
+INTERFACE = 2
+EP_OUT = 0x03
+EP_IN = 0x83
+TRANSFER_SIZE = 16384
+SYNC = 0xA5
+RECORD = struct.Struct('<BBBbB3xIQ') # sync, length, flags, rssi, lqi, sequence, time_us
+FLAG_CRC = 0x01
+FLAG_OVERFLOW = 0x02
+
+def read_endpoint(device, chunks, running):
+    while running.is_set():
+        try:
+            chunks.put(bytes(device.read(EP_IN, TRANSFER_SIZE, timeout=100)))
+        except usb.core.USBTimeoutError:
+            pass
+
+class Parser:
+    def __init__(self):
+        self.data = b''
+        self.next_sequence = None
+        self.records = 0
+        self.dropped = 0
+
+    def feed(self, chunk):
+        self.data += chunk
+        offset = 0
+        while len(self.data) - offset >= RECORD.size:
+            if self.data[offset] != SYNC:
+                offset += 1 # only after opening (the endpoint may still hold a partial record)
+                continue
+            sync, length, flags, rssi, lqi, sequence, time_us = RECORD.unpack_from(self.data, offset)
+            if len(self.data) - offset < RECORD.size + length:
+                break
+            packet = self.data[offset + RECORD.size:offset + RECORD.size + length]
+            offset += RECORD.size + length
+            if self.next_sequence is not None:
+                self.dropped += (sequence - self.next_sequence) & 0xFFFFFFFF
+            self.next_sequence = (sequence + 1) & 0xFFFFFFFF
+            self.records += 1
+            yield sequence, time_us, rssi, lqi, flags, packet
+        self.data = self.data[offset:]
+
+if __name__ == '__main__':
+    now = datetime.now()
+    filename = sys.argv[1] if len(sys.argv) > 1 else f'./stream_{now.year:04}-{now.month:02}-{now.day:02}_{now.hour:02}-{now.minute:02}-{now.second:02}.csv'
+
+    device = usb.core.find(idVendor=VID, idProduct=PID)
+    if device is None:
+        print('Sorry, no board with the USB packet stream was found (build with -DUSB_STREAM=ON).')
+        sys.exit(1)
+    if sys.platform != 'win32' and device.is_kernel_driver_active(INTERFACE):
+        device.detach_kernel_driver(INTERFACE)
+    usb.util.claim_interface(device, INTERFACE)
+
+    chunks = queue.Queue()
+    running = threading.Event()
+    running.set()
+    reader = threading.Thread(target=read_endpoint, args=(device, chunks, running), daemon=True)
+    reader.start()
+    device.write(EP_OUT, b'S') # open the stream
+    print(f'Streaming to {filename} (stop with Ctrl+C)...')
+
+    parser = Parser()
+    received_bytes = 0
+    last_report = time.time()
+    last_records = 0
+    last_bytes = 0
+    try:
+        with open(filename, 'w', newline='\n') as output:
+            output.write('sequence,time_us,rssi,lqi,crc,overflow,packet\n')
+            while True:
+                try:
+                    chunk = chunks.get(timeout=0.5)
+                    received_bytes += len(chunk)
+                    for sequence, time_us, rssi, lqi, flags, packet in parser.feed(chunk):
+                        output.write(f'{sequence},{time_us},{rssi},{lqi},{int(bool(flags & FLAG_CRC))},{int(bool(flags & FLAG_OVERFLOW))},{packet.hex()}\n')
+                except queue.Empty:
+                    pass
+                if time.time() - last_report >= 1:
+                    elapsed = time.time() - last_report
+                    print(f'{(parser.records - last_records) / elapsed:8.1f} records/s | {(received_bytes - last_bytes) / elapsed / 1000:8.1f} kB/s | records {parser.records} | dropped {parser.dropped} | host queue {chunks.qsize()}')
+                    last_report, last_records, last_bytes = time.time(), parser.records, received_bytes
+    except KeyboardInterrupt:
+        pass
+    finally:
+        device.write(EP_OUT, b'E') # close: the board prints the frames on the console again
+        running.clear()
+        reader.join()
+        usb.util.release_interface(device, INTERFACE)
+        print(f'{parser.records} records, {parser.dropped} dropped on the board')
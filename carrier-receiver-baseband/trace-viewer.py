@@ -0,0 +1,154 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+'''
+Tobias Mages & Wenqing Yan
+Render the hot-path event trace (build option TRACE, see project_pico_libs/trace.h): reads the "trace | ..." lines
+of the command z either from a log file (e.g. written by serial-print.py) or directly from the board, prints the
+latency statistics of event pairs and plots a timeline (one lane per span, both cores) and latency histograms.
+
+usage example: python trace-viewer.py received_2024-01-01_12-00-00.txt
+usage example: python trace-viewer.py --port /dev/ttyACM0 --save trace.png
+requires matplotlib (and pyserial for --port)
+'''
+
+import argparse
+import sys
+
+TASKS = ['tx', 'rx', 'command', 'bench', 'sequence', 'output'] # order of scheduler_add_task in main.c
+
+# spans of the timeline: start event, end event, label (same argument: per GDO0 pin / scheduler task)
+SPANS = [
+    ('GDO0_RISE',         'GDO0_FALL',         'GDO0 (sync word to end)', True),
+    ('READ_PACKET',       'READ_PACKET_DONE',  'readPacket',              False),
+    ('PRINT_PACKET',      'PRINT_PACKET_DONE', 'printPacket',             False),
+    ('CARRIER_START',     'CARRIER_ON',        'carrier start',           False),
+    ('CARRIER_ON',        'CARRIER_STOP',      'carrier on',              False),
+    ('BACKSCATTER_START', 'BACKSCATTER_DONE',  'backscatter',             False),
+    ('TASK_START',        'TASK_END',          'task',                    True),
+]
+
+# latency histograms: from event, to (next) event, label
+LATENCIES = [
+    ('GDO0_FALL',         'READ_PACKET',       'GDO0 edge -> readPacket'),
+    ('READ_PACKET',       'READ_PACKET_DONE',  'readPacket'),
+    ('READ_PACKET_DONE',  'RX_LISTEN',         'readPacket -> listening again'),
+    ('GDO0_FALL',         'PRINT_PACKET',      'GDO0 edge -> printPacket'),
+    ('PRINT_PACKET',      'PRINT_PACKET_DONE', 'printPacket'),
+    ('CARRIER_START',     'CARRIER_ON',        'carrier start'),
+    ('BACKSCATTER_START', 'BACKSCATTER_DONE',  'backscatter'),
+    ('BACKSCATTER_DONE',  'GDO0_FALL',         'backscatter end -> GDO0 edge'),
+]
+
+# "trace | core time event name arg", returns a list of (time_us, core, name, arg) sorted by time
+def parse(lines):
+    records = []
+    last = {}
+    offset = {}
+    for line in lines:
+        if 'trace | ' not in line:
+            continue
+        fields = line.split('trace | ', 1)[1].split()
+        if len(fields) != 5 or not fields[0].isdigit():
+            continue # header, end or disabled
+        core, time, name, arg = int(fields[0]), int(fields[1]), fields[3], int(fields[4])
+        if time < last.get(core, 0):
+            offset[core] = offset.get(core, 0) + (1 << 32) # the 32 bit timer wrapped
+        last[core] = time
+        records.append((time + offset.get(core, 0), core, name, arg))
+    return sorted(records)
+
+def read_board(port):
+    import serial
+    with serial.Serial(port, 115200, timeout=2) as ser:
+        ser.reset_input_buffer()
+        ser.write(b'z\n')
+        lines = []
+        while True:
+            line = ser.readline().decode('utf-8', errors='replace')
+            if line == '':
+                break # timeout
+            lines.append(line)
+            if 'trace | end' in line or 'trace | disabled' in line:
+                break
+        return lines
+
+# durations between a start event and the next end event (with the same argument, if required)
+def pairs(records, start, end, same_arg=False):
+    pending = {}
+    result = []
+    for time, core, name, arg in records:
+        key = arg if same_arg else 0
+        if name == start:
+            pending[key] = (time, core, arg)
+        elif name == end and key in pending:
+            begin, begin_core, begin_arg = pending.pop(key)
+            result.append((begin, time - begin, begin_core, begin_arg))
+    return result
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p / 100 * len(values)))]
+
+def span_label(label, arg):
+    if label == 'task':
+        return f'task {TASKS[arg] if arg < len(TASKS) else arg}'
+    if label.startswith('GDO0'):
+        return f'{label} pin {arg}'
+    return label
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(prog='trace-viewer', description='Timeline and latency histograms of the event trace (command z)')
+    parser.add_argument('log', nargs='?', help='log file with the output of the command z')
+    parser.add_argument('--port', help='read the trace directly from the board (sends z)')
+    parser.add_argument('--save', help='write the figure to this file instead of showing it')
+    parser.add_argument('--bins', type=int, default=40)
+    args = parser.parse_args()
+
+    if args.port:
+        lines = read_board(args.port)
+    elif args.log:
+        with open(args.log, errors='replace') as file:
+            lines = file.readlines()
+    else:
+        parser.print_usage()
+        sys.exit(1)
+    records = parse(lines)
+    if len(records) == 0:
+        print('No trace records found (build with -DTRACE=ON and dump with z).')
+        sys.exit(1)
+    start = records[0][0]
+    print(f'{len(records)} records over {(records[-1][0] - start) / 1000:.1f} ms')
+
+    latencies = [(label, [duration for _, duration, _, _ in pairs(records, begin, end)]) for begin, end, label in LATENCIES]
+    latencies = [(label, values) for label, values in latencies if len(values) > 0]
+    print(f'{"latency [us]":32} {"count":>6} {"mean":>8} {"p50":>8} {"p99":>8} {"max":>8}')
+    for label, values in latencies:
+        print(f'{label:32} {len(values):6} {sum(values) / len(values):8.1f} {percentile(values, 50):8} {percentile(values, 99):8} {max(values):8}')
+
+    import matplotlib.pyplot as plt
+    columns = min(4, max(1, len(latencies)))
+    rows = 1 + (len(latencies) + columns - 1) // columns
+    figure = plt.figure(figsize=(4 * columns, 3 * rows))
+    timeline = figure.add_subplot(rows, 1, 1)
+    lanes = []
+    for begin, end, label, same_arg in SPANS:
+        for time, duration, core, arg in pairs(records, begin, end, same_arg):
+            lane = f'core {core} | {span_label(label, arg)}'
+            if lane not in lanes:
+                lanes.append(lane)
+            timeline.broken_barh([((time - start) / 1000, max(duration, 1) / 1000)], (lanes.index(lane) - 0.4, 0.8), color=f'C{lanes.index(lane) % 10}')
+    timeline.set_yticks(range(len(lanes)))
+    timeline.set_yticklabels(lanes, fontsize=7)
+    timeline.set_xlabel('time [ms]')
+    timeline.grid(axis='x')
+    for i, (label, values) in enumerate(latencies):
+        histogram = figure.add_subplot(rows, columns, columns + i + 1)
+        histogram.hist(values, bins=args.bins)
+        histogram.set_title(label, fontsize=8)
+        histogram.set_xlabel('[us]', fontsize=7)
+    figure.tight_layout()
+    if args.save:
+        figure.savefig(args.save, dpi=150)
+    else:
+        plt.show()
@@ -0,0 +1,676 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Host emulator of the CC2500 SPI interface (see cc2500_emulator.h)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "cc2500_emulator.h"
+
+#define EMU_CONFIG_REGISTERS  0x2F
+#define EMU_GPIO_COUNT          30
+
+// register values after reset (datasheet, table 36)
+static const uint8_t reset_values[EMU_CONFIG_REGISTERS] = {
+  0x29, 0x2E, 0x3F, 0x07, 0xD3, 0x91, 0xFF, 0x04, // 0x00 IOCFG2 ... 0x07 PKTCTRL1
+  0x45, 0x00, 0x00, 0x0F, 0x00, 0x5E, 0xC4, 0xEC, // 0x08 PKTCTRL0 ... 0x0F FREQ0
+  0x8C, 0x22, 0x02, 0x22, 0xF8, 0x47, 0x07, 0x30, // 0x10 MDMCFG4 ... 0x17 MCSM1
+  0x04, 0x36, 0x6C, 0x03, 0x40, 0x91, 0x87, 0x6B, // 0x18 MCSM0 ... 0x1F WOREVT0
+  0xF8, 0x56, 0x10, 0xA9, 0x0A, 0x20, 0x0D, 0x41, // 0x20 WORCTRL ... 0x27 RCCTRL1
+  0x00, 0x59, 0x7F, 0x3F, 0x88, 0x31, 0x0B        // 0x28 RCCTRL0 ... 0x2E TEST0
+};
+
+enum spi_phase {
+  EXPECT_HEADER,
+  SINGLE_DATA,
+  BURST_DATA
+};
+
+struct emu_device {
+  char     name[16];
+  uint8_t  csn;
+  uint8_t  gdo0;
+  bool     selected;
+  // radio
+  uint8_t  regs[EMU_CONFIG_REGISTERS];
+  uint8_t  patable[8];
+  enum emu_marcstate state;
+  enum emu_marcstate state_after_calibration;
+  uint64_t calibrated_at_ns;
+  uint8_t  rx_fifo[EMU_FIFO_SIZE];
+  uint8_t  rx_level;
+  bool     rx_overflow;
+  uint8_t  tx_fifo[EMU_FIFO_SIZE];
+  uint8_t  tx_level;
+  uint8_t  freqest;
+  uint8_t  lqi;
+  uint8_t  rssi;
+  // SPI transaction
+  enum spi_phase phase;
+  uint8_t  address;
+  bool     read;
+  uint8_t  patable_index;
+  struct emu_counters counters;
+};
+
+static struct emu_device devices[EMU_MAX_DEVICES];
+static int device_count = 0;
+static struct emu_counters bus;
+static uint64_t now_ns = 0;
+
+static bool gpio_level[EMU_GPIO_COUNT];
+static uint32_t gpio_irq_mask[EMU_GPIO_COUNT];
+static gpio_irq_callback_t gpio_callback = NULL;
+
+spi_inst_t emu_spi0 = {.baudrate = 1000000};
+spi_inst_t emu_spi1 = {.baudrate = 1000000};
+pio_hw_t   emu_pio0, emu_pio1;
+
+struct emu_dma_channel {
+  bool                   claimed;
+  bool                   busy;
+  bool                   read_increment, write_increment;
+  volatile void         *write_addr;
+  const volatile void   *read_addr;
+  uint                   count;
+  bool                   irq0_enabled, irq0_status;
+};
+static struct emu_dma_channel dma[NUM_DMA_CHANNELS];
+static irq_handler_t dma_irq0_handler = NULL;
+static bool dma_irq0_enabled = false;
+static bool dma_running      = false;
+static uint exception        = 0; // interrupt handler being run (exception number), 0: thread mode
+
+/* ---------------------------------------------------------------------------------------------- */
+/* radio model                                                                                      */
+/* ---------------------------------------------------------------------------------------------- */
+
+static void device_reset(struct emu_device *dev) {
+    memcpy(dev->regs, reset_values, EMU_CONFIG_REGISTERS);
+    memset(dev->patable, 0, sizeof(dev->patable));
+    dev->patable[0]  = 0xC6;
+    dev->state       = EMU_IDLE;
+    dev->calibrated_at_ns = 0;
+    dev->rx_level    = 0;
+    dev->rx_overflow = false;
+    dev->tx_level    = 0;
+    dev->freqest     = 0;
+    dev->lqi         = 0;
+    dev->rssi        = 0x80; // -134 dBm: nothing received
+}
+
+// the calibration ends after EMU_CALIBRATION_US of virtual time
+static void update_state(struct emu_device *dev) {
+    if(dev->state == EMU_MANCAL && now_ns >= dev->calibrated_at_ns){
+        dev->state = dev->state_after_calibration;
+        // deterministic "calibration result" depending on the frequency word
+        dev->regs[0x23] = 0xA9;
+        dev->regs[0x24] = 0x0A;
+        dev->regs[0x25] = (dev->regs[0x0E] ^ dev->regs[0x0F]) & 0x3F;
+    }
+}
+
+static void calibrate(struct emu_device *dev, enum emu_marcstate next) {
+    dev->state = EMU_MANCAL;
+    dev->state_after_calibration = next;
+    dev->calibrated_at_ns = now_ns + (uint64_t) EMU_CALIBRATION_US * 1000;
+}
+
+// IDLE -> RX/TX/FSTXON: calibrate first if FS_AUTOCAL = 1 (MCSM0[5:4])
+static void enter_active(struct emu_device *dev, enum emu_marcstate next) {
+    update_state(dev);
+    if(dev->state == EMU_IDLE && ((dev->regs[0x18] >> 4) & 0x03) == 1){
+        calibrate(dev, next);
+    }else if(dev->state != EMU_MANCAL){
+        dev->state = next;
+    }else{
+        dev->state_after_calibration = next;
+    }
+}
+
+static void strobe(struct emu_device *dev, uint8_t cmd) {
+    dev->counters.strobes++;
+    bus.strobes++;
+    update_state(dev);
+    switch(cmd){
+        case 0x30: // SRES
+            device_reset(dev);
+            break;
+        case 0x31: // SFSTXON
+            enter_active(dev, EMU_FSTXON);
+            break;
+        case 0x32: // SXOFF
+        case 0x39: // SPWD
+            dev->state = EMU_SLEEP;
+            break;
+        case 0x33: // SCAL
+            if(dev->state == EMU_IDLE){
+                calibrate(dev, EMU_IDLE);
+            }
+            break;
+        case 0x34: // SRX
+            enter_active(dev, EMU_RX);
+            break;
+        case 0x35: // STX
+            if(dev->state == EMU_RX && (dev->regs[0x17] & 0x30) != 0){
+                break; // CCA_MODE: stay in RX if the channel is not clear (not modelled: never clear)
+            }
+            enter_active(dev, EMU_TX);
+            break;
+        case 0x36: // SIDLE
+            dev->state = EMU_IDLE;
+            break;
+        case 0x37: // SAFC: FSCTRL0 += FREQEST
+            dev->regs[0x0C] = (uint8_t) (dev->regs[0x0C] + dev->freqest);
+            break;
+        case 0x3A: // SFRX (only in IDLE or RXFIFO_OVERFLOW)
+            if(dev->state == EMU_IDLE || dev->state == EMU_RXFIFO_OVERFLOW){
+                dev->rx_level    = 0;
+                dev->rx_overflow = false;
+                if(dev->state == EMU_RXFIFO_OVERFLOW){
+                    dev->state = EMU_IDLE;
+                }
+            }
+            break;
+        case 0x3B: // SFTX
+            if(dev->state == EMU_IDLE || dev->state == EMU_TXFIFO_UNDERFLOW){
+                dev->tx_level = 0;
+            }
+            break;
+        default:   // SWOR, SWORRST, SNOP
+            break;
+    }
+}
+
+// chip status byte (datasheet, section 10.1)
+static uint8_t status_byte(struct emu_device *dev, bool read) {
+    update_state(dev);
+    uint8_t state;
+    switch(dev->state){
+        case EMU_IDLE:             state = 0; break;
+        case EMU_RX:               state = 1; break;
+        case EMU_TX:               state = 2; break;
+        case EMU_FSTXON:           state = 3; break;
+        case EMU_MANCAL:           state = 4; break;
+        case EMU_RXFIFO_OVERFLOW:  state = 6; break;
+        case EMU_TXFIFO_UNDERFLOW: state = 7; break;
+        default:                   state = 0; break;
+    }
+    uint8_t fifo = read ? dev->rx_level : (EMU_FIFO_SIZE - 1 - dev->tx_level);
+    return (state << 4) | (fifo > 15 ? 15 : fifo);
+}
+
+static uint8_t read_status_register(struct emu_device *dev, uint8_t address) {
+    update_state(dev);
+    switch(address){
+        case 0x30: return 0x80;                 // PARTNUM
+        case 0x31: return 0x03;                 // VERSION
+        case 0x32: return dev->freqest;         // FREQEST
+        case 0x33: return dev->lqi;             // LQI
+        case 0x34: return dev->rssi;            // RSSI
+        case 0x35: return dev->state;           // MARCSTATE
+        case 0x38: return (dev->state == EMU_RX) ? 0x10 : 0x00; // PKTSTATUS (CS)
+        case 0x3A: return dev->tx_level;        // TXBYTES
+        case 0x3B: return (dev->rx_overflow ? 0x80 : 0x00) | dev->rx_level; // RXBYTES
+        default:   return 0x00;
+    }
+}
+
+static uint8_t access(struct emu_device *dev, uint8_t mosi) {
+    uint8_t address = dev->address;
+    if(dev->read){
+        dev->counters.register_reads++;
+        bus.register_reads++;
+        if(address < EMU_CONFIG_REGISTERS){
+            update_state(dev);
+            return dev->regs[address];
+        }
+        if(address == 0x3E){
+            return dev->patable[(dev->patable_index++) & 0x07];
+        }
+        if(address == 0x3F){
+            dev->counters.fifo_bytes++;
+            bus.fifo_bytes++;
+            if(dev->rx_level == 0){
+                return 0x00;
+            }
+            uint8_t value = dev->rx_fifo[0];
+            memmove(dev->rx_fifo, &dev->rx_fifo[1], --dev->rx_level);
+            return value;
+        }
+        return read_status_register(dev, address);
+    }
+    dev->counters.register_writes++;
+    bus.register_writes++;
+    if(address < EMU_CONFIG_REGISTERS){
+        dev->regs[address] = mosi;
+    }else if(address == 0x3E){
+        dev->patable[(dev->patable_index++) & 0x07] = mosi;
+    }else if(address == 0x3F){
+        dev->counters.fifo_bytes++;
+        bus.fifo_bytes++;
+        if(dev->tx_level < EMU_FIFO_SIZE){
+            dev->tx_fifo[dev->tx_level++] = mosi;
+        }
+    }
+    return status_byte(dev, false);
+}
+
+static uint8_t exchange(struct emu_device *dev, uint8_t mosi) {
+    if(dev->phase == EXPECT_HEADER){
+        bool    read    = mosi & 0x80;
+        bool    burst   = mosi & 0x40;
+        uint8_t address = mosi & 0x3F;
+        uint8_t miso    = status_byte(dev, read);
+        if(address >= 0x30 && address <= 0x3D && !burst){
+            strobe(dev, address);
+            return miso;
+        }
+        dev->address       = address;
+        dev->read          = read;
+        dev->patable_index = 0;
+        // status registers are single accesses even with the burst bit
+        dev->phase = (burst && !(address >= 0x30 && address <= 0x3D)) ? BURST_DATA : SINGLE_DATA;
+        return miso;
+    }
+    uint8_t miso = access(dev, mosi);
+    if(dev->phase == SINGLE_DATA){
+        dev->phase = EXPECT_HEADER;
+    }else if(dev->address < EMU_CONFIG_REGISTERS){
+        dev->address++; // burst access increments the address (FIFO and PATABLE keep it)
+    }
+    return miso;
+}
+
+static struct emu_device *selected_device(void) {
+    for(int i = 0; i < device_count; i++){
+        if(devices[i].selected){
+            return &devices[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t transfer_byte(spi_inst_t *spi, uint8_t mosi) {
+    uint64_t byte_ns = (8ull * 1000000000ull) / spi->baudrate;
+    now_ns          += byte_ns;
+    bus.bytes++;
+    bus.bus_time_ns += byte_ns;
+    struct emu_device *dev = selected_device();
+    if(dev == NULL){
+        return 0xFF;
+    }
+    dev->counters.bytes++;
+    dev->counters.bus_time_ns += byte_ns;
+    return exchange(dev, mosi);
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* emulator API                                                                                     */
+/* ---------------------------------------------------------------------------------------------- */
+
+int emu_add_device(uint8_t csn, uint8_t gdo0, const char *name) {
+    if(device_count >= EMU_MAX_DEVICES){
+        return -1;
+    }
+    struct emu_device *dev = &devices[device_count];
+    memset(dev, 0, sizeof(struct emu_device));
+    snprintf(dev->name, sizeof(dev->name), "%s", name);
+    dev->csn  = csn;
+    dev->gdo0 = gdo0;
+    device_reset(dev);
+    return device_count++;
+}
+
+void emu_reset_all(void) {
+    for(int i = 0; i < device_count; i++){
+        device_reset(&devices[i]);
+        memset(&devices[i].counters, 0, sizeof(struct emu_counters));
+        devices[i].selected = false;
+        devices[i].phase    = EXPECT_HEADER;
+    }
+    memset(&bus, 0, sizeof(bus));
+    now_ns = 0;
+}
+
+bool emu_inject_packet(int index, const uint8_t *payload, uint8_t len, int8_t rssi_dbm, uint8_t lqi, bool crc_ok, int8_t freqest) {
+    struct emu_device *dev = &devices[index];
+    emu_dma_flush();
+    update_state(dev);
+    if(dev->state != EMU_RX){
+        return false;
+    }
+    // RSSI register: (RSSI_dBm + offset) * 2 in two's complement (same offset as readPacket)
+    dev->rssi    = (uint8_t) (int8_t) ((rssi_dbm + 70) * 2);
+    dev->lqi     = (lqi & 0x7F) | (crc_ok ? 0x80 : 0x00);
+    dev->freqest = (uint8_t) freqest;
+    bool appended_status = (dev->regs[0x07] & 0x04) != 0; // PKTCTRL1.APPEND_STATUS
+
+    // sync word found: GDO0 asserts
+    uint8_t iocfg0 = dev->regs[0x02] & 0x3F;
+    if(iocfg0 == 0x06 && dev->gdo0 != EMU_NO_PIN && gpio_callback && (gpio_irq_mask[dev->gdo0] & GPIO_IRQ_EDGE_RISE)){
+        exception = 16 + IO_IRQ_BANK0;
+        gpio_callback(dev->gdo0, GPIO_IRQ_EDGE_RISE);
+        exception = 0;
+    }
+    uint8_t total = len + (appended_status ? 2 : 0);
+    for(uint8_t i = 0; i < total; i++){
+        uint8_t value = (i < len) ? payload[i] : ((i == len) ? dev->rssi : dev->lqi);
+        if(dev->rx_level >= EMU_FIFO_SIZE){
+            dev->rx_overflow = true;
+            dev->state       = EMU_RXFIFO_OVERFLOW;
+            break;
+        }
+        dev->rx_fifo[dev->rx_level++] = value;
+    }
+    if(dev->state == EMU_RX){
+        // end of packet: RXOFF_MODE (MCSM1[3:2])
+        switch((dev->regs[0x17] >> 2) & 0x03){
+            case 0: dev->state = EMU_IDLE;   break;
+            case 1: dev->state = EMU_FSTXON; break;
+            case 2: dev->state = EMU_TX;     break;
+            default:                         break;
+        }
+    }
+    // end of packet (or overflow): GDO0 de-asserts
+    if(iocfg0 == 0x06 && dev->gdo0 != EMU_NO_PIN && gpio_callback && (gpio_irq_mask[dev->gdo0] & GPIO_IRQ_EDGE_FALL)){
+        exception = 16 + IO_IRQ_BANK0;
+        gpio_callback(dev->gdo0, GPIO_IRQ_EDGE_FALL);
+        exception = 0;
+    }
+    return true;
+}
+
+uint8_t emu_register(int index, uint8_t address) {
+    emu_dma_flush();
+    return (address < EMU_CONFIG_REGISTERS) ? devices[index].regs[address] : read_status_register(&devices[index], address);
+}
+
+enum emu_marcstate emu_state(int index) {
+    emu_dma_flush();
+    update_state(&devices[index]);
+    return devices[index].state;
+}
+
+uint8_t emu_rx_fifo_level(int index) {
+    emu_dma_flush();
+    return devices[index].rx_level;
+}
+
+static spi_inst_t *data_register_of(const volatile void *address) {
+    if(address == &emu_spi0.hw.dr){
+        return &emu_spi0;
+    }
+    return (address == &emu_spi1.hw.dr) ? &emu_spi1 : NULL;
+}
+
+void emu_dma_flush(void) {
+    if(dma_running){
+        return; // called from the interrupt handler
+    }
+    dma_running = true;
+    bool transferred = true;
+    while(transferred){
+        transferred = false;
+        for(uint rx = 0; rx < NUM_DMA_CHANNELS; rx++){
+            spi_inst_t *spi = data_register_of(dma[rx].read_addr);
+            if(!dma[rx].busy || spi == NULL){
+                continue;
+            }
+            uint tx = 0;
+            while(tx < NUM_DMA_CHANNELS && !(dma[tx].busy && data_register_of(dma[tx].write_addr) == spi)){
+                tx++;
+            }
+            if(tx == NUM_DMA_CHANNELS){
+                continue;
+            }
+            const volatile uint8_t *src = dma[tx].read_addr;
+            volatile uint8_t *dst       = dma[rx].write_addr;
+            for(uint i = 0; i < dma[rx].count; i++){
+                uint8_t miso = transfer_byte(spi, src[dma[tx].read_increment ? i : 0]);
+                dst[dma[rx].write_increment ? i : 0] = miso;
+            }
+            dma[tx].busy        = false;
+            dma[rx].busy        = false;
+            dma[tx].irq0_status = dma[tx].irq0_enabled;
+            dma[rx].irq0_status = dma[rx].irq0_enabled;
+            transferred         = true;
+            if(dma_irq0_handler != NULL && dma_irq0_enabled && (dma[tx].irq0_status || dma[rx].irq0_status)){
+                exception = 16 + DMA_IRQ_0;
+                dma_irq0_handler();
+                exception = 0;
+            }
+        }
+    }
+    dma_running = false;
+}
+
+uint64_t emu_time_us(void) {
+    return now_ns / 1000;
+}
+
+struct emu_counters emu_get_counters(int index) {
+    return (index < 0) ? bus : devices[index].counters;
+}
+
+struct emu_snapshot emu_take_snapshot(void) {
+    return (struct emu_snapshot){.counters = bus, .time_ns = now_ns};
+}
+
+void emu_print_header(void) {
+    printf("%-34s %6s %6s %7s %6s %6s %6s %10s %10s\n", "driver call", "trans", "bytes", "strobes", "reg-wr", "reg-rd", "fifo", "bus [us]", "time [us]");
+}
+
+void emu_print_delta(const char *name, const struct emu_snapshot *before) {
+    const struct emu_counters *b = &before->counters;
+    printf("%-34s %6llu %6llu %7llu %6llu %6llu %6llu %10.1f %10.1f\n", name,
+           (unsigned long long) (bus.transactions - b->transactions),
+           (unsigned long long) (bus.bytes - b->bytes),
+           (unsigned long long) (bus.strobes - b->strobes),
+           (unsigned long long) (bus.register_writes - b->register_writes),
+           (unsigned long long) (bus.register_reads - b->register_reads),
+           (unsigned long long) (bus.fifo_bytes - b->fifo_bytes),
+           (bus.bus_time_ns - b->bus_time_ns) / 1000.0,
+           (now_ns - before->time_ns) / 1000.0);
+}
+
+/* ---------------------------------------------------------------------------------------------- */
+/* Pico SDK replacement                                                                             */
+/* ---------------------------------------------------------------------------------------------- */
+
+absolute_time_t get_absolute_time(void)                      { return now_ns / 1000; }
+uint64_t to_us_since_boot(absolute_time_t t)                  { return t; }
+uint64_t time_us_64(void)                                     { return now_ns / 1000; }
+absolute_time_t make_timeout_time_ms(uint32_t ms)             { return now_ns / 1000 + (uint64_t) ms * 1000; }
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + (uint64_t) ms * 1000; }
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) { return t + us; }
+bool time_reached(absolute_time_t t)                          { return now_ns / 1000 >= t; }
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return (int64_t) (to - from); }
+void sleep_ms(uint32_t ms)                                    { emu_dma_flush(); now_ns += (uint64_t) ms * 1000000; }
+void sleep_us(uint64_t us)                                    { emu_dma_flush(); now_ns += us * 1000; }
+void tight_loop_contents(void)                                { emu_dma_flush(); }
+uint __get_current_exception(void)                            { return exception; }
+
+void gpio_init(uint gpio)                       { if(gpio < EMU_GPIO_COUNT) gpio_level[gpio] = false; }
+void gpio_set_dir(uint gpio, bool out)          { (void) gpio; (void) out; }
+void gpio_set_function(uint gpio, uint fn)      { (void) gpio; (void) fn; }
+bool gpio_get(uint gpio)                        { return (gpio < EMU_GPIO_COUNT) ? gpio_level[gpio] : false; }
+
+void gpio_put(uint gpio, bool value) {
+    if(gpio >= EMU_GPIO_COUNT){
+        return;
+    }
+    bool previous    = gpio_level[gpio];
+    gpio_level[gpio] = value;
+    for(int i = 0; i < device_count; i++){
+        struct emu_device *dev = &devices[i];
+        if(dev->csn != gpio){
+            continue;
+        }
+        if(previous && !value){
+            // chip select asserted (active low)
+            dev->selected = true;
+            dev->phase    = EXPECT_HEADER;
+            dev->counters.transactions++;
+            bus.transactions++;
+            now_ns          += EMU_CS_OVERHEAD_NS;
+            bus.bus_time_ns += EMU_CS_OVERHEAD_NS;
+            dev->counters.bus_time_ns += EMU_CS_OVERHEAD_NS;
+        }else if(!previous && value){
+            dev->selected = false;
+            dev->phase    = EXPECT_HEADER;
+        }
+    }
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) {
+    if(gpio < EMU_GPIO_COUNT){
+        gpio_irq_mask[gpio] = enabled ? (gpio_irq_mask[gpio] | events) : (gpio_irq_mask[gpio] & ~events);
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, events, enabled);
+    gpio_callback = callback;
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    spi->baudrate = baudrate;
+    return baudrate;
+}
+
+int spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len) {
+    for(size_t i = 0; i < len; i++){
+        transfer_byte(spi, src[i]);
+    }
+    return (int) len;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+    for(size_t i = 0; i < len; i++){
+        dst[i] = transfer_byte(spi, repeated_tx_data);
+    }
+    return (int) len;
+}
+
+int spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len) {
+    for(size_t i = 0; i < len; i++){
+        dst[i] = transfer_byte(spi, src[i]);
+    }
+    return (int) len;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    (void) order_priority;
+    if(num == DMA_IRQ_0){
+        dma_irq0_handler = handler;
+    }
+}
+
+void irq_set_enabled(uint num, bool enabled) {
+    if(num == DMA_IRQ_0){
+        dma_irq0_enabled = enabled;
+    }
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void) channel;
+    return (dma_channel_config){.read_increment = true, .write_increment = false};
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size) { (void) c; (void) size; }
+void channel_config_set_dreq(dma_channel_config *c, uint dreq)           { (void) c; (void) dreq; }
+void channel_config_set_read_increment(dma_channel_config *c, bool incr)  { c->read_increment = incr; }
+void channel_config_set_write_increment(dma_channel_config *c, bool incr) { c->write_increment = incr; }
+
+int dma_claim_unused_channel(bool required) {
+    for(uint i = 0; i < NUM_DMA_CHANNELS; i++){
+        if(!dma[i].claimed){
+            dma[i].claimed = true;
+            return (int) i;
+        }
+    }
+    if(required){
+        fprintf(stderr, "no free DMA channel\n");
+        exit(1);
+    }
+    return -1;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger) {
+    struct emu_dma_channel *c = &dma[channel];
+    c->read_increment  = config->read_increment;
+    c->write_increment = config->write_increment;
+    c->write_addr      = write_addr;
+    c->read_addr       = read_addr;
+    c->count           = transfer_count;
+    c->busy            = trigger;
+}
+
+// the transfer itself runs once the code waits (emu_dma_flush), as the DMA would run beside the core
+void dma_start_channel_mask(uint32_t chan_mask) {
+    for(uint i = 0; i < NUM_DMA_CHANNELS; i++){
+        if(chan_mask & (1u << i)){
+            dma[i].busy = true;
+        }
+    }
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) { dma[channel].irq0_enabled = enabled; }
+bool dma_channel_get_irq0_status(uint channel)                { return dma[channel].irq0_status; }
+void dma_channel_acknowledge_irq0(uint channel)               { dma[channel].irq0_status = false; }
+
+void queue_init(queue_t *q, uint element_size, uint element_count) {
+    q->data          = calloc(element_count, element_size);
+    q->element_size  = element_size;
+    q->element_count = element_count;
+    q->rptr          = 0;
+    q->level         = 0;
+}
+
+bool queue_try_add(queue_t *q, const void *data) {
+    if(q->level >= q->element_count){
+        return false;
+    }
+    uint wptr = (q->rptr + q->level) % q->element_count;
+    memcpy(&q->data[wptr * q->element_size], data, q->element_size);
+    q->level++;
+    return true;
+}
+
+bool queue_try_peek(queue_t *q, void *data) {
+    if(q->level == 0){
+        return false;
+    }
+    if(data){
+        memcpy(data, &q->data[q->rptr * q->element_size], q->element_size);
+    }
+    return true;
+}
+
+bool queue_try_remove(queue_t *q, void *data) {
+    if(!queue_try_peek(q, data)){
+        return false;
+    }
+    q->rptr = (q->rptr + 1) % q->element_count;
+    q->level--;
+    return true;
+}
+
+bool queue_is_empty(queue_t *q) {
+    return q->level == 0;
+}
+
+uint queue_get_level(queue_t *q) {
+    return q->level;
+}
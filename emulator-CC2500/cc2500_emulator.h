@@ -0,0 +1,97 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Host emulator of the CC2500 SPI interface (transaction level).
+ *
+ * The emulator replaces the Pico SDK functions used by project_pico_libs/cc2500.c, receiver_CC2500.c
+ * and carrier_CC2500.c (see pico_stub/). Each emulated radio is attached to a chip select pin and
+ * optionally to a GDO0 pin. It implements:
+ * - the register file (0x00 - 0x2E), PATABLE, status registers and the chip status byte
+ * - single, burst and status access as well as all command strobes
+ * - the main radio state machine (IDLE, RX, TX, FSTXON, calibration, RX FIFO overflow)
+ * - the RX FIFO (64 bytes) with overflow and GDO0 (IOCFG0 = 0x06) for injected packets
+ * - the DMA channels and the DMA interrupt used by spi_bus.c (build option SPI_BUS): a started pair of
+ *   channels on the SPI data register transfers its bytes once the code waits (see emu_dma_flush)
+ *
+ * Time is virtual: it advances with sleep_ms/sleep_us and with the modelled SPI bus time
+ * (8 bit times per byte at the configured SPI clock + chip select overhead per transaction).
+ *
+ */
+
+#ifndef CC2500_EMULATOR
+#define CC2500_EMULATOR
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+
+#define EMU_MAX_DEVICES          4
+#define EMU_FIFO_SIZE           64
+#define EMU_CS_OVERHEAD_NS     400 // chip select assert/deassert incl. the nops of cs_select/cs_deselect
+#define EMU_CALIBRATION_US     720 // SCAL or FS_AUTOCAL (datasheet, table 34)
+#define EMU_NO_PIN            0xFF
+
+/* MARCSTATE values (datasheet, table 43) */
+enum emu_marcstate {
+  EMU_SLEEP            = 0x00,
+  EMU_IDLE             = 0x01,
+  EMU_MANCAL           = 0x05,
+  EMU_FS_LOCK          = 0x0A,
+  EMU_RX               = 0x0D,
+  EMU_RXFIFO_OVERFLOW  = 0x11,
+  EMU_FSTXON           = 0x12,
+  EMU_TX               = 0x13,
+  EMU_TXFIFO_UNDERFLOW = 0x16
+};
+
+struct emu_counters {
+  uint64_t transactions;   // chip select assertions
+  uint64_t bytes;          // transferred bytes (incl. header bytes)
+  uint64_t strobes;
+  uint64_t register_writes;
+  uint64_t register_reads; // configuration + status register reads
+  uint64_t fifo_bytes;     // FIFO reads/writes
+  uint64_t bus_time_ns;    // modelled SPI bus time
+};
+
+struct emu_device;
+
+/* attach an emulated radio (returns its index) */
+int emu_add_device(uint8_t csn, uint8_t gdo0, const char *name);
+
+/* reset all devices, counters and the virtual clock */
+void emu_reset_all(void);
+
+/*
+ * a packet arrives over the air at device index:
+ * payload: length byte and data as the transmitter sent them (e.g. buffer of readPacket: [len, seq, ...])
+ * If the device is in RX, the bytes and the two status bytes (RSSI, LQI/CRC) are appended to the RX FIFO
+ * and GDO0 asserts and de-asserts. Returns false if the device was not listening.
+ */
+bool emu_inject_packet(int index, const uint8_t *payload, uint8_t len, int8_t rssi_dbm, uint8_t lqi, bool crc_ok, int8_t freqest);
+
+/*
+ * run the started DMA transfers (SPI_BUS) and their interrupt handler until the queues of the bus are empty
+ * (also done by sleep_ms/sleep_us, tight_loop_contents, emu_inject_packet and the inspection functions)
+ */
+void emu_dma_flush(void);
+
+/* inspection */
+uint8_t             emu_register(int index, uint8_t address);
+enum emu_marcstate  emu_state(int index);
+uint8_t             emu_rx_fifo_level(int index);
+uint64_t            emu_time_us(void);
+
+/* counters of a device (index) or of the whole bus (index < 0) */
+struct emu_counters emu_get_counters(int index);
+
+/* per API call accounting: snapshot before the call, print the difference after it */
+struct emu_snapshot {
+  struct emu_counters counters;
+  uint64_t time_ns;
+};
+struct emu_snapshot emu_take_snapshot(void);
+void emu_print_delta(const char *name, const struct emu_snapshot *before);
+void emu_print_header(void);
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Compares the integer register field computations of receiver_CC2500.c and the baud-rate/deviation
+ * computations of backscatter.c with the former double based formulas (log2/floor/pow/round), which are
+ * kept here as reference. Returns a non-zero exit code at the first difference of each kind.
+ *
+ * Covered: every data rate 25 ... 4e6 Baud, every bandwidth 1 ... 812500 Hz, every deviation 1587 ... 4e6 Hz,
+ * the 2400 - 2483.5 MHz band in 7 Hz steps, every divider pair 2 ... 1024 and every baud-rate up to 4e6 Baud.
+ *
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "backscatter.h"
+
+#define CLK_HZ ((uint32_t) CLKFREQ*1000000)
+
+static int failures = 0;
+
+static bool expect(const char *name, uint32_t input, uint32_t former, uint32_t now) {
+    if(former == now){
+        return true;
+    }
+    printf("FAILED: %s(%u) former %u integer %u\n", name, input, former, now);
+    failures++;
+    return false;
+}
+
+/* the former formulas (negative doubles are converted through int as the M0+ did) */
+static uint8_t to_u8(double x) { return (uint8_t) (int32_t) x; }
+
+static void check_datarate(void) {
+    for(uint32_t r_data = 25; r_data <= 4000000; r_data++){
+        uint8_t e = to_u8(floor(log2(((double) r_data * (1 << 20)) / ((double) F_XOSC))));
+        uint8_t m = to_u8(floor(((double) r_data * (1 << 28)) / ((double) F_XOSC * (1 << e)) - 256.0));
+        uint32_t calculated = floor(((256.0+m)*(1 << e) * (double) F_XOSC) / ((double) (1 << 28)));
+        uint8_t e2, m2;
+        uint32_t calculated2 = datarate_fields(r_data, &e2, &m2);
+        if(!expect("drate_e", r_data, e, e2) || !expect("drate_m", r_data, m, m2) || !expect("r_data", r_data, calculated, calculated2)){
+            return;
+        }
+    }
+}
+
+static void check_filter_bandwidth(void) {
+    for(uint32_t bw = 1; bw <= 812500; bw++){
+        uint8_t e = to_u8(floor(log2(((double) F_XOSC)/((double) (1 << 5) * bw)/log2(2.0))));
+        uint8_t m = to_u8(floor(((double) F_XOSC)/((double) 8.0 * bw * (1 << e)) - 4.0));
+        uint32_t calculated = floor(((double) F_XOSC) / ((double) 8.0*(4.0+m)*(1 << e)));
+        uint8_t e2, m2;
+        uint32_t calculated2 = filter_bandwidth_fields(bw, &e2, &m2);
+        if(!expect("chanbw_e", bw, e, e2) || !expect("chanbw_m", bw, m, m2) || !expect("bw", bw, calculated, calculated2)){
+            return;
+        }
+    }
+}
+
+static void check_deviation(void) {
+    for(uint32_t f_dev = 1587; f_dev <= 4000000; f_dev++){
+        uint8_t e = to_u8(floor(log2(((double) f_dev) * (1 << 14) / ((double) F_XOSC))));
+        uint8_t m = to_u8(floor((((double) f_dev) * (1 << 17)) / ((double) (1 << e) * F_XOSC) - 8.0));
+        uint32_t calculated = floor(((double) F_XOSC) * (8.0 + (double) m + 1.0)*(1 << e) / ((double) (1 << 17)));
+        uint8_t e2, m2;
+        uint32_t calculated2 = deviation_fields(f_dev, &e2, &m2);
+        if(!expect("deviation_e", f_dev, e, e2) || !expect("deviation_m", f_dev, m, m2) || !expect("f_dev", f_dev, calculated, calculated2)){
+            return;
+        }
+    }
+}
+
+static void check_frequency(void) {
+    for(uint32_t f_carrier = 2400000000u; f_carrier <= 2483500000u; f_carrier += 7){
+        uint32_t freq = floor(f_carrier *((double) (1 << 16)) / ((double) F_XOSC));
+        uint8_t  channspc_m = to_u8(floor(((((double) f_carrier) * (1 << 16)) / ((double) F_XOSC) - freq - (1 << 6)) * (1 << 2)));
+        uint32_t calculated = floor(((double) F_XOSC) * freq / ((double) (1 << 16)));
+        if(!expect("frequency_word", f_carrier, freq, frequency_word(f_carrier)) ||
+           !expect("channel_spacing_m", f_carrier, channspc_m, channel_spacing_m(f_carrier)) ||
+           !expect("frequency_of_word", f_carrier, calculated, frequency_of_word(freq))){
+            return;
+        }
+    }
+}
+
+static void check_baud(void) {
+    for(uint32_t baud = 1; baud <= 4000000; baud++){
+        uint32_t former = baud;
+        if(((uint32_t) (CLKFREQ*pow(10,6))) % baud != 0){
+            former = round(((uint32_t) (CLKFREQ*pow(10,6))) / round(((double) CLKFREQ*pow(10,6)) / ((double) baud)));
+        }
+        if(!expect("achievable_baud", baud, former, achievable_baud(baud))){
+            return;
+        }
+    }
+}
+
+static void check_dividers(void) {
+    for(uint16_t d0 = 2; d0 <= 1024; d0++){
+        for(uint16_t d1 = 2; d1 <= 1024; d1++){
+            uint32_t fcenter = (CLK_HZ/d0 + CLK_HZ/d1)/2;
+            uint32_t former  = abs(round((((double) CLKFREQ*1000000)/((double) d1)) - ((double) fcenter)));
+            if(!expect("subcarrier_deviation", ((uint32_t) d0 << 16) | d1, former, subcarrier_deviation(d0, d1))){
+                return;
+            }
+        }
+    }
+}
+
+int main(void) {
+    check_datarate();
+    check_filter_bandwidth();
+    check_deviation();
+    check_frequency();
+    check_baud();
+    check_dividers();
+    printf("%d failed check(s)\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * host replacement of hardware/dma.h: a started pair of channels from and to the data register of an
+ * SPI instance is forwarded to the emulated CC2500 devices (see cc2500_emulator.c)
+ *
+ */
+
+#ifndef EMU_HARDWARE_DMA
+#define EMU_HARDWARE_DMA
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS 12
+
+enum dma_channel_transfer_size {
+  DMA_SIZE_8  = 0,
+  DMA_SIZE_16 = 1,
+  DMA_SIZE_32 = 2
+};
+
+typedef struct {
+  bool read_increment;
+  bool write_increment;
+} dma_channel_config;
+
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size);
+void channel_config_set_dreq(dma_channel_config *c, uint dreq);
+void channel_config_set_read_increment(dma_channel_config *c, bool incr);
+void channel_config_set_write_increment(dma_channel_config *c, bool incr);
+
+int  dma_claim_unused_channel(bool required);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_start_channel_mask(uint32_t chan_mask);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * host replacement of hardware/pio.h: backscatter.c builds on the host for its computations
+ * (program generation, baud-rate, deviation), loading and running a program has no effect
+ *
+ */
+
+#ifndef EMU_HARDWARE_PIO
+#define EMU_HARDWARE_PIO
+
+#include "pico/stdlib.h"
+
+typedef struct pio_hw {
+  volatile uint32_t fdebug;
+} pio_hw_t;
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t emu_pio0, emu_pio1;
+#define pio0 (&emu_pio0)
+#define pio1 (&emu_pio1)
+
+#define PIO_FDEBUG_TXSTALL_LSB 24
+
+typedef struct pio_program {
+  const uint16_t *instructions;
+  uint8_t         length;
+  int8_t          origin;
+} pio_program_t;
+
+typedef struct {
+  uint32_t clkdiv, execctrl, shiftctrl, pinctrl;
+} pio_sm_config;
+
+enum pio_fifo_join {
+  PIO_FIFO_JOIN_NONE = 0,
+  PIO_FIFO_JOIN_TX   = 1,
+  PIO_FIFO_JOIN_RX   = 2
+};
+
+static inline pio_sm_config pio_get_default_sm_config(void)                                  { return (pio_sm_config){0}; }
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap)          { (void) c; (void) wrap_target; (void) wrap; }
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint base, uint count)            { (void) c; (void) base; (void) count; }
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bits, bool optional, bool pindirs) { (void) c; (void) bits; (void) optional; (void) pindirs; }
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint base)                    { (void) c; (void) base; }
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join)         { (void) c; (void) join; }
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool right, bool autopull, uint threshold) { (void) c; (void) right; (void) autopull; (void) threshold; }
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac) { (void) c; (void) div_int; (void) div_frac; }
+
+static inline void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)                         { (void) pio; (void) sm; (void) enabled; }
+static inline void pio_clear_instruction_memory(PIO pio)                                      { (void) pio; }
+static inline void pio_add_program_at_offset(PIO pio, const pio_program_t *program, uint offset) { (void) pio; (void) program; (void) offset; }
+static inline void pio_gpio_init(PIO pio, uint pin)                                           { (void) pio; (void) pin; }
+static inline void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin, uint count, bool is_out) { (void) pio; (void) sm; (void) pin; (void) count; (void) is_out; }
+static inline void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config) { (void) pio; (void) sm; (void) initial_pc; (void) config; }
+static inline void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac) { (void) pio; (void) sm; (void) div_int; (void) div_frac; }
+static inline void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data)                       { (void) pio; (void) sm; (void) data; }
+static inline bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm)                                  { (void) pio; (void) sm; return true; }
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * host replacement of hardware/spi.h: transfers are forwarded to the emulated CC2500 devices
+ *
+ */
+
+#ifndef EMU_HARDWARE_SPI
+#define EMU_HARDWARE_SPI
+
+#include "pico/stdlib.h"
+
+typedef struct {
+  volatile uint32_t dr; // data register: DMA source/destination
+} spi_hw_t;
+
+typedef struct spi_inst {
+  uint     baudrate;
+  spi_hw_t hw;
+} spi_inst_t;
+
+extern spi_inst_t emu_spi0, emu_spi1;
+#define spi0 (&emu_spi0)
+#define spi1 (&emu_spi1)
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+int  spi_write_blocking(spi_inst_t *spi, const uint8_t *src, size_t len);
+int  spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+int  spi_write_read_blocking(spi_inst_t *spi, const uint8_t *src, uint8_t *dst, size_t len);
+
+static inline spi_hw_t *spi_get_hw(spi_inst_t *spi)           { return &spi->hw; }
+static inline uint spi_get_dreq(spi_inst_t *spi, bool is_tx)  { return 2 * (spi == spi1) + !is_tx; }
+
+#endif
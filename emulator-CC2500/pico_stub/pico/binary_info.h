@@ -0,0 +1,8 @@
+#ifndef EMU_PICO_BINARY_INFO
+#define EMU_PICO_BINARY_INFO
+
+#define bi_decl(...)
+#define bi_1pin_with_name(...)
+#define bi_3pins_with_func(...)
+
+#endif
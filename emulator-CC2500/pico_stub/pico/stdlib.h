@@ -0,0 +1,56 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * host replacement of the Pico SDK (only what the CC2500 drivers use), see ../../README.md
+ *
+ */
+
+#ifndef EMU_PICO_STDLIB
+#define EMU_PICO_STDLIB
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define GPIO_OUT                 1
+#define GPIO_IN                  0
+#define GPIO_FUNC_SPI            1
+#define GPIO_IRQ_EDGE_FALL    0x04u
+#define GPIO_IRQ_EDGE_RISE    0x08u
+#define GPIO_OVERRIDE_NORMAL     0
+#define GPIO_OVERRIDE_INVERT     1
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t events);
+
+/* time (virtual clock of the emulator: advanced by sleeps and modelled SPI bus time) */
+absolute_time_t get_absolute_time(void);
+uint64_t        to_us_since_boot(absolute_time_t t);
+uint64_t        time_us_64(void);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms);
+absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us);
+bool            time_reached(absolute_time_t t);
+int64_t         absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+void            sleep_ms(uint32_t ms);
+void            sleep_us(uint64_t us);
+
+/* waiting (busy loops of spi_bus): the emulated DMA transfers and their interrupt run here */
+void            tight_loop_contents(void);
+/* exception number of the running interrupt handler, 0 in thread mode */
+uint            __get_current_exception(void);
+
+/* gpio (chip selects are forwarded to the emulated SPI devices) */
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_set_function(uint gpio, uint fn);
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t events, bool enabled, gpio_irq_callback_t callback);
+void gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled);
+static inline void gpio_set_outover(uint gpio, uint value) { (void) gpio; (void) value; }
+
+#endif
@@ -0,0 +1,22 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * host replacement of pico/sync.h: the emulator runs on one thread and only enters the (DMA)
+ * interrupt handlers while the code waits, a critical section has nothing to exclude
+ *
+ */
+
+#ifndef EMU_PICO_SYNC
+#define EMU_PICO_SYNC
+
+#include "pico/stdlib.h"
+
+typedef struct critical_section {
+  int unused;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *cs)            { (void) cs; }
+static inline void critical_section_enter_blocking(critical_section_t *cs)  { (void) cs; }
+static inline void critical_section_exit(critical_section_t *cs)            { (void) cs; }
+
+#endif
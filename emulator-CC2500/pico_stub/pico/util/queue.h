@@ -0,0 +1,28 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * host replacement of pico/util/queue.h (single-threaded ring buffer)
+ *
+ */
+
+#ifndef EMU_PICO_QUEUE
+#define EMU_PICO_QUEUE
+
+#include "pico/stdlib.h"
+
+typedef struct {
+  uint8_t *data;
+  uint     element_size;
+  uint     element_count;
+  uint     rptr;
+  uint     level;
+} queue_t;
+
+void queue_init(queue_t *q, uint element_size, uint element_count);
+bool queue_try_add(queue_t *q, const void *data);
+bool queue_try_remove(queue_t *q, void *data);
+bool queue_try_peek(queue_t *q, void *data);
+bool queue_is_empty(queue_t *q);
+uint queue_get_level(queue_t *q);
+
+#endif
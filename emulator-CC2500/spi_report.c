@@ -0,0 +1,162 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Runs the CC2500 driver functions of project_pico_libs against the emulator and reports the
+ * SPI traffic and modelled bus time of each call. Packets are injected over the air and read back
+ * through the interrupt/event path. Returns a non-zero exit code if the driver behaves unexpectedly.
+ * Built with SPI_BUS=1 (spi_report_bus), both radios share a prioritised bus (spi_bus.c) as on the
+ * combined board and the transactions run through the emulated DMA.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "cc2500.h"
+#include "receiver_CC2500.h"
+#include "carrier_CC2500.h"
+#include "cc2500_emulator.h"
+
+#define SPI_CLOCK  5000000 // as in receiver-CC2500/main.c
+
+static int failures = 0;
+static struct emu_snapshot snapshot;
+#if SPI_BUS
+static struct spi_bus radio_bus;
+#endif
+
+// the prints of the driver are suppressed while a call is measured
+#define MEASURE(name, call) do {                 \
+        fflush(stdout);                          \
+        FILE *console = stdout;                  \
+        stdout = fopen("/dev/null", "w");        \
+        snapshot = emu_take_snapshot();          \
+        call;                                    \
+        emu_dma_flush();                         \
+        fclose(stdout);                          \
+        stdout = console;                        \
+        emu_print_delta(name, &snapshot);        \
+    } while(0)
+
+static void check(bool condition, const char *description) {
+    if(!condition){
+        printf("FAILED: %s\n", description);
+        failures++;
+    }
+}
+
+int main(void) {
+    int rx      = emu_add_device(RX_CSN, RX_GDO0_PIN, "rx");
+    int carrier = emu_add_device(CARRIER_CSN, EMU_NO_PIN, "tx");
+
+    spi_init(RADIO_SPI, SPI_CLOCK);
+    cc2500_init_pins(&radio_rx);
+    cc2500_init_pins(&radio_carrier);
+#if SPI_BUS
+    spi_bus_init(&radio_bus, RADIO_SPI);
+    radio_rx.bus      = &radio_bus;
+    radio_carrier.bus = &radio_bus;
+#endif
+
+    printf("SPI clock %u Hz, chip select overhead %u ns\n\n", SPI_CLOCK, EMU_CS_OVERHEAD_NS);
+    emu_print_header();
+
+    /* receiver */
+    MEASURE("setupReceiver", setupReceiver());
+    check(emu_state(rx) == EMU_IDLE, "receiver in IDLE after setup");
+    check(emu_register(rx, 0x02) == 0x06, "receiver GDO0 configured for sync word/end of packet");
+
+    MEASURE("set_frecuency_rx", set_frecuency_rx(2456000000));
+    MEASURE("set_datarate_rx", set_datarate_rx(100000));
+    MEASURE("set_filter_bandwidth_rx", set_filter_bandwidth_rx(203000));
+    MEASURE("set_frequency_deviation_rx", set_frequency_deviation_rx(47607));
+    MEASURE("set_datarate_rx (shadowed)", set_datarate_rx(100000));
+    check(emu_register(rx, 0x0D) == ((frequency_word(2456000000) >> 16) & 0x7F), "FREQ2 written");
+
+    MEASURE("RX_start_listen", RX_start_listen());
+    check(emu_state(rx) == EMU_RX || emu_state(rx) == EMU_MANCAL, "receiver listening");
+    sleep_us(EMU_CALIBRATION_US);
+    check(emu_state(rx) == EMU_RX, "receiver in RX after calibration");
+
+    uint8_t packet[32] = {31, 7};
+    for(uint8_t i = 2; i < sizeof(packet); i++){
+        packet[i] = i;
+    }
+    check(emu_inject_packet(rx, packet, sizeof(packet), -60, 40, true, -3), "packet received");
+    event_t events[2];
+    MEASURE("get_event (sync word)", events[0] = get_event());
+    MEASURE("get_event (end of packet)", events[1] = get_event());
+    check(events[0] == rx_assert_evt && events[1] == rx_deassert_evt, "GDO0 events");
+
+    uint8_t buffer[RX_BUFFER_SIZE];
+    Packet_status status;
+    MEASURE("readPacket (32 bytes)", status = readPacket(buffer));
+    check(!status.overflowed && status.len == sizeof(packet), "packet length");
+    check(memcmp(buffer, packet, sizeof(packet)) == 0, "packet content");
+    check(status.CRCcheck && status.LinkQualityIndicator == 40 && status.RSSI == -60, "packet status");
+    check(emu_state(rx) == EMU_IDLE, "receiver returned to IDLE after the packet (MCSM1)");
+
+    uint8_t freqest;
+    MEASURE("read_status_rx (FREQEST)", freqest = read_status_rx(0x32));
+    check((int8_t) freqest == -3, "FREQEST");
+
+    // two packets without reading the FIFO in between overflow it
+    MEASURE("RX_start_listen", RX_start_listen());
+    sleep_us(EMU_CALIBRATION_US);
+    cc2500_write_register(&radio_rx, 0x17, 0x0C); // stay in RX
+    uint8_t large[40] = {39, 8};
+    emu_inject_packet(rx, large, sizeof(large), -70, 30, true, 0);
+    emu_inject_packet(rx, large, sizeof(large), -70, 30, true, 0);
+    check(emu_state(rx) == EMU_RXFIFO_OVERFLOW, "RX FIFO overflow");
+    while(get_event() != no_evt);
+    MEASURE("readPacket (overflow)", status = readPacket(buffer));
+    check(status.overflowed, "overflow reported");
+    MEASURE("RX_stop_listen", RX_stop_listen());
+    MEASURE("RX_start_listen (after overflow)", RX_start_listen());
+    check(emu_rx_fifo_level(rx) == 0, "RX FIFO flushed");
+
+    MEASURE("calibrate_profiles_rx (4)", calibrate_profiles_rx(2450000000, 2000000, 4));
+    check(rx_profiles[3].calibrated, "receiver profiles calibrated");
+    MEASURE("select_profile_rx", select_profile_rx(&rx_profiles[2]));
+    check(emu_register(rx, 0x25) == rx_profiles[2].registers[PROFILE_REG(0x25)], "FSCAL1 of the profile restored");
+
+    /* carrier */
+    printf("\n");
+    emu_print_header();
+    MEASURE("setupCarrier", setupCarrier());
+    MEASURE("set_frecuency_tx", set_frecuency_tx(2450000000));
+    MEASURE("startCarrier", startCarrier());
+    check(emu_state(carrier) == EMU_TX || emu_state(carrier) == EMU_MANCAL, "carrier started");
+    MEASURE("stopCarrier", stopCarrier());
+    check(emu_state(carrier) == EMU_IDLE, "carrier stopped");
+    MEASURE("carrier_standby_tx", carrier_standby_tx(true));
+    check(emu_state(carrier) == EMU_FSTXON, "carrier in FSTXON standby");
+    MEASURE("start_carrier_tx (standby)", start_carrier_tx());
+    check(emu_state(carrier) == EMU_TX, "carrier started from standby");
+    MEASURE("stop_carrier_tx (standby)", stop_carrier_tx());
+    check(emu_state(carrier) == EMU_FSTXON, "carrier back in standby");
+    MEASURE("carrier_standby_tx (off)", carrier_standby_tx(false));
+    MEASURE("start_carrier_tx (cold)", start_carrier_tx());
+    check(emu_state(carrier) == EMU_TX, "carrier started from IDLE");
+    MEASURE("stop_carrier_tx", stop_carrier_tx());
+    MEASURE("calibrate_profiles_tx (4)", calibrate_profiles_tx(2450000000, 2000000, 4));
+    MEASURE("select_profile_tx", select_profile_tx(&tx_profiles[1]));
+
+    /* totals */
+    struct emu_counters total[2] = {emu_get_counters(rx), emu_get_counters(carrier)};
+    const char *names[2] = {"rx", "tx"};
+    printf("\n%-6s %8s %8s %8s %12s\n", "radio", "trans", "bytes", "strobes", "bus [us]");
+    for(uint8_t i = 0; i < 2; i++){
+        printf("%-6s %8llu %8llu %8llu %12.1f\n", names[i], (unsigned long long) total[i].transactions,
+               (unsigned long long) total[i].bytes, (unsigned long long) total[i].strobes, total[i].bus_time_ns / 1000.0);
+    }
+#if SPI_BUS
+    check(radio_bus.active < 0, "bus idle at the end");
+    check(radio_bus.stats.full == 0, "no submission found the bus queue full");
+    printf("\n");
+    spi_bus_report(&radio_bus);
+#endif
+    printf("\nvirtual time %llu us, %d failed check(s)\n", (unsigned long long) emu_time_us(), failures);
+    return failures ? 1 : 0;
+}
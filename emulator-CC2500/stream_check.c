@@ -0,0 +1,114 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Checks the random access of the payload generator (packet_generation.c) against sequential generation:
+ * - rnd_jump(seed, n) equals n calls of rnd_r, and jumps compose (rnd_jump(rnd_jump(s, a), b) = rnd_jump(s, a+b))
+ * - a sample stream positioned with stream_seek, and generate_sample after setting file_position, continue
+ *   the sequence that generate_data produces from position 0, including the restart when the position wraps
+ * - stream_generate_data fills a buffer exactly as generate_data
+ * Returns a non-zero exit code if a check fails.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "packet_generation.h"
+
+#define SEQUENCE_SAMPLES 32768 // one period of file_position (0 ... 65534 in steps of 2)
+
+static int failures = 0;
+static uint16_t sequence[SEQUENCE_SAMPLES]; // sample at file_position 2*i
+
+static void check(bool condition, const char *description, uint32_t value) {
+    if(!condition){
+        printf("FAILED: %s (%u)\n", description, value);
+        failures++;
+    }
+}
+
+static void check_jump(void) {
+    const uint32_t seeds[] = {DEFAULT_SEED, 0, 1, 0xFFFFFFFF, 0x12345678};
+    for(uint8_t s = 0; s < sizeof(seeds)/sizeof(seeds[0]); s++){
+        uint32_t seed = seeds[s];
+        for(uint32_t n = 0; n <= 100000; n++){
+            if(rnd_jump(seeds[s], n) != seed){
+                check(false, "rnd_jump equals rnd_r steps", n);
+                break;
+            }
+            rnd_r(&seed);
+        }
+        const uint32_t large[] = {65535, 1u << 20, 0x7FFFFFFF, 0xFFFFFFFF};
+        for(uint8_t i = 0; i < sizeof(large)/sizeof(large[0]); i++){
+            uint32_t a = large[i], b = 12345;
+            check(rnd_jump(rnd_jump(seeds[s], a), b) == rnd_jump(seeds[s], a + b), "rnd_jump composes", a);
+        }
+    }
+    check(rnd_jump(DEFAULT_SEED, 0) == DEFAULT_SEED, "rnd_jump of 0 steps", 0);
+}
+
+static void check_positions(void) {
+    // reference: sequential generation from position 0
+    uint8_t buffer[MAX_PAYLOADSIZE];
+    file_position = 0;
+    for(uint32_t i = 0; i < SEQUENCE_SAMPLES; i += MAX_PAYLOADSIZE/2){
+        uint8_t samples = (uint8_t) min(SEQUENCE_SAMPLES - i, MAX_PAYLOADSIZE/2);
+        generate_data(buffer, 2*samples, false);
+        for(uint8_t j = 0; j < samples; j++){
+            sequence[i + j] = ((uint16_t) buffer[2*j] << 8) | buffer[2*j+1];
+        }
+    }
+    check(file_position == 0, "file_position wrapped", file_position);
+    check(generate_sample() == sequence[0], "generate_sample restarts after the wrap", 0);
+
+    // random access at every position
+    struct sample_stream stream;
+    for(uint32_t i = 0; i < SEQUENCE_SAMPLES; i++){
+        stream_seek(&stream, (uint16_t) (2*i));
+        if(stream_sample(&stream) != sequence[i]){
+            check(false, "stream_seek continues the sequence", 2*i);
+            break;
+        }
+    }
+    for(uint32_t i = 0; i < SEQUENCE_SAMPLES; i += 97){
+        file_position = (uint16_t) (2*i);
+        if(generate_sample() != sequence[i] || generate_sample() != sequence[(i + 1) % SEQUENCE_SAMPLES]){
+            check(false, "generate_sample jumps to file_position", 2*i);
+            break;
+        }
+    }
+
+    // a stream across the wrap
+    stream_seek(&stream, 65534);
+    check(stream_sample(&stream) == sequence[SEQUENCE_SAMPLES-1], "stream at the last position", 65534);
+    check(stream.position == 0 && stream_sample(&stream) == sequence[0], "stream restarts after the wrap", stream.position);
+}
+
+static void check_buffers(void) {
+    const uint8_t lengths[] = {2, PAYLOADSIZE, 32, MAX_PAYLOADSIZE};
+    const uint16_t starts[] = {0, 2, 1000, 65500};
+    for(uint8_t l = 0; l < sizeof(lengths); l++){
+        for(uint8_t s = 0; s < sizeof(starts)/sizeof(starts[0]); s++){
+            for(uint8_t index = 0; index < 2; index++){
+                uint8_t expected[MAX_PAYLOADSIZE], actual[MAX_PAYLOADSIZE];
+                memset(expected, 0x55, sizeof(expected));
+                memset(actual, 0x55, sizeof(actual));
+                file_position = starts[s];
+                generate_data(expected, lengths[l], index);
+                struct sample_stream stream;
+                stream_seek(&stream, starts[s]);
+                stream_generate_data(&stream, actual, lengths[l], index);
+                check(memcmp(expected, actual, sizeof(expected)) == 0 && stream.position == file_position,
+                      "stream_generate_data equals generate_data", lengths[l]);
+            }
+        }
+    }
+}
+
+int main(void) {
+    check_jump();
+    check_positions();
+    check_buffers();
+    printf("%d failed check(s)\n", failures);
+    return failures ? 1 : 0;
+}
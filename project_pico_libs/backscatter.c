@@ -6,6 +6,7 @@
  */
 
 #include "backscatter.h"
+#include "trace.h"
 
 // repeat the instruction until the desired delay has past
 int16_t repeat(uint16_t* instructionBuffer, int16_t delay, uint32_t asm_instr, uint8_t *length, uint16_t max_delay){
@@ -17,6 +18,24 @@ int16_t repeat(uint16_t* instructionBuffer, int16_t delay, uint32_t asm_instr, u
     }
 }
 
+// closest baud-rate with an integer number of clock cycles per symbol: round(CLK / round(CLK / baud))
+uint32_t achievable_baud(uint32_t baud){
+    const uint64_t clk = (uint64_t) CLKFREQ*1000000;
+    if(clk % baud == 0){
+        return baud;
+    }
+    uint64_t cycles = (2*clk + baud) / (2*(uint64_t) baud);      // round half away from zero
+    return (uint32_t) ((2*clk + cycles) / (2*cycles));
+}
+
+// |round(CLK/d1 - fcenter)| with fcenter = (CLK/d0 + CLK/d1)/2 in integer arithmetic
+uint32_t subcarrier_deviation(uint16_t d0, uint16_t d1){
+    uint32_t fcenter = (CLKFREQ*1000000/d0 + CLKFREQ*1000000/d1)/2;
+    int64_t  numerator = (int64_t) CLKFREQ*1000000 - (int64_t) fcenter*d1;
+    uint64_t magnitude = (numerator < 0) ? -numerator : numerator;
+    return (uint32_t) ((2*magnitude + d1) / (2*(uint64_t) d1));
+}
+
 // how many instructions are needed to create this delay?
 uint8_t instructionCount(uint16_t delay, uint16_t max_delay){
     if (delay % max_delay == 0){
@@ -93,6 +112,154 @@ bool generatePIOprogram(uint16_t d0,uint16_t d1, uint32_t baud, uint16_t* instru
     return true;
 }
 
+/*
+ * phase-continuous program (label positions, see generatePIOprogramPhaseContinuous)
+ * A period starts with its low part (both pins 0, the boundary instructions run here) followed by the high part:
+ * - in phase:  (1,1) for d/2 cycles (low part d/2)
+ * - quadrature: (1,0) for d/2-d/4, (1,1) for d/4, (0,1) for d/2-d/4 cycles (low part d/4): pin2 lags pin1 by a quarter period
+ */
+#define CP_BOUNDARY_CYCLES 4 // set pins 0, out x 1, jmp, out x count: run during the first low part of a symbol
+struct cp_layout {
+  uint8_t loop_1_low;
+  uint8_t send_1;
+  uint8_t loop_1_high;
+  uint8_t get_symbol;  // wrap target
+  uint8_t send_0;
+  uint8_t loop_0_high;
+  uint8_t wrap;        // jmp x-- loop_0_low (the last period of symbol 0 wraps to get_symbol)
+  uint8_t loop_0_low;
+  uint8_t length;
+};
+
+static uint16_t cp_low_cycles(uint16_t d, bool quadrature){
+    return quadrature ? d/4 : d/2;
+}
+
+// instructions of the high part without the final jmp (it takes the last cycle)
+static uint8_t cp_high_count(uint16_t d, bool quadrature, uint16_t max_delay){
+    if(quadrature){
+        return instructionCount(d/2 - d/4, max_delay) + instructionCount(d/4, max_delay) + instructionCount(d/2 - d/4 - 1, max_delay);
+    }
+    return instructionCount(d/2 - 1, max_delay);
+}
+
+static void cp_high(uint16_t* instructionBuffer, uint8_t *length, uint16_t d, bool quadrature, uint16_t max_delay, uint16_t side_1, uint16_t side_0){
+    if(quadrature){
+        repeat(instructionBuffer, d/2 - d/4,     ASM_SET_PINS | side_0 | 1, length, max_delay); // set    pins, 1         side 0 [delay]
+        repeat(instructionBuffer, d/4,           ASM_SET_PINS | side_1 | 1, length, max_delay); // set    pins, 1         side 1 [delay]
+        repeat(instructionBuffer, d/2 - d/4 - 1, ASM_SET_PINS | side_1 | 0, length, max_delay); // set    pins, 0         side 1 [delay]
+    }else{
+        repeat(instructionBuffer, d/2 - 1,       ASM_SET_PINS | side_1 | 1, length, max_delay); // set    pins, 1         side 1 [delay]
+    }
+}
+
+static void cp_layout(uint16_t d0, uint16_t d1, uint16_t max_delay, bool quadrature, struct cp_layout *l){
+    /*                    low                                                    jmp   */
+    l->loop_1_low  = 1;
+    l->send_1      = l->loop_1_low + instructionCount(cp_low_cycles(d1, quadrature) - 1, max_delay) + 1;
+    l->loop_1_high = l->send_1 + 1 + instructionCount(cp_low_cycles(d1, quadrature) - CP_BOUNDARY_CYCLES, max_delay);
+    l->get_symbol  = l->loop_1_high + cp_high_count(d1, quadrature, max_delay) + 1;
+    l->send_0      = l->get_symbol + 3;
+    l->loop_0_high = l->send_0 + 1 + instructionCount(cp_low_cycles(d0, quadrature) - CP_BOUNDARY_CYCLES, max_delay);
+    l->wrap        = l->loop_0_high + cp_high_count(d0, quadrature, max_delay);
+    l->loop_0_low  = l->wrap + 1;
+    l->length      = l->loop_0_low + instructionCount(cp_low_cycles(d0, quadrature) - 1, max_delay) + 1;
+}
+
+uint8_t phase_continuous_count_bits(uint16_t d0, uint16_t d1, uint32_t baud){
+    // the encoder keeps the boundary within half a period: at most CLK/baud/d + 1 periods per symbol
+    uint32_t max_count = ((uint32_t) CLKFREQ*1000000/baud) / min(d0, d1);
+    for(uint8_t bits = 3; bits < 16; bits = 2*bits + 1){ // 1 + bits divides 32 (no symbol crosses a word)
+        if(max_count < (1u << bits)){
+            return bits;
+        }
+    }
+    return 0;
+}
+
+bool generatePIOprogramPhaseContinuous(uint16_t d0,uint16_t d1, uint32_t baud, uint16_t* instructionBuffer, struct pio_program *backscatter_program, bool twoAntennas, bool quadrature){
+    uint16_t MAX_ASMDELAY = 0x0020; // 32
+    uint16_t OPT_SIDE_1   = 0x0000;
+    uint16_t OPT_SIDE_0   = 0x0000;
+    if (twoAntennas){
+        MAX_ASMDELAY = 0x0008;     //   8
+        OPT_SIDE_1   = 0x1800;
+        OPT_SIDE_0   = 0x1000;
+    }
+    if(quadrature && !twoAntennas){
+        printf("ERROR: The quadrature (single-sideband) program requires the second antenna.\n");
+        return false;
+    }
+    uint8_t count_bits = phase_continuous_count_bits(d0, d1, baud);
+    if(count_bits == 0){
+        printf("ERROR: The baud-rate is too low for the phase-continuous program (more than 32767 subcarrier periods per symbol).\n");
+        return false;
+    }
+    if(cp_low_cycles(min(d0, d1), quadrature) < CP_BOUNDARY_CYCLES){
+        printf("ERROR: The %s program requires clock dividers of at least %d.\n", quadrature ? "quadrature" : "phase-continuous", (quadrature ? 4 : 2)*CP_BOUNDARY_CYCLES);
+        return false;
+    }
+    struct cp_layout l;
+    cp_layout(d0, d1, MAX_ASMDELAY, quadrature, &l);
+    if(l.length > 32){
+        printf("ERROR: The clock dividers are too small. The program would not fit into the state-machine instruction memory. Alternatively, you can disable the second antenna. This increaes the maximal delay per instruction from 8 to 32 cycles and thus significanlty reduces the required code space.");
+        return false;
+    }
+    uint16_t low1 = cp_low_cycles(d1, quadrature);
+    uint16_t low0 = cp_low_cycles(d0, quadrature);
+
+    // generate state machine
+    uint8_t length = 0;
+    instructionBuffer[length++] = ASM_JMP | (0x1F & l.get_symbol);                                 //  0: jmp    get_symbol
+    /*       symbol 1      */
+    // repeated periods: low part
+    repeat(instructionBuffer, low1 - 1, ASM_SET_PINS | OPT_SIDE_0 | 0, &length, MAX_ASMDELAY);      //  1: set    pins, 0         side 0 [delay]
+    instructionBuffer[length++] = ASM_JMP | (0x1F & l.loop_1_high);                                //  ...: jmp    loop_1_high
+    // first period: remaining low part after the boundary instructions
+    instructionBuffer[length++] = ASM_OUT | (ASM_X_REG << 5) | count_bits;                         //  ...: out    x, count_bits (periods - 1)
+    repeat(instructionBuffer, low1 - CP_BOUNDARY_CYCLES, ASM_SET_PINS | OPT_SIDE_0 | 0, &length, MAX_ASMDELAY); // ...: set    pins, 0         side 0 [delay]
+    // high part of every period
+    cp_high(instructionBuffer, &length, d1, quadrature, MAX_ASMDELAY, OPT_SIDE_1, OPT_SIDE_0); //  ...: set    pins, ...       side ... [delay]
+    instructionBuffer[length++] = ASM_JMP_XMM | (0x1F & l.loop_1_low);                             //  ...: jmp    x--, loop_1_low (continues with get_symbol)
+    /*       next symbol   */
+    instructionBuffer[length++] = ASM_SET_PINS | OPT_SIDE_0 | 0;                                   //  ...: set    pins, 0         side 0
+    instructionBuffer[length++] = ASM_OUT | (ASM_X_REG << 5) | 1;                                  //  ...: out    x, 1
+    instructionBuffer[length++] = ASM_JMP_XMM | (0x1F & l.send_1);                                 //  ...: jmp    x--, send_1 (x=1)
+    /*       symbol 0      */
+    instructionBuffer[length++] = ASM_OUT | (ASM_X_REG << 5) | count_bits;                         //  ...: out    x, count_bits (periods - 1)
+    repeat(instructionBuffer, low0 - CP_BOUNDARY_CYCLES, ASM_SET_PINS | OPT_SIDE_0 | 0, &length, MAX_ASMDELAY); // ...: set    pins, 0         side 0 [delay]
+    cp_high(instructionBuffer, &length, d0, quadrature, MAX_ASMDELAY, OPT_SIDE_1, OPT_SIDE_0); //  ...: set    pins, ...       side ... [delay]
+    instructionBuffer[length++] = ASM_JMP_XMM | (0x1F & l.loop_0_low);                             //  ...: jmp    x--, loop_0_low (wraps to get_symbol)
+    repeat(instructionBuffer, low0 - 1, ASM_SET_PINS | OPT_SIDE_0 | 0, &length, MAX_ASMDELAY);      //  ...: set    pins, 0         side 0 [delay]
+    instructionBuffer[length++] = ASM_JMP | (0x1F & l.loop_0_high);                                //  ...: jmp    loop_0_high
+
+    // configure program origin and length
+    backscatter_program->instructions = instructionBuffer;
+    backscatter_program->length = length;
+    backscatter_program->origin = -1;
+    return true;
+}
+
+uint8_t backscatter_program_length(uint16_t d0, uint16_t d1, uint32_t baud, bool twoAntennas, bool phaseContinuous, bool quadrature){
+    uint16_t max_delay = twoAntennas ? 0x0008 : 0x0020;
+    if(phaseContinuous){
+        if((quadrature && !twoAntennas) || phase_continuous_count_bits(d0, d1, baud) == 0 || cp_low_cycles(min(d0, d1), quadrature) < CP_BOUNDARY_CYCLES){
+            return 0;
+        }
+        struct cp_layout l;
+        cp_layout(d0, d1, max_delay, quadrature, &l);
+        return (l.length > 32) ? 0 : l.length;
+    }
+    // same layout as generatePIOprogram
+    int16_t lastPeriodCycles1 = (((uint32_t) CLKFREQ*1000000)/baud - 4) % ((uint32_t) d1);
+    int16_t lastPeriodCycles0 = (((uint32_t) CLKFREQ*1000000)/baud - 4) % ((uint32_t) d0);
+    int16_t tmp1 = min(lastPeriodCycles1, d1/2);
+    int16_t tmp0 = min(lastPeriodCycles0, d0/2);
+    uint16_t length = 6 + instructionCount(d1/2, max_delay) + instructionCount(d1/2 - 1, max_delay) + 1 + instructionCount(tmp1, max_delay) + instructionCount(max(0,lastPeriodCycles1-tmp1), max_delay) + 1
+                    + 1 + instructionCount(d0/2, max_delay) + instructionCount(d0/2 - 1, max_delay) + 1 + instructionCount(tmp0, max_delay) + instructionCount(max(0,lastPeriodCycles0-tmp0), max_delay) + 1;
+    return (length >= 32) ? 0 : length;
+}
+
 /* 
     - based on d0/d1/baud, the modulation parameters will be computed and returned in the struct backscatter_config 
     - pin2 is ignored if twoAntennas==false
@@ -108,17 +275,43 @@ bool backscatter_program_init(PIO pio, uint sm, uint pin1, uint pin2, uint16_t d
         printf("WARNING: the clock divider d1 has to be an even integer. The state-machine may not function correctly");
     }
     // correct baud-rate
-    if(((uint32_t) (CLKFREQ*pow(10,6))) % baud != 0){
-        uint32_t baud_new = round(((uint32_t) (CLKFREQ*pow(10,6))) / round(((double) CLKFREQ*pow(10,6)) / ((double) baud)));
+    uint32_t baud_new = achievable_baud(baud);
+    if(baud_new != baud){
         printf("WARNING: a baudrate of %d Baud is not achievable with a %d MHz clock.\nTherefore, the closest achievable baud-rate %d Baud will be used.\n", baud, CLKFREQ, baud_new);
         baud = baud_new;
     }
     // generate pio-program
     struct pio_program backscatter_program;
 
-    if(!generatePIOprogram(d0,d1,baud, instructionBuffer, &backscatter_program, twoAntennas)){
+    if(config->quadrature && !config->phase_continuous){
+        printf("ERROR: The quadrature (single-sideband) program is a phase-continuous program.\n");
+        return false;
+    }
+    bool generated = config->phase_continuous ? generatePIOprogramPhaseContinuous(d0,d1,baud, instructionBuffer, &backscatter_program, twoAntennas, config->quadrature)
+                                              : generatePIOprogram(d0,d1,baud, instructionBuffer, &backscatter_program, twoAntennas);
+    if(!generated){
         return false;
     };
+    backscatter_program_load(pio, sm, pin1, pin2, d0, d1, baud, instructionBuffer, backscatter_program.length, config, twoAntennas);
+    
+    if (config->deviation > 380000){
+        printf("WARNING: the deviation is too large for the CC2500\n");
+    }
+    if (config->deviation > 1000000){
+        printf("WARNING: the deviation is too large for the CC1352\n");
+    }
+    if (d0 < d1){
+        printf("WARNING: symbol 0 has been assigned to larger frequncy than symbol 1\n");
+    }
+
+    printf("Computed baseband settings (%s FSK): \n- baudrate: %d\n- Center offset: %d\n- deviation: %d\n- RX Bandwidth: %d\n", config->quadrature ? "single-sideband" : (config->phase_continuous ? "phase-continuous" : "restarting"), config->baudrate, config->center_offset, config->deviation, config->minRxBw);
+    return true;
+}
+
+void backscatter_program_load(PIO pio, uint sm, uint pin1, uint pin2, uint16_t d0, uint16_t d1, uint32_t baud, const uint16_t *instructions, uint8_t length, struct backscatter_config *config, bool twoAntennas){
+    struct pio_program backscatter_program = {.instructions = instructions, .length = length, .origin = -1};
+    pio_sm_set_enabled(pio, sm, false); // stop state machine if running
+    pio_clear_instruction_memory(pio);
     uint offset = 0;
     pio_add_program_at_offset(pio, &backscatter_program, offset); // load program
     /* print state-machine instructions */
@@ -132,10 +325,17 @@ bool backscatter_program_init(PIO pio, uint sm, uint pin1, uint pin2, uint16_t d
     if(twoAntennas){
         pio_gpio_init(pio, pin2);
         pio_sm_set_consecutive_pindirs(pio, sm, pin2, 1, true);    
+        backscatter_set_sideband(config, pin2, config->lower_sideband); // pio_gpio_init has reset the output override
     }
     // setup default state-machine config
     pio_sm_config c = pio_get_default_sm_config();
-    sm_config_set_wrap(&c, offset, offset + backscatter_program.length-1); 
+    struct cp_layout l;
+    if(config->phase_continuous){
+        cp_layout(d0, d1, twoAntennas ? 8 : 32, config->quadrature, &l);
+        sm_config_set_wrap(&c, offset + l.get_symbol, offset + l.wrap);
+    }else{
+        sm_config_set_wrap(&c, offset, offset + backscatter_program.length-1);
+    }
     // setup specific state-machine config
     sm_config_set_set_pins(&c, pin1, 1);
     if(twoAntennas){
@@ -146,36 +346,107 @@ bool backscatter_program_init(PIO pio, uint sm, uint pin1, uint pin2, uint16_t d
     sm_config_set_out_shift(&c, false, true, 32);  // OUT shifts to left (MSB first), autopull after every 32 bit
     pio_sm_init(pio, sm, offset, &c);
     pio_sm_set_enabled(pio, sm, true);
-    uint32_t reps0 = ((CLKFREQ*1000000/baud - 4) / d0) - 1;
-    uint32_t reps1 = ((CLKFREQ*1000000/baud - 4) / d1) - 1;
-    pio_sm_put_blocking(pio, sm, reps0); // -1 is requried since JMP 0-- is still true
-    pio_sm_put_blocking(pio, sm, reps1); // -1 is required since JMP 0-- is still true
+    if(!config->phase_continuous){ // the phase-continuous program receives the period count with every symbol
+        uint32_t reps0 = ((CLKFREQ*1000000/baud - 4) / d0) - 1;
+        uint32_t reps1 = ((CLKFREQ*1000000/baud - 4) / d1) - 1;
+        pio_sm_put_blocking(pio, sm, reps0); // -1 is requried since JMP 0-- is still true
+        pio_sm_put_blocking(pio, sm, reps1); // -1 is required since JMP 0-- is still true
+    }
 
     // compute configuration parameters
     uint32_t fcenter    = (CLKFREQ*1000000/d0 + CLKFREQ*1000000/d1)/2;
-    uint32_t fdeviation = abs(round((((double) CLKFREQ*1000000)/((double) d1)) - ((double) fcenter)));
+    uint32_t fdeviation = subcarrier_deviation(d0, d1);
     config->baudrate    = baud;
-    config->center_offset = round(fcenter);
-    config->deviation   = round(fdeviation);
-    config->minRxBw     = round((baud + 2*fdeviation));
-    
-    if (fdeviation > 380000){
-        printf("WARNING: the deviation is too large for the CC2500\n");
+    config->center_offset = fcenter;
+    config->deviation   = fdeviation;
+    config->minRxBw     = baud + 2*fdeviation;
+    config->program_length = length;
+    config->count_bits  = config->phase_continuous ? phase_continuous_count_bits(d0, d1, baud) : 0;
+    config->div0        = d0;
+    config->div1        = d1;
+    config->symbol_cycles = CLKFREQ*1000000/baud;
+}
+
+void backscatter_send(PIO pio, uint sm, uint32_t *message, uint32_t len) {
+    for(uint32_t i = 0; i < len; i++){
+        pio_sm_put_blocking(pio, sm, message[i]); // set pin back to low
     }
-    if (fdeviation > 1000000){
-        printf("WARNING: the deviation is too large for the CC1352\n");
+    sleep_ms(1); // wait for transmission to finish
+}
+
+/*
+ * The symbol boundaries follow the nominal symbol clock: every symbol gets the number of whole periods which ends
+ * closest to its nominal end, the residual is carried to the next symbol.
+ */
+uint32_t backscatter_encode(const struct backscatter_config *config, const uint32_t *message, uint32_t len, uint32_t *symbols) {
+    if(!config->phase_continuous){
+        memcpy(symbols, message, len*sizeof(uint32_t));
+        return len;
     }
-    if (d0 < d1){
-        printf("WARNING: symbol 0 has been assigned to larger frequncy than symbol 1\n");
+    const uint8_t  width     = config->count_bits + 1;
+    const uint32_t max_count = (1u << config->count_bits) - 1;
+    uint64_t nominal = 0; // end of the current symbol [cycles]
+    uint64_t sent    = 0; // end of the sent periods [cycles]
+    uint32_t words   = 0;
+    uint32_t word    = 0;
+    uint8_t  used    = 0;
+    for(uint32_t i = 0; i < len; i++){
+        for(int8_t b = 31; b >= 0; b--){
+            uint32_t bit = (message[i] >> b) & 1;
+            uint16_t d   = (bit ^ config->lower_sideband) ? config->div1 : config->div0; // mirrored tones on the lower sideband
+            nominal += config->symbol_cycles;
+            uint32_t periods = (uint32_t) ((nominal - sent + d/2) / d);
+            periods = min(max(periods, 1), max_count + 1);
+            sent += (uint64_t) periods * d;
+            word  = (word << width) | ((bit ^ config->lower_sideband) << config->count_bits) | (periods - 1);
+            used += width;
+            if(used == 32){
+                symbols[words++] = word;
+                word = 0;
+                used = 0;
+            }
+        }
     }
+    return words;
+}
 
-    printf("Computed baseband settings: \n- baudrate: %d\n- Center offset: %d\n- deviation: %d\n- RX Bandwidth: %d\n", config->baudrate, config->center_offset, config->deviation, config->minRxBw);
-    return true;
+uint32_t backscatter_airtime_us(const struct backscatter_config *config, uint32_t len) {
+    uint64_t bits = (uint64_t) len * 32;
+    return (uint32_t) ((bits * 1000000 + config->baudrate - 1) / config->baudrate);
 }
 
-void backscatter_send(PIO pio, uint sm, uint32_t *message, uint32_t len) {
+/*
+ * The state-machine stalls on "out x, 1" (autopull) once the last bit of the OSR has been sent. This sets the sticky
+ * TXSTALL flag in FDEBUG. The flag is still set from the previous frame (or the program start) until the first word
+ * is in the FIFO, therefore it is cleared after the first word has been pulled.
+ */
+void backscatter_start(PIO pio, uint sm, uint32_t *message, uint32_t len) {
+    trace_add(TRACE_BACKSCATTER_START, len);
     for(uint32_t i = 0; i < len; i++){
-        pio_sm_put_blocking(pio, sm, message[i]); // set pin back to low
+        pio_sm_put_blocking(pio, sm, message[i]);
+        if(i == 0){
+            while(!pio_sm_is_tx_fifo_empty(pio, sm));      // first word pulled: the state-machine is running
+            pio->fdebug = 1u << (PIO_FDEBUG_TXSTALL_LSB + sm); // write 1 to clear
+        }
     }
-    sleep_ms(1); // wait for transmission to finish
+}
+
+/*
+ * Antenna 2 lags antenna 1 by a quarter period (upper sideband). Inverting its output makes it lead by a quarter
+ * period (lower sideband) without changing the program, the encoder swaps the tones (the lower sideband mirrors them).
+ */
+void backscatter_set_sideband(struct backscatter_config *config, uint pin2, bool lower) {
+    config->lower_sideband = config->quadrature && lower;
+    gpio_set_outover(pin2, config->lower_sideband ? GPIO_OVERRIDE_INVERT : GPIO_OVERRIDE_NORMAL);
+}
+
+bool backscatter_wait(PIO pio, uint sm, absolute_time_t deadline) {
+    while(!(pio->fdebug & (1u << (PIO_FDEBUG_TXSTALL_LSB + sm)))){
+        if(time_reached(deadline)){
+            trace_add(TRACE_BACKSCATTER_DONE, 0);
+            return false;
+        }
+    }
+    trace_add(TRACE_BACKSCATTER_DONE, 1);
+    return true;
 }
@@ -10,7 +10,6 @@
 #endif
 
 #include <stdio.h>
-#include <math.h>
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
@@ -40,6 +39,13 @@ struct backscatter_config {
   uint32_t center_offset;
   uint32_t deviation;
   uint32_t minRxBw;
+  uint8_t  program_length; // generated instructions (instructionBuffer)
+  bool     phase_continuous; // input: generate/load the phase-continuous program (set before backscatter_program_init/load)
+  bool     quadrature;     // input: single-sideband phase-continuous program (two antennas, see below)
+  bool     lower_sideband; // quadrature: antenna 2 leads (backscatter_set_sideband)
+  uint8_t  count_bits;     // phase-continuous: width of the period count per symbol
+  uint16_t div0, div1;
+  uint32_t symbol_cycles;  // clock cycles per symbol
 };
 #endif
 
@@ -47,6 +53,12 @@ struct backscatter_config {
 // backscatter //
 // ----------- //
 
+// closest baud-rate which is achievable with an integer number of clock cycles per symbol
+uint32_t achievable_baud(uint32_t baud);
+
+// frequency deviation [Hz] of the subcarriers CLKFREQ/d0 and CLKFREQ/d1 from their center
+uint32_t subcarrier_deviation(uint16_t d0, uint16_t d1);
+
 // how many instructions are needed to create this delay?
 uint8_t instructionCount(uint16_t delay, uint16_t max_delay);
 
@@ -55,7 +67,50 @@ int16_t repeat(uint16_t* instructionBuffer, int16_t delay, uint32_t asm_instr, u
 
 bool generatePIOprogram(uint16_t d0,uint16_t d1, uint32_t baud, uint16_t* instructionBuffer, struct pio_program *backscatter_program, bool twoAntennas);
 
+/*
+ * Phase-continuous FSK: every symbol consists of whole subcarrier periods and starts with the low half of its first
+ * period, the subcarrier is therefore never truncated at a symbol boundary (no phase jump, lower spectral side lobes).
+ * The boundary instructions (next symbol, period count) run during this low half instead of stretching it.
+ * The PIO cannot accumulate the residual of a symbol (CLK/baud is rarely a multiple of d0 and d1), the CPU therefore
+ * sends the period count with every symbol (see backscatter_encode): it carries the residual to the next symbol and
+ * keeps every symbol boundary within half a period of its nominal time (no drift of the symbol clock).
+ *
+ * quadrature: single-sideband backscatter with two antennas. Antenna 2 (side-set) is driven a quarter period after
+ * antenna 1 (I/Q square waves), instead of in phase. With a quarter-wave RF phase difference between the two
+ * antennas (spacing or feed line), the reflections of the mirror sideband cancel and those of the used sideband
+ * add up. The dividers must be at least 16 (d/4 is rounded, quarters of unequal length for d not divisible by 4).
+ */
+bool generatePIOprogramPhaseContinuous(uint16_t d0,uint16_t d1, uint32_t baud, uint16_t* instructionBuffer, struct pio_program *backscatter_program, bool twoAntennas, bool quadrature);
+
+// width of the period count of the phase-continuous program (3, 7 or 15 bit, 0 if the baud-rate is too low)
+uint8_t phase_continuous_count_bits(uint16_t d0, uint16_t d1, uint32_t baud);
+
+// instructions of the generated program, 0 if it cannot be generated (does not fit, dividers too small)
+uint8_t backscatter_program_length(uint16_t d0, uint16_t d1, uint32_t baud, bool twoAntennas, bool phaseContinuous, bool quadrature);
+
 /* based on d0/d1/baud, the modulation parameters will be computed and returned in the struct backscatter_config */
 bool backscatter_program_init(PIO pio, uint sm, uint pin1, uint pin2, uint16_t d0, uint16_t d1, uint32_t baud, struct backscatter_config *config, uint16_t *instructionBuffer, bool twoAntennas);
 
+/* load a program generated by backscatter_program_init (e.g. restored from flash) without generating it again */
+void backscatter_program_load(PIO pio, uint sm, uint pin1, uint pin2, uint16_t d0, uint16_t d1, uint32_t baud, const uint16_t *instructions, uint8_t length, struct backscatter_config *config, bool twoAntennas);
+
 void backscatter_send(PIO pio, uint sm, uint32_t *message, uint32_t len);
+
+/*
+ * words for the state-machine: the message itself or, for the phase-continuous program, one (1 + count_bits) bit
+ * symbol (bit, periods-1) per message bit. symbols must hold len * BACKSCATTER_ENCODE_FACTOR words, returns their number.
+ */
+#define BACKSCATTER_ENCODE_FACTOR 16
+uint32_t backscatter_encode(const struct backscatter_config *config, const uint32_t *message, uint32_t len, uint32_t *symbols);
+
+// airtime [us] of len 32-bit words at the baud-rate of the active configuration (rounded up)
+uint32_t backscatter_airtime_us(const struct backscatter_config *config, uint32_t len);
+
+// put the message into the FIFO and return without waiting (see backscatter_wait)
+void backscatter_start(PIO pio, uint sm, uint32_t *message, uint32_t len);
+
+// quadrature: select the upper (antenna 2 lags) or lower (antenna 2 leads) sideband (applied by backscatter_program_load)
+void backscatter_set_sideband(struct backscatter_config *config, uint pin2, bool lower);
+
+// wait until the state-machine finished the last symbol (stalls on the empty FIFO), false if the deadline was reached first
+bool backscatter_wait(PIO pio, uint sm, absolute_time_t deadline);
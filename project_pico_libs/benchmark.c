@@ -0,0 +1,120 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Throughput benchmark (see benchmark.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "packet_generation.h"
+#include "bit_errors.h"
+#include "rate_control.h"
+#include "benchmark.h"
+
+void bench_init(struct benchmark *bench, uint8_t pattern) {
+    memset(bench, 0, sizeof(struct benchmark));
+    bench->pattern = pattern;
+}
+
+bool bench_add_point(struct benchmark *bench, struct bench_point point) {
+    if(bench->running || bench->points >= BENCH_MAX_POINTS || point.len < 1 || point.len > MAX_PAYLOADSIZE){
+        return false;
+    }
+    bench->grid[bench->points++] = point;
+    return true;
+}
+
+void bench_clear(struct benchmark *bench) {
+    if(!bench->running){
+        bench->points = 0;
+    }
+}
+
+// the rate ladder with the default and the largest payload at full carrier power
+static void bench_default_grid(struct benchmark *bench) {
+    for(uint8_t i = 0; i < RATE_LADDER_STEPS; i++){
+        bench_add_point(bench, (struct bench_point){.d0 = rate_ladder[i].d0, .d1 = rate_ladder[i].d1, .baud = rate_ladder[i].baud, .power_dbm = 1, .len = PAYLOADSIZE});
+        bench_add_point(bench, (struct bench_point){.d0 = rate_ladder[i].d0, .d1 = rate_ladder[i].d1, .baud = rate_ladder[i].baud, .power_dbm = 1, .len = MAX_PAYLOADSIZE});
+    }
+}
+
+void bench_start(struct benchmark *bench, uint32_t frames) {
+    if(bench->points == 0){
+        bench_default_grid(bench);
+    }
+    bench->frames     = max(1, min(frames, BENCH_MAX_FRAMES));
+    bench->current    = 0;
+    bench->configured = false;
+    bench->running    = true;
+    printf("bench | %u points, %u frames per point\n", bench->points, bench->frames);
+    printf("bench |  d0  d1   baud power len |  sent  recv crc-ok      BER[ppm] | airtime[us] dead[us] | goodput[bit/s]\n");
+}
+
+void bench_stop(struct benchmark *bench) {
+    if(bench->running){
+        printf("bench | aborted at point %u\n", bench->current);
+    }
+    bench->running = false;
+}
+
+const struct bench_point *bench_point(const struct benchmark *bench) {
+    return &bench->grid[bench->current];
+}
+
+void bench_point_start(struct benchmark *bench, bool applied, uint32_t baud, int8_t power_dbm, uint32_t airtime_us, uint64_t time_us) {
+    memset(&bench->result, 0, sizeof(struct bench_result));
+    bench->result.applied    = applied;
+    bench->result.baud       = baud;
+    bench->result.power_dbm  = power_dbm;
+    bench->result.airtime_us = airtime_us;
+    bench->result.start_us   = time_us;
+    bench->configured        = true;
+    ber_init(&bench->ber, BER_FIXED_PATTERN, bench->pattern, bench_point(bench)->len);
+}
+
+void bench_sent(struct benchmark *bench) {
+    bench->result.sent++;
+}
+
+void bench_received(struct benchmark *bench, const uint8_t *packet, Packet_status status) {
+    bench->result.received++;
+    if(!status.overflowed && status.CRCcheck){
+        bench->result.crc_pass++;
+    }
+    ber_add_frame(&bench->ber, packet, status);
+}
+
+bool bench_point_done(const struct benchmark *bench) {
+    return bench->configured && (!bench->result.applied || bench->result.sent >= bench->frames);
+}
+
+static void bench_print_row(struct benchmark *bench, uint64_t time_us) {
+    const struct bench_point  *p = bench_point(bench);
+    const struct bench_result *r = &bench->result;
+    if(!r->applied){
+        printf("bench | %3u %3u %6u %+5d %3u | configuration rejected\n", p->d0, p->d1, p->baud, p->power_dbm, p->len);
+        return;
+    }
+    uint64_t elapsed  = (time_us > r->start_us) ? (time_us - r->start_us) : 1;
+    uint64_t airtime  = (uint64_t) r->sent * r->airtime_us;
+    uint32_t dead     = (r->sent > 0 && elapsed > airtime) ? (uint32_t) ((elapsed - airtime) / r->sent) : 0;
+    uint32_t ok       = (r->sent > 0) ? (r->crc_pass * 10000) / r->sent : 0; // 0.01%
+    uint32_t goodput  = (uint32_t) (((uint64_t) r->crc_pass * p->len * 8 * 1000000) / elapsed);
+    uint32_t ber_ppm  = (bench->ber.counters.bits > 0) ? (uint32_t) ((bench->ber.counters.bit_errors * 1000000) / bench->ber.counters.bits) : 0;
+    printf("bench | %3u %3u %6u %+5d %3u | %5u %5u %3u.%02u%% %13u | %11u %8u | %14u\n",
+           p->d0, p->d1, r->baud, r->power_dbm, p->len, r->sent, r->received, ok / 100, ok % 100, ber_ppm, r->airtime_us, dead, goodput);
+}
+
+bool bench_next_point(struct benchmark *bench, uint64_t time_us) {
+    bench_print_row(bench, time_us);
+    bench->current++;
+    bench->configured = false;
+    if(bench->current >= bench->points){
+        bench->running = false;
+        printf("bench | done\n");
+    }
+    return bench->running;
+}
@@ -0,0 +1,86 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Throughput benchmark for the combined board (carrier-receiver-baseband): a grid of configurations
+ * (d0, d1, baud, carrier TX power, payload length) is measured with a fixed number of frames per point,
+ * sent back to back. Per point one row is printed ("bench | ..."):
+ * - frames sent, received and received with a valid CRC
+ * - BER of the received frames (parts per million)
+ * - airtime per frame and dead time per frame (wall time of the point minus the airtime, i.e. carrier
+ *   start, RX completion and reconfiguration)
+ * - goodput: payload bits of CRC-valid frames per second of wall time
+ *
+ */
+
+#ifndef BENCHMARK_LIB
+#define BENCHMARK_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "bit_errors.h"
+
+#define BENCH_MAX_POINTS        16
+#define BENCH_DEFAULT_FRAMES   100 // frames per point
+#define BENCH_MAX_FRAMES     10000
+
+struct bench_point {
+  uint16_t d0;
+  uint16_t d1;
+  uint32_t baud;
+  int8_t   power_dbm;  // carrier output power
+  uint8_t  len;        // payload length [byte]
+};
+
+struct bench_result {
+  bool     applied;    // false: configuration rejected, point skipped
+  uint32_t baud;       // achieved baud-rate
+  int8_t   power_dbm;  // applied carrier output power
+  uint32_t airtime_us; // per frame
+  uint32_t sent;
+  uint32_t received;
+  uint32_t crc_pass;
+  uint64_t start_us;
+};
+
+struct benchmark {
+  struct bench_point  grid[BENCH_MAX_POINTS];
+  uint8_t             points;
+  bool                running;
+  bool                configured; // the current point has been applied
+  uint8_t             current;
+  uint32_t            frames;     // per point
+  struct bench_result result;
+  struct ber_engine   ber;
+  uint8_t             pattern;    // payload byte
+};
+
+void bench_init(struct benchmark *bench, uint8_t pattern);
+
+/* grid editing (not while running), returns false if the grid is full or the payload too long */
+bool bench_add_point(struct benchmark *bench, struct bench_point point);
+void bench_clear(struct benchmark *bench);
+
+/* start measuring the grid (the rate ladder at +1 dBm with two payload lengths if empty) */
+void bench_start(struct benchmark *bench, uint32_t frames);
+
+/* abort a running benchmark */
+void bench_stop(struct benchmark *bench);
+
+/* the point to configure next */
+const struct bench_point *bench_point(const struct benchmark *bench);
+
+/* the point has been configured (applied = false: it is skipped) */
+void bench_point_start(struct benchmark *bench, bool applied, uint32_t baud, int8_t power_dbm, uint32_t airtime_us, uint64_t time_us);
+
+void bench_sent(struct benchmark *bench);
+
+void bench_received(struct benchmark *bench, const uint8_t *packet, Packet_status status);
+
+bool bench_point_done(const struct benchmark *bench);
+
+/* print the row of the current point and move on, returns false once the grid is finished */
+bool bench_next_point(struct benchmark *bench, uint64_t time_us);
+
+#endif
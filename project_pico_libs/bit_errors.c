@@ -0,0 +1,135 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * on-device bit-error-rate computation
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "packet_generation.h"
+#include "bit_errors.h"
+
+#define BER_MAX_POSITION_JUMP 16 // frames: larger jumps of the index in corrupted frames are not trusted
+
+void ber_init(struct ber_engine *ber, enum ber_reference reference, uint8_t pattern, uint8_t payload_len){
+    memset(ber, 0, sizeof(struct ber_engine));
+    ber->reference       = reference;
+    ber->pattern         = pattern;
+    ber->payload_len     = payload_len;
+    stream_seek(&ber->stream, 0);
+}
+
+// move the reference generator to position (the index of generate_data), also backwards
+static void ber_seek(struct ber_engine *ber, uint16_t position){
+    position &= 0xFFFE; // samples start at even positions
+    if(position != ber->stream.position){
+        stream_seek(&ber->stream, position);
+    }
+}
+
+// index of the frame: trusted if the CRC passed, otherwise only if consistent with the previous frames
+static uint16_t ber_frame_position(struct ber_engine *ber, const uint8_t *payload, bool crc_pass){
+    uint16_t received = (((uint16_t) payload[0]) << 8) | payload[1];
+    uint16_t step     = ber->payload_len - 2;
+    if(crc_pass || !ber->position_valid){
+        return received;
+    }
+    uint16_t distance = received - ber->last_position;
+    if(step > 0 && distance % step == 0 && distance / step <= BER_MAX_POSITION_JUMP){
+        return received;
+    }
+    return ber->last_position + step;
+}
+
+uint32_t ber_add_frame(struct ber_engine *ber, const uint8_t *packet, Packet_status status){
+    uint32_t errors = 0;
+    uint32_t bits   = 8 * (uint32_t) ber->payload_len;
+    ber->counters.frames++;
+    if(status.overflowed){
+        // the frame content is unknown: all bits are erroneous
+        ber->counters.crc_error++;
+        ber->counters.bits       += bits;
+        ber->counters.bit_errors += bits;
+        return bits;
+    }
+    if(!status.CRCcheck){
+        ber->counters.crc_error++;
+    }
+    // bytes in the buffer: length, sequence number and payload
+    uint8_t in_buffer      = min(min(status.len, 62), RX_BUFFER_SIZE);
+    uint8_t received       = (in_buffer > 2) ? min(in_buffer - 2, ber->payload_len) : 0;
+    const uint8_t *payload = &packet[2];
+
+    uint8_t first = 0;
+    uint8_t low   = 0;
+    if(ber->reference == BER_SAMPLE_STREAM){
+        if(received < 2){
+            ber->counters.bits       += bits;
+            ber->counters.bit_errors += bits;
+            return bits;
+        }
+        // the index is not part of the compared data (see stats/statistics.ipynb)
+        uint16_t position = ber_frame_position(ber, payload, status.CRCcheck);
+        ber->position_valid = true;
+        ber->last_position  = position;
+        ber_seek(ber, position);
+        bits  = 8 * (uint32_t) (ber->payload_len - 2);
+        first = 2;
+    }
+    for(uint8_t i = first; i < received; i++){
+        uint8_t expected;
+        if(ber->reference == BER_SAMPLE_STREAM){
+            // two bytes per sample (MSB first)
+            if((i - first) % 2 == 0){
+                uint16_t sample = stream_sample(&ber->stream);
+                expected = (uint8_t) (sample >> 8);
+                low      = (uint8_t) (sample & 0x00FF);
+            }else{
+                expected = low;
+            }
+        }else{
+            expected = ber->pattern;
+        }
+        errors += __builtin_popcount(payload[i] ^ expected);
+    }
+    // bytes missing due to a corrupted length field are considered entirely erroneous
+    if(received < ber->payload_len){
+        errors += 8 * (uint32_t) (ber->payload_len - max(received, first));
+    }
+    ber->counters.bits       += bits;
+    ber->counters.bit_errors += errors;
+    return errors;
+}
+
+static void ber_print(struct ber_engine *ber, uint32_t lost_frames){
+    struct ber_counters *c = &ber->counters;
+    uint64_t frame_bits = (ber->reference == BER_SAMPLE_STREAM) ? 8 * (uint64_t) (ber->payload_len - 2) : 8 * (uint64_t) ber->payload_len;
+    printf("ber | configuration %u | frames %u crc-error %u | bits %llu errors %llu ", ber->configuration, c->frames, c->crc_error, c->bits, c->bit_errors);
+    // BER in parts per million (no soft-float)
+    if(c->bits > 0){
+        uint32_t ppm = (uint32_t) ((c->bit_errors * 1000000) / c->bits);
+        printf("| BER %u.%06u ", ppm / 1000000, ppm % 1000000);
+    }
+    uint64_t all_bits = c->bits + lost_frames * frame_bits;
+    if(lost_frames > 0 && all_bits > 0){
+        uint32_t ppm = (uint32_t) (((c->bit_errors + lost_frames * frame_bits) * 1000000) / all_bits);
+        printf("| incl. %u lost frames %u.%06u ", lost_frames, ppm / 1000000, ppm % 1000000);
+    }
+    printf("\n");
+}
+
+void ber_report(struct ber_engine *ber, uint32_t lost_frames){
+    ber_print(ber, lost_frames);
+}
+
+void ber_new_configuration(struct ber_engine *ber, uint32_t lost_frames){
+    if(ber->counters.frames > 0){
+        ber_print(ber, lost_frames);
+    }
+    memset(&ber->counters, 0, sizeof(struct ber_counters));
+    ber->position_valid = false;
+    ber->configuration++;
+}
@@ -0,0 +1,65 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * on-device bit-error-rate computation
+ * (the same computation as demo/demo.py and stats/statistics.ipynb without a host in the loop)
+ *
+ * The expected payload is regenerated on the receiving Pico:
+ * - BER_FIXED_PATTERN: every payload byte equals a fixed pattern (e.g. 0xA5 as used by the demo)
+ * - BER_SAMPLE_STREAM: the payload starts with the 2-byte file_position, followed by the samples
+ *                      of generate_sample() at this position (see generate_data(..., true))
+ * Bit errors are counted for every frame, including frames which failed the CRC check.
+ *
+ */
+
+#ifndef BIT_ERRORS_LIB
+#define BIT_ERRORS_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "packet_generation.h"
+
+enum ber_reference {
+  BER_FIXED_PATTERN = 0,
+  BER_SAMPLE_STREAM = 1
+};
+
+struct ber_counters {
+  uint32_t frames;      // compared frames (incl. CRC errors)
+  uint32_t crc_error;   // compared frames with CRC error
+  uint64_t bits;        // compared bits
+  uint64_t bit_errors;
+};
+
+struct ber_engine {
+  enum ber_reference reference;
+  uint8_t  pattern;         // BER_FIXED_PATTERN: expected payload byte
+  uint8_t  payload_len;     // payload bytes after length and sequence number
+  // BER_SAMPLE_STREAM: position of the last frame (used if the index of a corrupted frame is not plausible)
+  bool     position_valid;
+  uint16_t last_position;
+  // BER_SAMPLE_STREAM: reference generator (independent of the one of generate_data)
+  struct sample_stream stream;
+  // running BER of the current configuration
+  uint32_t configuration;
+  struct ber_counters counters;
+};
+
+void ber_init(struct ber_engine *ber, enum ber_reference reference, uint8_t pattern, uint8_t payload_len);
+
+/*
+ * compare a frame obtained with readPacket() with the regenerated reference
+ * packet[0]: length field, packet[1]: sequence number, packet[2...]: payload
+ * returns the number of bit errors of this frame
+ */
+uint32_t ber_add_frame(struct ber_engine *ber, const uint8_t *packet, Packet_status status);
+
+/* print the running BER; lost_frames (e.g. from link_stats) are additionally considered as entirely erroneous */
+void ber_report(struct ber_engine *ber, uint32_t lost_frames);
+
+/* print the BER of the finished configuration and start counting for the next one */
+void ber_new_configuration(struct ber_engine *ber, uint32_t lost_frames);
+
+#endif
@@ -15,12 +15,14 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
+#include <stdlib.h>
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
 #include "hardware/spi.h"
+#include "cc2500.h"
 #include "receiver_CC2500.h"
 #include "carrier_CC2500.h"
+#include "trace.h"
 
 // Address Config = No address check
 // Base Frequency = 2449.999756
@@ -45,6 +47,14 @@ RF_setting cc2500_unmodulated_2450MHz[16] = {
   {.address = 0x26, .value = 0x11}, // CC2500_FSCAL0: Frequency Synthesizer Calibration
 };
 
+RF_profile tx_profiles[TX_PROFILE_COUNT];
+
+struct carrier_timing carrier_timing;
+
+static int8_t tx_power_dbm = 1; // output power of the last applied PA table entry (setupCarrier: +1dBm)
+
+CC2500 radio_carrier = {.spi = RADIO_SPI, .csn = CARRIER_CSN, .gdo0 = CC2500_NO_PIN, .name = "tx"};
+
 RF_power TX_power[] = {
     {.TX_power_dbm = -55, .RegisterValue = 0x00}, //  0
     {.TX_power_dbm = -30, .RegisterValue = 0x50}, //  1
@@ -67,68 +77,79 @@ RF_power TX_power[] = {
 };
 
 void cs_select_tx() {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(CARRIER_CSN, 0);  // Active low
-    asm volatile("nop \n nop \n nop");
+    cc2500_cs_select(&radio_carrier);
 }
 
 void cs_deselect_tx() {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(CARRIER_CSN, 1);
-    asm volatile("nop \n nop \n nop");
+    cc2500_cs_deselect(&radio_carrier);
 }
 
 void write_strobe_tx(uint8_t cmd) {
-    cs_select_tx();
-    spi_write_blocking(RADIO_SPI, &cmd, 1);
-    cs_deselect_tx();
+    cc2500_strobe(&radio_carrier, cmd);
     sleep_ms(1);
 }
 
 void write_register_tx(RF_setting set) {
-    uint8_t buf[2];
-    buf[0] = set.address;
-    buf[1] = set.value;
-    cs_select_tx();
-    spi_write_blocking(RADIO_SPI, buf, 2);
-    cs_deselect_tx();
+    cc2500_write_register(&radio_carrier, set.address, set.value);
     sleep_ms(1);
 }
 
 void write_registers_tx(RF_setting* sets, uint8_t len) {
-    uint8_t buf[2];
-    cs_select_tx();
-    for (int i = 0; i < len; i++) {
-        buf[0] = sets[i].address;
-        buf[1] = sets[i].value;
-        spi_write_blocking(RADIO_SPI, buf, 2);
-    }
-    cs_deselect_tx();
+    cc2500_write_registers(&radio_carrier, sets, len);
+}
+
+void write_burst_tx(uint8_t address, const uint8_t *values, uint8_t len) {
+    cc2500_write_burst(&radio_carrier, address, values, len);
+}
+
+void read_burst_tx(uint8_t address, uint8_t *values, uint8_t len) {
+    cc2500_read_burst(&radio_carrier, address, values, len);
+}
+
+// status registers (0x30 - 0x3D) can only be accessed with the burst bit set
+uint8_t read_status_tx(uint8_t address) {
+    return cc2500_read_status(&radio_carrier, address);
+}
+
+// command strobe without the additional delay of write_strobe_tx
+static void strobe_tx(uint8_t cmd) {
+    cc2500_strobe(&radio_carrier, cmd);
+}
+
+static bool wait_idle_tx() {
+    return cc2500_wait_idle(&radio_carrier);
 }
 
 RF_setting read_register_tx(uint8_t address) {
-    uint8_t buf[2] = {0, 0};
-    cs_select_tx();
-    spi_read_blocking(RADIO_SPI, address+0x80, buf, 2);
-    cs_deselect_tx();
-    sleep_ms(1);
-    return (RF_setting){.address = address, .value = buf[1]};
+    return (RF_setting){.address = address, .value = cc2500_read_register(&radio_carrier, address)};
 }
 
 void setTXpower(RF_power setting) {
-    uint8_t buf[3];
-    cs_select_tx();
-    buf[0] = (1 << 6) | 0x3E; // enable burst write to 0x3E
-    buf[1] = setting.RegisterValue;
-    buf[2] = setting.RegisterValue;
-    spi_write_blocking(RADIO_SPI, buf, 3);
-    cs_deselect_tx();
+    uint8_t buf[2] = {setting.RegisterValue, setting.RegisterValue};
+    cc2500_write_burst(&radio_carrier, 0x3E, buf, 2); // burst write to the PA table (0x3E)
+    tx_power_dbm = setting.TX_power_dbm;
+}
+
+int8_t get_tx_power_dbm() {
+    return tx_power_dbm;
+}
+
+int8_t set_tx_power_dbm(int8_t dbm) {
+    uint8_t best = 0;
+    for(uint8_t i = 1; i < sizeof(TX_power)/sizeof(RF_power); i++){
+        if(abs(TX_power[i].TX_power_dbm - dbm) < abs(TX_power[best].TX_power_dbm - dbm)){
+            best = i;
+        }
+    }
+    setTXpower(TX_power[best]);
+    return TX_power[best].TX_power_dbm;
 }
 
 
 void setupCarrier(){
     write_strobe_tx(SRES);  // in case of reset without power loss - reset manually
     sleep_us(100);
+    radio_carrier.shadow_valid = 0;
     write_strobe_tx(SIDLE); // ensure IDLE mode with command strobe: SIDLE
     write_registers_tx(cc2500_unmodulated_2450MHz,16);
     setTXpower(TX_power[17]); // set +1dBm output power (max)
@@ -154,13 +175,13 @@ void set_frecuency_tx(uint32_t f_carrier)
     
     // see datasheet, section 21
     // approach: chose start frequency as close as possible to f_carrier, correct with channel
-    uint32_t freq = floor(f_carrier *((double) (1 << 16)) / ((double) F_XOSC));
+    uint32_t freq = frequency_word(f_carrier);
     uint8_t channel = 0;
     uint8_t channspc_e = 0;
-    uint8_t channspc_m = floor(((((double) f_carrier) * (1 << 16)) / ((double) F_XOSC) - freq - (1 << 6)) * (1 << 2));
+    uint8_t channspc_m = channel_spacing_m(f_carrier);
 
-    // print new value
-    uint32_t f_carrier_calculated = floor(((double) F_XOSC) * (freq + (double) channel*(256+channspc_m)/((double) (1 << 2))) / ((double) (1 << 16)));
+    // print new value (channel = 0)
+    uint32_t f_carrier_calculated = frequency_of_word(freq);
     printf("set tx f_carrier [%u %u %u %u] %u\n", freq, channel, channspc_e, channspc_m, f_carrier_calculated);
     
     // CHANNR, FREQ2, FREQ1, FREQ0, MDMCFG1, MDMCFG1
@@ -176,3 +197,143 @@ void set_frecuency_tx(uint32_t f_carrier)
     //printf("debug %02x %02x %02x %02x %02x %02x\n", set[0].value, set[1].value, set[2].value, set[3].value, set[4].value, set[5].value);
     write_registers_tx(set,6);
 }
+
+/*
+ * Carrier profiles: see receiver_CC2500.c (calibrate_profile_rx) for a description.
+ */
+uint32_t calibrate_profile_tx(RF_profile *profile, uint32_t f_carrier)
+{
+    uint32_t freq = frequency_word(f_carrier);
+    strobe_tx(SIDLE);
+    wait_idle_tx();
+
+    // start from the currently configured carrier settings (CHANNR = 0 is expected)
+    read_burst_tx(PROFILE_FIRST_REGISTER, profile->registers, PROFILE_BLOCK_SIZE);
+    profile->registers[PROFILE_REG(0x0D)] = (freq & 0x007f0000) >> 16;
+    profile->registers[PROFILE_REG(0x0E)] = (freq & 0x0000ff00) >> 8;
+    profile->registers[PROFILE_REG(0x0F)] = (freq & 0x000000ff);
+    profile->registers[PROFILE_REG(0x18)] &= 0xCF; // MCSM0: FS_AUTOCAL = 0 (never calibrate automatically)
+    write_burst_tx(PROFILE_FIRST_REGISTER, profile->registers, PROFILE_BLOCK_SIZE);
+
+    // calibrate once and cache FSCAL3, FSCAL2, FSCAL1
+    strobe_tx(SCAL);
+    profile->calibrated = wait_idle_tx();
+    read_burst_tx(0x23, &profile->registers[PROFILE_REG(0x23)], 3);
+    profile->f_carrier = frequency_of_word(freq);
+    return profile->f_carrier;
+}
+
+uint8_t calibrate_profiles_tx(uint32_t f_start, uint32_t f_step, uint8_t count)
+{
+    uint8_t calibrated = 0;
+    write_register_tx((RF_setting){.address = 0x0a, .value = 0x00}); // CHANNR = 0
+    for(uint8_t i = 0; i < min(count, TX_PROFILE_COUNT); i++){
+        calibrate_profile_tx(&tx_profiles[i], f_start + i*f_step);
+        if(tx_profiles[i].calibrated){
+            calibrated++;
+        }
+    }
+    return calibrated;
+}
+
+bool select_profile_tx(const RF_profile *profile)
+{
+    if(!profile->calibrated){
+        return false;
+    }
+    strobe_tx(SIDLE); // frequency and calibration registers may only be changed in IDLE
+    wait_idle_tx();
+    write_burst_tx(PROFILE_FIRST_REGISTER, profile->registers, PROFILE_BLOCK_SIZE);
+    return true;
+}
+
+/*
+ * Carrier standby (see datasheet, section 19.5 & table 34):
+ * IDLE -> TX includes the synthesizer start-up (and the calibration with FS_AUTOCAL = 1), FSTXON -> TX only
+ * switches on the PA. In standby, the automatic calibration is disabled and SCAL is issued explicitly when entering
+ * the standby and periodically afterwards. A frame thus costs two strobes, the MARCSTATE polling and the
+ * re-locking of the synthesizer (SIDLE, SFSTXON) after the frame, which is not on the critical path.
+ */
+static bool wait_marcstate_tx(uint8_t state, uint32_t timeout_us) {
+    uint64_t start = time_us_64();
+    while((read_status_tx(MARCSTATE) & 0x1F) != state){
+        if(time_us_64() - start > timeout_us){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void enter_standby_tx() {
+    strobe_tx(SIDLE);
+    wait_idle_tx();
+    uint8_t mcsm0 = cc2500_read_register(&radio_carrier, 0x18);
+    if(mcsm0 & 0x30){
+        cc2500_write_register(&radio_carrier, 0x18, mcsm0 & 0xCF); // MCSM0: FS_AUTOCAL = 0 (calibrate manually)
+    }
+    strobe_tx(SCAL);
+    wait_idle_tx();
+    carrier_timing.last_calibration_us = time_us_64();
+    carrier_timing.calibrations++;
+    strobe_tx(SFSTXON);
+}
+
+void carrier_standby_tx(bool enable) {
+    carrier_timing.standby = enable;
+    if(enable){
+        enter_standby_tx();
+        wait_marcstate_tx(MARCSTATE_FSTXON, CARRIER_START_TIMEOUT_US);
+    }else{
+        strobe_tx(SIDLE);
+        wait_idle_tx();
+        uint8_t mcsm0 = cc2500_read_register(&radio_carrier, 0x18);
+        cc2500_write_register(&radio_carrier, 0x18, (mcsm0 & 0xCF) | 0x10); // MCSM0: FS_AUTOCAL = 1 (IDLE -> TX)
+    }
+}
+
+uint32_t start_carrier_tx() {
+    trace_add(TRACE_CARRIER_START, 0);
+    // configuration changes (e.g. set_frecuency_tx) leave the carrier in IDLE: enter the standby again
+    bool cold = (read_status_tx(MARCSTATE) & 0x1F) != MARCSTATE_FSTXON;
+    if(cold && carrier_timing.standby){
+        enter_standby_tx();
+    }
+    uint64_t start = time_us_64();
+    strobe_tx(STX);
+    if(!wait_marcstate_tx(MARCSTATE_TX, CARRIER_START_TIMEOUT_US)){
+        carrier_timing.timeouts++;
+    }
+    uint32_t latency = (uint32_t) (time_us_64() - start);
+    trace_add(TRACE_CARRIER_ON, min(latency, UINT16_MAX));
+
+    carrier_timing.last_us = latency;
+    carrier_timing.min_us  = (carrier_timing.starts == 0) ? latency : min(carrier_timing.min_us, latency);
+    carrier_timing.max_us  = max(carrier_timing.max_us, latency);
+    carrier_timing.sum_us += latency;
+    carrier_timing.starts++;
+    if(cold){
+        carrier_timing.cold_starts++;
+    }
+    return latency;
+}
+
+void stop_carrier_tx() {
+    trace_add(TRACE_CARRIER_STOP, 0);
+    strobe_tx(SIDLE);
+    if(!carrier_timing.standby){
+        return;
+    }
+    if(time_us_64() - carrier_timing.last_calibration_us > (uint64_t) CARRIER_CALIBRATION_INTERVAL_MS * 1000){
+        enter_standby_tx();
+    }else{
+        wait_idle_tx();
+        strobe_tx(SFSTXON); // re-lock the synthesizer (no calibration)
+    }
+}
+
+void carrier_timing_print_tx() {
+    printf("carrier | standby %s | starts %u cold %u | latency [us] last %u min %u mean %u max %u | calibrations %u timeouts %u\n",
+           carrier_timing.standby ? "on" : "off", carrier_timing.starts, carrier_timing.cold_starts, carrier_timing.last_us, carrier_timing.min_us,
+           carrier_timing.starts ? (uint32_t) (carrier_timing.sum_us / carrier_timing.starts) : 0, carrier_timing.max_us,
+           carrier_timing.calibrations, carrier_timing.timeouts);
+}
@@ -21,6 +21,7 @@
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
 #include "hardware/spi.h"
+#include "cc2500.h"
 
 #define RADIO_SPI             spi0
 #define RADIO_MISO              16
@@ -32,6 +33,16 @@
 #define SIDLE                 0x36
 #define   STX                 0x35
 #define  SRES                 0x30
+#define  SCAL                 0x33
+#define SFSTXON               0x31
+
+#define MARCSTATE             0x35
+#define MARCSTATE_IDLE        0x01
+#define MARCSTATE_FSTXON      0x12
+#define MARCSTATE_TX          0x13
+
+#define CARRIER_START_TIMEOUT_US     2000 // max. time until MARCSTATE reports TX (incl. a calibration)
+#define CARRIER_CALIBRATION_INTERVAL_MS 60000 // recalibrate the synthesizer in standby (temperature drift)
 
 #ifndef RF_SETTING
 #define RF_SETTING
@@ -42,6 +53,27 @@ struct rf_setting {
 typedef struct rf_setting RF_setting;
 #endif
 
+#ifndef RF_PROFILE
+#define RF_PROFILE
+/* 
+ * A profile is a snapshot of the register block FREQ2 (0x0D) ... FSCAL1 (0x25).
+ * It contains the frequency word, the modem settings and the cached synthesizer calibration (FSCAL3/2/1).
+ * Switching to a profile is one burst write without a calibration step (see datasheet, section 19.2 & 28.2).
+ */
+#define PROFILE_FIRST_REGISTER  0x0D // FREQ2
+#define PROFILE_LAST_REGISTER   0x25 // FSCAL1
+#define PROFILE_BLOCK_SIZE      (PROFILE_LAST_REGISTER - PROFILE_FIRST_REGISTER + 1)
+#define PROFILE_REG(address)    ((address) - PROFILE_FIRST_REGISTER)
+struct rf_profile {
+  uint32_t f_carrier;                       // resulting carrier frequency [Hz]
+  uint8_t  registers[PROFILE_BLOCK_SIZE];   // FREQ2 ... FSCAL1
+  bool     calibrated;
+};
+typedef struct rf_profile RF_profile;
+#endif
+
+#define TX_PROFILE_COUNT        16
+
 struct rf_power {
   int8_t TX_power_dbm;
   uint8_t RegisterValue;
@@ -56,6 +88,30 @@ extern RF_setting cc2500_unmodulated_2450MHz[16];
 
 extern RF_power TX_power[18];
 
+extern RF_profile tx_profiles[TX_PROFILE_COUNT];
+
+/*
+ * Carrier standby: the synthesizer stays locked in FSTXON between frames (calibrated once and then every
+ * CARRIER_CALIBRATION_INTERVAL_MS), STX then only has to switch on the PA. The start latency is measured
+ * from the STX strobe until MARCSTATE reports TX.
+ */
+struct carrier_timing {
+  bool     standby;          // park in FSTXON instead of IDLE
+  uint64_t last_calibration_us;
+  uint32_t starts;
+  uint32_t cold_starts;      // starts from IDLE (incl. calibration)
+  uint32_t calibrations;
+  uint32_t timeouts;         // TX not reached within CARRIER_START_TIMEOUT_US
+  uint32_t last_us;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t sum_us;
+};
+extern struct carrier_timing carrier_timing;
+
+// default carrier instance (CARRIER_CSN) used by the ..._tx functions
+extern CC2500 radio_carrier;
+
 void cs_select_tx();
 
 void cs_deselect_tx();
@@ -66,8 +122,20 @@ void write_register_tx(RF_setting set);
 
 void write_registers_tx(RF_setting* sets, uint8_t len);
 
+void write_burst_tx(uint8_t address, const uint8_t *values, uint8_t len);
+
+void read_burst_tx(uint8_t address, uint8_t *values, uint8_t len);
+
+uint8_t read_status_tx(uint8_t address);
+
 void setTXpower(RF_power setting);
 
+// select the closest entry of TX_power, returns the applied output power [dBm]
+int8_t set_tx_power_dbm(int8_t dbm);
+
+// output power of the last setTXpower/set_tx_power_dbm [dBm]
+int8_t get_tx_power_dbm();
+
 void setupCarrier();
 
 void startCarrier();
@@ -77,4 +145,24 @@ void stopCarrier();
 //set carrier frequency [Hz]
 void set_frecuency_tx(uint32_t f_carrier);
 
+// capture the current carrier settings at f_carrier [Hz] and calibrate the synthesizer once
+uint32_t calibrate_profile_tx(RF_profile *profile, uint32_t f_carrier);
+
+// fill tx_profiles[0..count-1] with the channels f_start + i*f_step [Hz], returns the number of calibrated profiles
+uint8_t calibrate_profiles_tx(uint32_t f_start, uint32_t f_step, uint8_t count);
+
+// switch to a calibrated profile (one burst write, no calibration). The carrier is left in IDLE.
+bool select_profile_tx(const RF_profile *profile);
+
+// enable/disable the FSTXON standby (calibrates the synthesizer when enabled)
+void carrier_standby_tx(bool enable);
+
+// start the carrier and wait until it is transmitting, returns the start latency [us]
+uint32_t start_carrier_tx();
+
+// stop the carrier: back to FSTXON in standby mode, otherwise to IDLE
+void stop_carrier_tx();
+
+void carrier_timing_print_tx();
+
 #endif
@@ -0,0 +1,344 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Handle-based CC2500 driver (see cc2500.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "hardware/spi.h"
+#include "cc2500.h"
+#include "trace.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+// registers updated by the radio itself (calibration results) are never taken from the shadow
+#define SHADOW_VOLATILE ((1ull << 0x23) | (1ull << 0x24) | (1ull << 0x25))
+
+// radios with GDO0 interrupts
+static CC2500 *registered_radios[CC2500_MAX_RADIOS];
+static uint8_t registered_count = 0;
+static cc2500_event_handler event_handler = NULL;
+
+void cc2500_init_pins(CC2500 *radio) {
+    gpio_init(radio->csn);
+    gpio_set_dir(radio->csn, GPIO_OUT);
+    gpio_put(radio->csn, 1);
+}
+
+void cc2500_cs_select(CC2500 *radio) {
+    asm volatile("nop \n nop \n nop");
+    gpio_put(radio->csn, 0);  // Active low
+    asm volatile("nop \n nop \n nop");
+}
+
+void cc2500_cs_deselect(CC2500 *radio) {
+    asm volatile("nop \n nop \n nop");
+    gpio_put(radio->csn, 1);
+    asm volatile("nop \n nop \n nop");
+}
+
+static void shadow_update(CC2500 *radio, uint8_t address, const uint8_t *values, uint8_t len) {
+    for(uint8_t i = 0; i < len && address + i < CC2500_CONFIG_REGISTERS; i++){
+        radio->shadow[address + i]  = values[i];
+        radio->shadow_valid        |= (1ull << (address + i));
+    }
+    radio->shadow_valid &= ~SHADOW_VOLATILE;
+}
+
+// FIFO (0x3F), status registers and strobes (0x30 - 0x3D), configuration registers and PATABLE
+static uint8_t bus_priority(uint8_t address) {
+    address &= 0x3F;
+    if(address == 0x3F){
+        return SPI_PRIO_FIFO;
+    }
+    return (address >= 0x30 && address != 0x3E) ? SPI_PRIO_STROBE : SPI_PRIO_CONFIG;
+}
+
+// bursts longer than a bus transaction are split (the FIFO and the PATABLE keep their address)
+static uint8_t bus_burst_address(uint8_t address, uint8_t offset) {
+    return ((address & 0x3F) >= 0x3E) ? address : address + offset;
+}
+
+void cc2500_strobe(CC2500 *radio, uint8_t cmd) {
+    if(radio->bus != NULL){
+        spi_bus_post(radio->bus, radio->csn, SPI_PRIO_STROBE, &cmd, 1);
+        return;
+    }
+    cc2500_cs_select(radio);
+    spi_write_blocking(radio->spi, &cmd, 1);
+    cc2500_cs_deselect(radio);
+}
+
+void cc2500_write_register(CC2500 *radio, uint8_t address, uint8_t value) {
+    uint8_t buf[2] = {address, value};
+    if(radio->bus != NULL){
+        // a write dropped by the bus (full queue in an interrupt handler) leaves the radio and the shadow unchanged
+        if(spi_bus_post(radio->bus, radio->csn, bus_priority(address), buf, 2)){
+            shadow_update(radio, address, &value, 1);
+        }
+        return;
+    }
+    cc2500_cs_select(radio);
+    spi_write_blocking(radio->spi, buf, 2);
+    cc2500_cs_deselect(radio);
+    shadow_update(radio, address, &value, 1);
+}
+
+void cc2500_write_registers(CC2500 *radio, const RF_setting *sets, uint8_t len) {
+    if(radio->bus != NULL){
+        // consecutive address/value pairs with one chip select, as many as fit into a transaction
+        uint8_t pairs[SPI_BUS_MAX_LEN];
+        for(uint8_t first = 0; first < len; first += SPI_BUS_MAX_LEN/2){
+            uint8_t count = min(len - first, SPI_BUS_MAX_LEN/2);
+            for(uint8_t i = 0; i < count; i++){
+                pairs[2*i]   = sets[first + i].address;
+                pairs[2*i+1] = sets[first + i].value;
+            }
+            if(!spi_bus_post(radio->bus, radio->csn, SPI_PRIO_CONFIG, pairs, 2*count)){
+                continue;
+            }
+            for(uint8_t i = 0; i < count; i++){
+                shadow_update(radio, sets[first + i].address, &sets[first + i].value, 1);
+            }
+        }
+        return;
+    }
+    uint8_t buf[2];
+    cc2500_cs_select(radio);
+    for (int i = 0; i < len; i++) {
+        buf[0] = sets[i].address;
+        buf[1] = sets[i].value;
+        spi_write_blocking(radio->spi, buf, 2);
+    }
+    cc2500_cs_deselect(radio);
+    for (int i = 0; i < len; i++) {
+        shadow_update(radio, sets[i].address, &sets[i].value, 1);
+    }
+}
+
+void cc2500_write_burst(CC2500 *radio, uint8_t address, const uint8_t *values, uint8_t len) {
+    uint8_t header = address | 0x40; // burst write
+    if(radio->bus != NULL){
+        uint8_t buf[SPI_BUS_MAX_LEN];
+        for(uint8_t offset = 0; offset < len; offset += SPI_BUS_MAX_LEN - 1){
+            uint8_t count = min(len - offset, SPI_BUS_MAX_LEN - 1);
+            buf[0] = bus_burst_address(address, offset) | 0x40;
+            memcpy(&buf[1], &values[offset], count);
+            if(spi_bus_post(radio->bus, radio->csn, bus_priority(address), buf, count + 1) && address < CC2500_CONFIG_REGISTERS){
+                shadow_update(radio, address + offset, &values[offset], count);
+            }
+        }
+        return;
+    }
+    cc2500_cs_select(radio);
+    spi_write_blocking(radio->spi, &header, 1);
+    spi_write_blocking(radio->spi, values, len);
+    cc2500_cs_deselect(radio);
+    if(address < CC2500_CONFIG_REGISTERS){
+        shadow_update(radio, address, values, len);
+    }
+}
+
+void cc2500_read_burst(CC2500 *radio, uint8_t address, uint8_t *values, uint8_t len) {
+    uint8_t header = address | 0xC0; // burst read
+    if(radio->bus != NULL){
+        uint8_t tx[SPI_BUS_MAX_LEN] = {0};
+        uint8_t rx[SPI_BUS_MAX_LEN];
+        for(uint8_t offset = 0; offset < len; offset += SPI_BUS_MAX_LEN - 1){
+            uint8_t count = min(len - offset, SPI_BUS_MAX_LEN - 1);
+            tx[0] = bus_burst_address(address, offset) | 0xC0;
+            spi_bus_transfer(radio->bus, radio->csn, bus_priority(address), tx, rx, count + 1);
+            memcpy(&values[offset], &rx[1], count);
+        }
+        if(address < CC2500_CONFIG_REGISTERS){
+            shadow_update(radio, address, values, len);
+        }
+        return;
+    }
+    cc2500_cs_select(radio);
+    spi_write_blocking(radio->spi, &header, 1);
+    spi_read_blocking(radio->spi, 0x00, values, len);
+    cc2500_cs_deselect(radio);
+    if(address < CC2500_CONFIG_REGISTERS){
+        shadow_update(radio, address, values, len);
+    }
+}
+
+uint8_t cc2500_read_register(CC2500 *radio, uint8_t address) {
+    if(address < CC2500_CONFIG_REGISTERS && (radio->shadow_valid & (1ull << address))){
+        return radio->shadow[address];
+    }
+    uint8_t buf[2] = {0, 0};
+    if(radio->bus != NULL){
+        uint8_t tx[2] = {address | 0x80, 0};
+        spi_bus_transfer(radio->bus, radio->csn, bus_priority(address), tx, buf, 2);
+    }else{
+        cc2500_cs_select(radio);
+        spi_read_blocking(radio->spi, address | 0x80, buf, 2);
+        cc2500_cs_deselect(radio);
+    }
+    if(address < CC2500_CONFIG_REGISTERS){
+        shadow_update(radio, address, &buf[1], 1);
+    }
+    return buf[1];
+}
+
+// status registers (0x30 - 0x3D) can only be accessed with the burst bit set
+uint8_t cc2500_read_status(CC2500 *radio, uint8_t address) {
+    uint8_t header = address | 0xC0;
+    uint8_t value;
+    if(radio->bus != NULL){
+        uint8_t tx[2] = {header, 0};
+        uint8_t rx[2];
+        spi_bus_transfer(radio->bus, radio->csn, SPI_PRIO_STROBE, tx, rx, 2);
+        return rx[1];
+    }
+    cc2500_cs_select(radio);
+    spi_write_blocking(radio->spi, &header, 1);
+    spi_read_blocking(radio->spi, 0x00, &value, 1);
+    cc2500_cs_deselect(radio);
+    return value;
+}
+
+// poll MARCSTATE until the radio reached IDLE (e.g. after SIDLE or a calibration which takes ~720us)
+bool cc2500_wait_idle(CC2500 *radio) {
+    absolute_time_t timeout = make_timeout_time_ms(2);
+    while((cc2500_read_status(radio, 0x35) & 0x1F) != 0x01){ // MARCSTATE == IDLE
+        if(time_reached(timeout)){
+            return false;
+        }
+    }
+    return true;
+}
+
+void cc2500_sync(CC2500 *radio) {
+    if(radio->bus != NULL){
+        spi_bus_sync(radio->bus, radio->csn);
+    }
+}
+
+void cc2500_reset(CC2500 *radio) {
+    cc2500_strobe(radio, 0x30); // SRES
+    cc2500_sync(radio);         // the delay starts after the (posted) strobe
+    sleep_us(100);
+    radio->shadow_valid = 0;
+}
+
+void cc2500_isr(uint gpio, uint32_t events) {
+    for(uint8_t i = 0; i < registered_count; i++){
+        CC2500 *radio = registered_radios[i];
+        if(radio->gdo0 != gpio){
+            continue;
+        }
+        event_t evt;
+        switch(events){
+            case GPIO_IRQ_EDGE_RISE:
+                trace_add(TRACE_GDO0_RISE, gpio);
+                evt = rx_assert_evt;
+                queue_try_add(&radio->event_queue, &evt);
+                break;
+            case GPIO_IRQ_EDGE_FALL:
+                trace_add(TRACE_GDO0_FALL, gpio);
+                evt = rx_deassert_evt;
+                queue_try_add(&radio->event_queue, &evt);
+                break;
+        }
+        if(event_handler != NULL){
+            event_handler(radio);
+        }
+    }
+}
+
+void cc2500_set_event_handler(cc2500_event_handler handler) {
+    event_handler = handler;
+}
+
+void cc2500_enable_events(CC2500 *radio) {
+    if(radio->gdo0 == CC2500_NO_PIN){
+        return;
+    }
+    if(!radio->events_ready){
+        queue_init(&radio->event_queue, sizeof(event_t), CC2500_EVENT_QUEUE_LENGTH);
+        radio->events_ready = true;
+        if(registered_count < CC2500_MAX_RADIOS){
+            registered_radios[registered_count++] = radio;
+        }
+    }
+    /* Reset the queue */
+    while(queue_try_remove(&radio->event_queue, NULL));
+
+    /* GDO0 setup as interrupt (one callback for all radios) */
+    gpio_set_irq_enabled_with_callback(radio->gdo0, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &cc2500_isr);
+}
+
+event_t cc2500_get_event(CC2500 *radio) {
+    event_t evt = no_evt;
+    if (radio->events_ready && queue_try_remove(&radio->event_queue, &evt))
+    {
+        return evt;
+    }
+    return no_evt;
+}
+
+// RX FIFO status and FIFO burst as two bus transactions (highest priority)
+static Packet_status bus_read_packet(CC2500 *radio, uint8_t *buffer) {
+    Packet_status status;
+    uint8_t tx[SPI_BUS_MAX_LEN];
+    uint8_t rx[SPI_BUS_MAX_LEN];
+    memset(tx, 0xFF, sizeof(tx));
+    tx[0] = 0xFB;
+    spi_bus_transfer(radio->bus, radio->csn, SPI_PRIO_FIFO, tx, rx, 2); // read RX FIFO status
+    status.overflowed = (bool) (rx[1] & 0x80);
+    if (!status.overflowed){
+        status.len = (rx[1] & 0x7F) - 2;
+        uint8_t count = min(min(status.len, 62), CC2500_FIFO_SIZE);
+        tx[0] = 0xFF;
+        spi_bus_transfer(radio->bus, radio->csn, SPI_PRIO_FIFO, tx, rx, count + 3); // header, packet, quality information
+        memcpy(buffer, &rx[1], count);
+        status.CRCcheck = (bool) (rx[count+2] & 0x80);
+        status.LinkQualityIndicator = (rx[count+2] & 0x7F);
+        if(rx[count+1] >= 128){
+            status.RSSI = (((int32_t) rx[count+1]) - 256)/2 - 70;
+        }else{
+            status.RSSI = ((int32_t) rx[count+1])/2 - 70;
+        }
+    }
+    return status;
+}
+
+Packet_status cc2500_read_packet(CC2500 *radio, uint8_t *buffer) {
+    if(radio->bus != NULL){
+        return bus_read_packet(radio, buffer);
+    }
+    Packet_status status;
+    uint8_t tmp_buffer[2];
+    // since the provided length of a packet might be corrupted, read length from fifo status
+    cc2500_cs_select(radio);
+    spi_read_blocking(radio->spi, 0xFB, tmp_buffer, 2);               // read RX FIFO status
+    cc2500_cs_deselect(radio);
+    status.overflowed = (bool) (tmp_buffer[1] & 0x80);
+    if (!status.overflowed){
+        status.len = (tmp_buffer[1] & 0x7F) - 2;
+        cc2500_cs_select(radio);
+        spi_read_blocking(radio->spi, 0xFF, tmp_buffer, 1);               // sart burst access to RX FIFO
+        spi_read_blocking(radio->spi, 0xFF, buffer, min(min(status.len, 62), CC2500_FIFO_SIZE));  // start reading from burst (max. 62 bytes of packet)
+        spi_read_blocking(radio->spi, 0xFF, tmp_buffer,  2);              // read quality information
+        cc2500_cs_deselect(radio);
+        status.CRCcheck = (bool) (tmp_buffer[1] & 0x80);
+        status.LinkQualityIndicator = (tmp_buffer[1] & 0x7F);
+        if(tmp_buffer[0] >= 128){
+            status.RSSI = (((int32_t) tmp_buffer[0]) - 256)/2 - 70;
+        }else{
+            status.RSSI = ((int32_t) tmp_buffer[0])/2 - 70;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,122 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Handle-based CC2500 driver: each radio is an instance with its own chip select, GDO0 pin,
+ * register shadow and event queue. Several radios can share one SPI bus.
+ *
+ * receiver_CC2500 and carrier_CC2500 provide the single-radio API (..._rx / ..._tx)
+ * on top of the default instances radio_rx and radio_carrier.
+ *
+ * With a bus (build option SPI_BUS, see spi_bus.h), the transactions are queued by priority instead:
+ * writes and strobes are posted (interrupt-safe), reads wait for their result.
+ *
+ */
+
+#ifndef CC2500_LIB
+#define CC2500_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/util/queue.h"
+#include "hardware/spi.h"
+#include "spi_bus.h"
+
+#define CC2500_MAX_RADIOS        4
+#define CC2500_CONFIG_REGISTERS  0x2F // 0x00 ... 0x2E
+#define CC2500_NO_PIN            0xFF
+#define CC2500_EVENT_QUEUE_LENGTH  20
+#define CC2500_FIFO_SIZE         64
+
+#ifndef RF_SETTING
+#define RF_SETTING
+struct rf_setting {
+  uint8_t address;
+  uint8_t  value;
+};
+typedef struct rf_setting RF_setting;
+#endif
+
+#ifndef PACKET_STATUS
+#define PACKET_STATUS
+struct packet_status {
+  bool overflowed;
+  uint8_t len;
+  int32_t RSSI;
+  bool CRCcheck;
+  uint8_t LinkQualityIndicator;
+};
+typedef struct packet_status Packet_status;
+
+/* Event queue */
+typedef enum _event_t{
+    no_evt          = 0,
+    rx_assert_evt   = 1,
+    rx_deassert_evt = 2
+} event_t;
+#endif
+
+struct cc2500 {
+  spi_inst_t *spi;
+  uint8_t     csn;
+  uint8_t     gdo0;                               // CC2500_NO_PIN: no interrupts (e.g. carrier)
+  const char *name;
+  struct spi_bus *bus;                            // NULL: blocking SPI transfers
+  // events of GDO0 (sync word received / end of packet)
+  queue_t     event_queue;
+  bool        events_ready;
+  // last written (or read) configuration registers, avoids SPI reads for read-modify-write
+  uint8_t     shadow[CC2500_CONFIG_REGISTERS];
+  uint64_t    shadow_valid;                       // bit i: shadow[i] is valid
+};
+typedef struct cc2500 CC2500;
+
+typedef void (*cc2500_event_handler)(CC2500 *radio);
+
+/* drive the chip select high (call after spi_init) */
+void cc2500_init_pins(CC2500 *radio);
+
+void cc2500_cs_select(CC2500 *radio);
+
+void cc2500_cs_deselect(CC2500 *radio);
+
+void cc2500_strobe(CC2500 *radio, uint8_t cmd);
+
+void cc2500_write_register(CC2500 *radio, uint8_t address, uint8_t value);
+
+void cc2500_write_registers(CC2500 *radio, const RF_setting *sets, uint8_t len);
+
+void cc2500_write_burst(CC2500 *radio, uint8_t address, const uint8_t *values, uint8_t len);
+
+void cc2500_read_burst(CC2500 *radio, uint8_t address, uint8_t *values, uint8_t len);
+
+/* configuration register (from the shadow if known) */
+uint8_t cc2500_read_register(CC2500 *radio, uint8_t address);
+
+/* status registers (0x30 - 0x3D) */
+uint8_t cc2500_read_status(CC2500 *radio, uint8_t address);
+
+/* poll MARCSTATE until IDLE is reached (max. 2ms) */
+bool cc2500_wait_idle(CC2500 *radio);
+
+/* wait until the posted writes and strobes have been sent (no-op without a bus) */
+void cc2500_sync(CC2500 *radio);
+
+/* SRES and forget the shadow */
+void cc2500_reset(CC2500 *radio);
+
+/* create the event queue and enable the GDO0 interrupts of this radio */
+void cc2500_enable_events(CC2500 *radio);
+
+event_t cc2500_get_event(CC2500 *radio);
+
+/* GPIO interrupt callback for all registered radios */
+void cc2500_isr(uint gpio, uint32_t events);
+
+/* called in the interrupt after an event has been queued (e.g. to release a scheduler task), NULL: none */
+void cc2500_set_event_handler(cc2500_event_handler handler);
+
+/* read a received packet from the RX FIFO (see readPacket) */
+Packet_status cc2500_read_packet(CC2500 *radio, uint8_t *buffer);
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Configuration planner (see config_planner.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "backscatter.h"
+#include "config_planner.h"
+
+void plan_request_init(struct plan_request *req, uint32_t center, uint32_t baud, bool two_antennas, uint8_t modulation) {
+    memset(req, 0, sizeof(struct plan_request));
+    req->center        = center;
+    req->baud          = baud;
+    req->max_deviation = PLAN_CC2500_MAX_DEVIATION;
+    req->max_rx_bw     = PLAN_CC2500_MAX_RX_BW;
+    req->min_div       = PLAN_MIN_DIV;
+    req->max_div       = PLAN_MAX_DIV;
+    req->two_antennas  = two_antennas;
+    req->modulation    = modulation;
+}
+
+bool plan_add_occupied(struct plan_request *req, int32_t center, uint32_t bw) {
+    if(req->occupied_count >= PLAN_MAX_OCCUPIED){
+        return false;
+    }
+    req->occupied[req->occupied_count]    = center;
+    req->occupied_bw[req->occupied_count] = bw;
+    req->occupied_count++;
+    return true;
+}
+
+static bool overlaps(int64_t low, int64_t high, int64_t center, int64_t bw) {
+    return low < center + bw/2 && high > center - bw/2;
+}
+
+/*
+ * side of harmonic n relative to the used sideband: +1 used side, -1 mirror side, 0 both (double-sideband)
+ */
+static int8_t harmonic_side(uint8_t modulation, uint8_t n) {
+    if(modulation < 2){
+        return 0;
+    }
+    return (n % 4 == 1) ? 1 : -1;
+}
+
+// collisions of all components with the occupied channels, the own receiver channel and the carrier guard
+static uint32_t collision_penalty(const struct plan_request *req, const struct plan_result *r, uint8_t *collisions) {
+    int8_t   used_side = (req->modulation == 3) ? -1 : 1;
+    int64_t  own       = used_side * (int64_t) r->center;
+    uint32_t penalty   = 0;
+    for(uint8_t n = 1; n <= PLAN_HARMONICS; n += 2){
+        int64_t low  = (int64_t) n * (CLKFREQ*1000000/r->d0) - r->baud/2;
+        int64_t high = (int64_t) n * (CLKFREQ*1000000/r->d1) + r->baud/2;
+        for(int8_t side = -1; side <= 1; side += 2){
+            int8_t harmonic = harmonic_side(req->modulation, n);
+            if(harmonic != 0 && side != harmonic * used_side){
+                continue;
+            }
+            int64_t band_low  = (side > 0) ? low : -high;
+            int64_t band_high = (side > 0) ? high : -low;
+            bool main_tones   = (n == 1 && side == used_side);
+            uint8_t hits = 0;
+            if(!main_tones && overlaps(band_low, band_high, own, r->rx_bw)){
+                hits++;
+            }
+            if(overlaps(band_low, band_high, 0, 2*PLAN_CARRIER_GUARD)){
+                hits++;
+            }
+            for(uint8_t i = 0; i < req->occupied_count; i++){
+                if(overlaps(band_low, band_high, req->occupied[i], (req->occupied_bw[i] > 0) ? req->occupied_bw[i] : r->rx_bw)){
+                    hits++;
+                }
+            }
+            *collisions += hits;
+            penalty     += hits * (PLAN_COLLISION_PENALTY / n);
+        }
+    }
+    return penalty;
+}
+
+bool plan_evaluate(const struct plan_request *req, uint16_t d0, uint16_t d1, struct plan_result *result) {
+    memset(result, 0, sizeof(struct plan_result));
+    result->d0           = d0;
+    result->d1           = d1;
+    result->baud         = achievable_baud(req->baud);
+    result->instructions = backscatter_program_length(d0, d1, result->baud, req->two_antennas, req->modulation >= 1, req->modulation >= 2);
+    result->center       = (CLKFREQ*1000000/d0 + CLKFREQ*1000000/d1)/2;
+    result->deviation    = subcarrier_deviation(d0, d1);
+    result->rx_bw        = result->baud + 2*result->deviation;
+    if(result->instructions == 0 || result->deviation > req->max_deviation || result->rx_bw > req->max_rx_bw){
+        return false;
+    }
+    uint32_t center_error = (result->center > req->center) ? result->center - req->center : req->center - result->center;
+    uint32_t baud_error   = (result->baud > req->baud) ? result->baud - req->baud : req->baud - result->baud;
+    result->score  = center_error / 1000;
+    result->score += (uint32_t) ((uint64_t) baud_error * 1000 / req->baud);
+    result->score += result->instructions / 4;
+    if(2*result->deviation < result->baud/2){
+        result->score += PLAN_LOW_INDEX_PENALTY;
+    }
+    result->score += collision_penalty(req, result, &result->collisions);
+    return true;
+}
+
+uint8_t plan_configurations(const struct plan_request *req, struct plan_result *results, uint8_t max_results) {
+    uint8_t count = 0;
+    uint16_t first = req->min_div + (req->min_div % 2);
+    for(uint16_t d1 = first; d1 <= req->max_div; d1 += 2){
+        for(uint16_t d0 = d1 + 2; d0 <= req->max_div; d0 += 2){
+            struct plan_result candidate;
+            if(!plan_evaluate(req, d0, d1, &candidate)){
+                continue;
+            }
+            // insert into the sorted results (equal scores keep the search order: smaller dividers first)
+            uint8_t position = count;
+            while(position > 0 && results[position-1].score > candidate.score){
+                position--;
+            }
+            if(position >= max_results){
+                continue;
+            }
+            uint8_t last = min(count, max_results - 1);
+            memmove(&results[position+1], &results[position], (last - position) * sizeof(struct plan_result));
+            results[position] = candidate;
+            count = min(count + 1, max_results);
+        }
+    }
+    return count;
+}
+
+void plan_print(const struct plan_request *req, const struct plan_result *results, uint8_t count) {
+    static const char *modulations[] = {"restarting", "phase-continuous", "SSB upper", "SSB lower"};
+    printf("plan | target center %u Hz baud %u | %s | %u occupied channels\n", req->center, req->baud, modulations[min(req->modulation, 3)], req->occupied_count);
+    printf("plan | rank  d0  d1   baud |  center[Hz] dev[Hz] rxbw[Hz] | instr | collisions | score\n");
+    for(uint8_t i = 0; i < count; i++){
+        const struct plan_result *r = &results[i];
+        printf("plan | %4u %3u %3u %6u | %11u %7u %8u | %5u | %10u | %5u\n", i+1, r->d0, r->d1, r->baud,
+               r->center, r->deviation, r->rx_bw, r->instructions, r->collisions, r->score);
+    }
+    if(count == 0){
+        printf("plan | no configuration satisfies the receiver limits\n");
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Configuration planner: searches all even divider pairs d0 > d1 for a target subcarrier center offset and
+ * baud-rate and returns the best configurations, ranked by a score (lower is better):
+ * - quantisation: distance of the center offset from the target (1 point per kHz) and of the achievable
+ *   baud-rate from the requested one (1 point per 0.1 %)
+ * - instruction fit: the program has to fit into the 32 instructions (rejected otherwise), 1 point per 4 instructions
+ * - receiver limits: deviation and minimal RX filter bandwidth (rejected if exceeded), modulation index
+ *   2*deviation/baud below 0.5 (PLAN_LOW_INDEX_PENALTY)
+ * - collisions: the square wave subcarrier has odd harmonics (n = 1, 3, 5, 7, amplitude 1/n) on both sides of the
+ *   carrier, the mirror image (n = 1 on the other side) included. Every component band (n times both tones plus
+ *   half the baud-rate) which overlaps an occupied channel, the own receiver channel or the carrier guard costs
+ *   PLAN_COLLISION_PENALTY/n points. With single-sideband, the harmonics n = 4m+1 stay on the used side and
+ *   n = 4m+3 appear on the mirror side (I/Q square waves), the mirror image of n = 1 is cancelled.
+ *
+ * carrier-receiver-baseband/config-planner.py searches the same space on the host (in parallel, wider ranges).
+ *
+ */
+
+#ifndef CONFIG_PLANNER_LIB
+#define CONFIG_PLANNER_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#define PLAN_MAX_OCCUPIED          4
+#define PLAN_MAX_RESULTS           5
+#define PLAN_HARMONICS             7 // highest odd harmonic which is checked
+#define PLAN_MIN_DIV               4
+#define PLAN_MAX_DIV              80
+#define PLAN_CARRIER_GUARD   1000000 // [Hz] the channel keeps this distance from the carrier (phase noise, leakage)
+#define PLAN_COLLISION_PENALTY   700 // points for a collision of the main tones (divided by the harmonic number)
+#define PLAN_LOW_INDEX_PENALTY    50
+#define PLAN_CC2500_MAX_DEVIATION   380000
+#define PLAN_CC2500_MAX_RX_BW       812500
+
+struct plan_request {
+  uint32_t center;                          // target subcarrier center offset [Hz]
+  uint32_t baud;
+  uint32_t max_deviation;                   // receiver limits
+  uint32_t max_rx_bw;
+  uint16_t min_div, max_div;
+  bool     two_antennas;
+  uint8_t  modulation;                      // 0 restarting, 1 phase-continuous, 2/3 single-sideband upper/lower
+  uint8_t  occupied_count;
+  int32_t  occupied[PLAN_MAX_OCCUPIED];     // channel centers relative to the carrier [Hz], negative: below
+  uint32_t occupied_bw[PLAN_MAX_OCCUPIED];  // 0: the RX bandwidth of the candidate
+};
+
+struct plan_result {
+  uint16_t d0, d1;
+  uint32_t baud;             // achievable
+  uint32_t center;
+  uint32_t deviation;
+  uint32_t rx_bw;
+  uint8_t  instructions;
+  uint8_t  collisions;
+  uint32_t score;
+};
+
+/* request with the defaults (CC2500 limits, PLAN_MIN_DIV ... PLAN_MAX_DIV, no occupied channels) */
+void plan_request_init(struct plan_request *req, uint32_t center, uint32_t baud, bool two_antennas, uint8_t modulation);
+
+/* add an occupied channel (bw 0: as wide as the own channel), false if the list is full */
+bool plan_add_occupied(struct plan_request *req, int32_t center, uint32_t bw);
+
+/* score one configuration, false if it is rejected (program, receiver limits) */
+bool plan_evaluate(const struct plan_request *req, uint16_t d0, uint16_t d1, struct plan_result *result);
+
+/* search all even divider pairs, results sorted by score (at most max_results), returns their number */
+uint8_t plan_configurations(const struct plan_request *req, struct plan_result *results, uint8_t max_results);
+
+/* print "plan | ..." (one row per result, apply with b d0 d1 baud) */
+void plan_print(const struct plan_request *req, const struct plan_result *results, uint8_t count);
+
+#endif
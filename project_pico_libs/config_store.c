@@ -0,0 +1,84 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Persisted configuration (see config_store.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "packet_generation.h"
+#include "config_store.h"
+
+// the sector is read through the XIP window
+static const struct config_store_header *stored_header() {
+    return (const struct config_store_header *) (XIP_BASE + CONFIG_STORE_OFFSET);
+}
+
+static const uint8_t *stored_record() {
+    return (const uint8_t *) (XIP_BASE + CONFIG_STORE_OFFSET + sizeof(struct config_store_header));
+}
+
+static bool stored_valid(uint16_t length, uint16_t version) {
+    const struct config_store_header *header = stored_header();
+    return header->magic == CONFIG_STORE_MAGIC && header->version == version && header->length == length &&
+           length <= CONFIG_STORE_MAX_LENGTH && header->crc == packet_crc16(stored_record(), length);
+}
+
+bool config_store_load(void *data, uint16_t length, uint16_t version) {
+    if(!stored_valid(length, version)){
+        return false;
+    }
+    memcpy(data, stored_record(), length);
+    return true;
+}
+
+uint32_t config_store_writes() {
+    return (stored_header()->magic == CONFIG_STORE_MAGIC) ? stored_header()->writes : 0;
+}
+
+// erase (and program) the sector: no code may run from flash meanwhile
+static void flash_write(const uint8_t *page, bool lockout_core1) {
+    if(lockout_core1){
+        multicore_lockout_start_blocking();
+    }
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(CONFIG_STORE_OFFSET, FLASH_SECTOR_SIZE);
+    if(page != NULL){
+        flash_range_program(CONFIG_STORE_OFFSET, page, FLASH_PAGE_SIZE);
+    }
+    restore_interrupts(interrupts);
+    if(lockout_core1){
+        multicore_lockout_end_blocking();
+    }
+}
+
+bool config_store_save(const void *data, uint16_t length, uint16_t version, bool lockout_core1) {
+    if(length > CONFIG_STORE_MAX_LENGTH){
+        return false;
+    }
+    if(stored_valid(length, version) && memcmp(stored_record(), data, length) == 0){
+        return true;
+    }
+    static uint8_t page[FLASH_PAGE_SIZE];
+    struct config_store_header header = {
+        .magic   = CONFIG_STORE_MAGIC,
+        .version = version,
+        .length  = length,
+        .crc     = packet_crc16(data, length),
+        .writes  = config_store_writes() + 1,
+    };
+    memset(page, 0xFF, FLASH_PAGE_SIZE);
+    memcpy(page, &header, sizeof(struct config_store_header));
+    memcpy(&page[sizeof(struct config_store_header)], data, length);
+    flash_write(page, lockout_core1);
+    return true;
+}
+
+void config_store_erase(bool lockout_core1) {
+    flash_write(NULL, lockout_core1);
+}
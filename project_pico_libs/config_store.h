@@ -0,0 +1,47 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Persisted configuration in the last flash sector: one record (header + up to CONFIG_STORE_MAX_LENGTH byte)
+ * in the first page of the sector. A record is only used at boot if its magic, version, length and CRC match,
+ * a firmware with a changed record layout (version) therefore starts from its defaults.
+ *
+ * Writing erases the sector (~50 ms with interrupts disabled). The other core must not execute from flash
+ * meanwhile: if it runs, it has to call multicore_lockout_victim_init() and lockout_core1 has to be set.
+ * Unchanged records are not written again (flash endurance).
+ *
+ */
+
+#ifndef CONFIG_STORE_LIB
+#define CONFIG_STORE_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+
+#define CONFIG_STORE_MAGIC       0x43504242 // "BBPC"
+#define CONFIG_STORE_OFFSET      (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define CONFIG_STORE_MAX_LENGTH  (FLASH_PAGE_SIZE - sizeof(struct config_store_header))
+
+struct config_store_header {
+  uint32_t magic;
+  uint16_t version;   // layout of the record (defined by the application)
+  uint16_t length;
+  uint16_t crc;       // packet_crc16 of the record
+  uint16_t reserved;
+  uint32_t writes;    // number of saved records (diagnostics)
+};
+
+/* copy a valid record of this version and length to data, false if there is none */
+bool config_store_load(void *data, uint16_t length, uint16_t version);
+
+/* write the record (skipped if unchanged), returns false if the record is too long */
+bool config_store_save(const void *data, uint16_t length, uint16_t version, bool lockout_core1);
+
+/* remove the record (the next boot uses the defaults) */
+void config_store_erase(bool lockout_core1);
+
+/* number of writes of the stored record (0 if there is none) */
+uint32_t config_store_writes();
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * receive diversity combining of several CC2500 receivers
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "cc2500.h"
+#include "receiver_CC2500.h"
+#include "diversity.h"
+
+void diversity_init(struct diversity_combiner *comb, CC2500 **radios, uint8_t count, bool afc_enabled){
+    memset(comb, 0, sizeof(struct diversity_combiner));
+    comb->count = min(count, DIVERSITY_MAX_RADIOS);
+    for(uint8_t i = 0; i < comb->count; i++){
+        comb->radios[i] = radios[i];
+        cc2500_afc_init(&comb->afc[i], radios[i], afc_enabled);
+    }
+}
+
+void diversity_start_listen(struct diversity_combiner *comb){
+    for(uint8_t i = 0; i < comb->count; i++){
+        cc2500_start_listen(comb->radios[i]);
+    }
+    printf("> Started listening (%u receivers).\n", comb->count);
+}
+
+void diversity_stop_listen(struct diversity_combiner *comb){
+    for(uint8_t i = 0; i < comb->count; i++){
+        cc2500_stop_listen(comb->radios[i]);
+    }
+    printf("> Stopped receivers.\n");
+}
+
+// is copy a better than copy b?
+static bool better_copy(Packet_status a, Packet_status b){
+    if(a.overflowed != b.overflowed){
+        return !a.overflowed;
+    }
+    if(a.CRCcheck != b.CRCcheck){
+        return a.CRCcheck;
+    }
+    return a.RSSI > b.RSSI;
+}
+
+static bool same_frame(struct diversity_frame *pending, const uint8_t *buffer, Packet_status status, uint64_t time_us){
+    if(time_us - pending->time_us > DIVERSITY_WINDOW_US){
+        return false;
+    }
+    if(pending->status.CRCcheck && !pending->status.overflowed && status.CRCcheck && !status.overflowed){
+        return pending->buffer[1] == buffer[1]; // sequence number
+    }
+    return true;
+}
+
+static void release(struct diversity_combiner *comb, struct diversity_frame *frame){
+    *frame = comb->pending;
+    comb->pending.valid = false;
+    comb->frames++;
+    comb->selected[frame->radio]++;
+    if(!frame->primary_ok && frame->status.CRCcheck && !frame->status.overflowed){
+        comb->rescued++;
+    }
+}
+
+bool diversity_poll(struct diversity_combiner *comb, struct diversity_frame *frame, uint64_t time_us){
+    bool released = false;
+    for(uint8_t i = 0; i < comb->count; i++){
+        if(cc2500_get_event(comb->radios[i]) != rx_deassert_evt){
+            continue;
+        }
+        // finished receiving: read the copy and listen again
+        uint8_t buffer[RX_BUFFER_SIZE];
+        Packet_status status = cc2500_read_packet(comb->radios[i], buffer);
+        afc_update_rx(&comb->afc[i], status);
+        cc2500_start_listen(comb->radios[i]);
+        comb->received[i]++;
+        if(status.CRCcheck && !status.overflowed){
+            comb->crc_pass[i]++;
+        }
+
+        if(comb->pending.valid && !same_frame(&comb->pending, buffer, status, time_us)){
+            // a new frame started: forward the previous one (only one frame is returned per call)
+            if(!released){
+                release(comb, frame);
+                released = true;
+            }else{
+                comb->pending.valid = false; // cannot happen with DIVERSITY_WINDOW_US << packet interval
+            }
+        }
+        if(!comb->pending.valid){
+            comb->pending.valid      = true;
+            comb->pending.primary_ok = false;
+            comb->pending.copies  = 1;
+            comb->pending.radio   = i;
+            comb->pending.status  = status;
+            comb->pending.time_us = time_us;
+            memcpy(comb->pending.buffer, buffer, RX_BUFFER_SIZE);
+        }else{
+            comb->pending.copies++;
+            if(better_copy(status, comb->pending.status)){
+                comb->pending.radio  = i;
+                comb->pending.status = status;
+                memcpy(comb->pending.buffer, buffer, RX_BUFFER_SIZE);
+            }
+        }
+        if(i == 0 && status.CRCcheck && !status.overflowed){
+            comb->pending.primary_ok = true;
+        }
+    }
+    // complete: all receivers delivered a copy or the window elapsed
+    if(!released && comb->pending.valid && (comb->pending.copies >= comb->count || time_us - comb->pending.time_us > DIVERSITY_WINDOW_US)){
+        release(comb, frame);
+        released = true;
+    }
+    return released;
+}
+
+void diversity_report(struct diversity_combiner *comb){
+    printf("diversity | frames %u | rescued by other receivers %u\n", comb->frames, comb->rescued);
+    for(uint8_t i = 0; i < comb->count; i++){
+        printf("diversity | %s | copies %u crc-pass %u selected %u\n", comb->radios[i]->name, comb->received[i], comb->crc_pass[i], comb->selected[i]);
+        afc_print_rx(&comb->afc[i]);
+    }
+}
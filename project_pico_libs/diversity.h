@@ -0,0 +1,62 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * receive diversity: several CC2500 receivers (e.g. separate antennas) listen to the same tag.
+ * The copies of a frame are merged and only the best copy is forwarded:
+ * - copies belong to the same frame if they arrive within DIVERSITY_WINDOW_US of the first copy
+ *   and, if both passed the CRC check, carry the same sequence number
+ * - a CRC-valid copy is preferred over a corrupted one, then the higher RSSI wins
+ *
+ */
+
+#ifndef DIVERSITY_LIB
+#define DIVERSITY_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "cc2500.h"
+#include "receiver_CC2500.h"
+
+#define DIVERSITY_MAX_RADIOS   CC2500_MAX_RADIOS
+#define DIVERSITY_WINDOW_US    1000 // copies of one frame end within the SPI read time of the other receivers
+
+struct diversity_frame {
+  bool          valid;
+  uint8_t       radio;                   // index of the receiver which provided this copy
+  uint8_t       copies;                  // received copies of this frame
+  bool          primary_ok;              // the first receiver obtained a CRC-valid copy
+  Packet_status status;
+  uint64_t      time_us;                 // arrival of the first copy
+  uint8_t       buffer[RX_BUFFER_SIZE];
+};
+
+struct diversity_combiner {
+  uint8_t  count;
+  CC2500  *radios[DIVERSITY_MAX_RADIOS];
+  struct afc_state afc[DIVERSITY_MAX_RADIOS];
+  struct diversity_frame pending;
+  // statistics
+  uint32_t frames;                           // combined frames
+  uint32_t received[DIVERSITY_MAX_RADIOS];   // copies per receiver
+  uint32_t crc_pass[DIVERSITY_MAX_RADIOS];   // CRC-valid copies per receiver
+  uint32_t selected[DIVERSITY_MAX_RADIOS];   // forwarded copies per receiver
+  uint32_t rescued;                          // CRC-valid frames for which the first receiver failed
+};
+
+/* radios must have been set up (cc2500_setup_receiver) and configured */
+void diversity_init(struct diversity_combiner *comb, CC2500 **radios, uint8_t count, bool afc_enabled);
+
+void diversity_start_listen(struct diversity_combiner *comb);
+
+void diversity_stop_listen(struct diversity_combiner *comb);
+
+/*
+ * handle the events of all receivers (read packets and restart listening)
+ * returns true if a combined frame is complete, which is then copied to frame
+ */
+bool diversity_poll(struct diversity_combiner *comb, struct diversity_frame *frame, uint64_t time_us);
+
+void diversity_report(struct diversity_combiner *comb);
+
+#endif
@@ -0,0 +1,186 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * incremental link statistics computed on the receiving Pico
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "link_stats.h"
+
+static void moments_reset(struct running_moments *m){
+    memset(m, 0, sizeof(struct running_moments));
+}
+
+static void moments_add(struct running_moments *m, int32_t value){
+    if(m->count == 0){
+        m->min = value;
+        m->max = value;
+    }
+    m->count++;
+    m->sum    += value;
+    m->sum_sq += (uint64_t) ((int64_t) value * value);
+    m->min = min(m->min, value);
+    m->max = max(m->max, value);
+}
+
+static uint32_t isqrt64(uint64_t x){
+    uint64_t root = 0;
+    uint64_t bit  = (uint64_t) 1 << 62;
+    while(bit > x){
+        bit >>= 2;
+    }
+    while(bit != 0){
+        if(x >= root + bit){
+            x    -= root + bit;
+            root  = (root >> 1) + bit;
+        }else{
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) root;
+}
+
+// print "mean std" with one decimal (fixed point, no soft-float)
+static void moments_print(const char *name, struct running_moments *m){
+    if(m->count == 0){
+        printf("%s - ", name);
+        return;
+    }
+    int64_t  mean10   = (m->sum * 10) / (int64_t) m->count;
+    uint64_t var100;
+    if(m->sum_sq < UINT64_MAX / 100){
+        var100 = (m->sum_sq * 100) / m->count - (uint64_t) (mean10 * mean10);
+    }else{
+        var100 = (m->sum_sq / m->count) * 100 - min((m->sum_sq / m->count) * 100, (uint64_t) (mean10 * mean10));
+    }
+    uint32_t std10    = isqrt64(var100);
+    int64_t  mean_abs = (mean10 < 0) ? -mean10 : mean10;
+    printf("%s mean %s%lld.%lld std %u.%u min %d max %d ", name, (mean10 < 0) ? "-" : "", mean_abs / 10, mean_abs % 10, std10 / 10, std10 % 10, m->min, m->max);
+}
+
+// ratio in percent with two decimals
+static void percent_print(const char *name, uint32_t numerator, uint32_t denominator){
+    if(denominator == 0){
+        printf("%s - ", name);
+        return;
+    }
+    uint32_t p = (uint32_t) (((uint64_t) numerator * 10000) / denominator);
+    printf("%s %u.%02u%% ", name, p / 100, p % 100);
+}
+
+static void counters_print(struct link_counters *c){
+    // expected frames: transmitted frames if known, otherwise valid frames and sequence gaps
+    uint32_t expected = (c->sent > 0) ? c->sent : (c->crc_pass + c->lost);
+    uint32_t errors   = (c->sent > 0) ? (c->sent - min(c->sent, c->crc_pass)) : c->lost;
+    printf("frames %u crc-pass %u crc-error %u overflow %u lost %u duplicate %u ", c->received, c->crc_pass, c->crc_error, c->overflowed, c->lost, c->duplicates);
+    if(c->sent > 0){
+        printf("sent %u ", c->sent);
+    }
+    percent_print("| PER", errors, expected);
+    percent_print("| CRC pass", c->crc_pass, c->received);
+    printf("\n");
+}
+
+void link_stats_init(struct link_stats *stats, uint64_t time_us){
+    memset(stats, 0, sizeof(struct link_stats));
+    moments_reset(&stats->rssi);
+    moments_reset(&stats->lqi);
+    moments_reset(&stats->inter_arrival);
+    stats->window_start_us = time_us;
+}
+
+void link_stats_add(struct link_stats *stats, const uint8_t *packet, Packet_status status, uint64_t time_us){
+    struct link_counters *counters[2] = {&stats->total, &stats->window};
+    for(uint8_t i = 0; i < 2; i++){
+        counters[i]->received++;
+    }
+
+    // inter-arrival time
+    if(stats->last_arrival_us != 0){
+        moments_add(&stats->inter_arrival, (int32_t) (time_us - stats->last_arrival_us));
+    }
+    stats->last_arrival_us = time_us;
+
+    if(status.overflowed){
+        for(uint8_t i = 0; i < 2; i++){
+            counters[i]->overflowed++;
+            counters[i]->crc_error++;
+        }
+        return;
+    }
+
+    // link quality (also for frames with CRC error)
+    int32_t rssi_bin = (status.RSSI - RSSI_HIST_MIN) / RSSI_HIST_STEP;
+    stats->rssi_hist[max(0, min(rssi_bin, RSSI_HIST_BINS-1))]++;
+    stats->lqi_hist[min(status.LinkQualityIndicator / LQI_HIST_STEP, LQI_HIST_BINS-1)]++;
+    moments_add(&stats->rssi, status.RSSI);
+    moments_add(&stats->lqi, status.LinkQualityIndicator);
+
+    if(!status.CRCcheck){
+        for(uint8_t i = 0; i < 2; i++){
+            counters[i]->crc_error++;
+        }
+        return;
+    }
+    for(uint8_t i = 0; i < 2; i++){
+        counters[i]->crc_pass++;
+    }
+
+    // sequence number gaps (corrupted frames inbetween are counted as lost)
+    uint8_t seq = packet[1];
+    if(stats->seq_valid){
+        uint8_t gap = seq - stats->last_seq;
+        if(gap == 0){
+            for(uint8_t i = 0; i < 2; i++){
+                counters[i]->duplicates++;
+            }
+        }else if(gap < LINK_STATS_MAX_GAP){
+            for(uint8_t i = 0; i < 2; i++){
+                counters[i]->lost += gap - 1;
+            }
+        }
+    }
+    stats->last_seq  = seq;
+    stats->seq_valid = true;
+}
+
+void link_stats_sent(struct link_stats *stats){
+    stats->total.sent++;
+    stats->window.sent++;
+}
+
+bool link_stats_window_elapsed(struct link_stats *stats, uint64_t time_us, uint32_t interval_ms){
+    return (time_us - stats->window_start_us) >= ((uint64_t) interval_ms * 1000);
+}
+
+void link_stats_report(struct link_stats *stats, uint64_t time_us){
+    uint32_t window_ms = (uint32_t) ((time_us - stats->window_start_us) / 1000);
+    printf("stats | window %u ms | ", window_ms);
+    counters_print(&stats->window);
+    printf("stats | total | ");
+    counters_print(&stats->total);
+    printf("stats | ");
+    moments_print("RSSI [dBm]", &stats->rssi);
+    printf("| ");
+    moments_print("LQI", &stats->lqi);
+    printf("| ");
+    moments_print("inter-arrival [us]", &stats->inter_arrival);
+    printf("\nstats | RSSI histogram [%d dBm, +%d dBm]:", RSSI_HIST_MIN, RSSI_HIST_STEP);
+    for(uint8_t i = 0; i < RSSI_HIST_BINS; i++){
+        printf(" %u", stats->rssi_hist[i]);
+    }
+    printf("\nstats | LQI histogram [0, +%d]:", LQI_HIST_STEP);
+    for(uint8_t i = 0; i < LQI_HIST_BINS; i++){
+        printf(" %u", stats->lqi_hist[i]);
+    }
+    printf("\n");
+
+    // start a new window
+    memset(&stats->window, 0, sizeof(struct link_counters));
+    stats->window_start_us = time_us;
+}
@@ -0,0 +1,83 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * incremental link statistics computed on the receiving Pico
+ * (the same metrics as stats/statistics.ipynb without streaming every frame over USB)
+ *
+ * - PER per window: from sequence number gaps between CRC-valid frames,
+ *   or from the number of transmitted frames if the board is also the transmitter (link_stats_sent)
+ * - CRC pass rate
+ * - RSSI/LQI histograms with running mean and variance
+ * - packet inter-arrival statistics
+ *
+ */
+
+#ifndef LINK_STATS_LIB
+#define LINK_STATS_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+
+#define RSSI_HIST_MIN        -110 // dBm, lower edge of the first bin
+#define RSSI_HIST_STEP          5 // dBm
+#define RSSI_HIST_BINS         20 // -110 ... -10 dBm
+#define LQI_HIST_STEP           8
+#define LQI_HIST_BINS          16 // 0 ... 127
+#define LINK_STATS_MAX_GAP    128 // larger sequence number jumps are considered a restart of the transmitter
+
+/* running sums: mean = sum/n, variance = sum_sq/n - mean^2 */
+struct running_moments {
+  uint32_t count;
+  int64_t  sum;
+  uint64_t sum_sq;
+  int32_t  min;
+  int32_t  max;
+};
+
+struct link_counters {
+  uint32_t received;   // frames read from the FIFO (incl. CRC errors)
+  uint32_t crc_pass;
+  uint32_t crc_error;
+  uint32_t overflowed;
+  uint32_t lost;       // missing or corrupted frames obtained from sequence number gaps
+  uint32_t duplicates;
+  uint32_t sent;       // transmitted frames (only if known, see link_stats_sent)
+};
+
+struct link_stats {
+  struct link_counters total;
+  struct link_counters window;
+  uint64_t window_start_us;
+  // sequence number tracking (CRC-valid frames only)
+  bool     seq_valid;
+  uint8_t  last_seq;
+  // link quality
+  uint32_t rssi_hist[RSSI_HIST_BINS];
+  uint32_t lqi_hist[LQI_HIST_BINS];
+  struct running_moments rssi;
+  struct running_moments lqi;
+  // packet inter-arrival time [us]
+  uint64_t last_arrival_us;
+  struct running_moments inter_arrival;
+};
+
+void link_stats_init(struct link_stats *stats, uint64_t time_us);
+
+/*
+ * add the result of readPacket()
+ * packet[0]: length field, packet[1]: sequence number
+ */
+void link_stats_add(struct link_stats *stats, const uint8_t *packet, Packet_status status, uint64_t time_us);
+
+/* count a transmitted frame (only used by boards which are transmitter and receiver) */
+void link_stats_sent(struct link_stats *stats);
+
+/* has the current window been running for at least interval_ms? */
+bool link_stats_window_elapsed(struct link_stats *stats, uint64_t time_us, uint32_t interval_ms);
+
+/* print the current window and the totals, then start a new window */
+void link_stats_report(struct link_stats *stats, uint64_t time_us);
+
+#endif
@@ -0,0 +1,153 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Low-power operation between frames (see low_power.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/sync.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/scb.h"
+#include "low_power.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#define XOSC_HZ (12 * MHZ)
+
+static const char *mode_names[] = {"off", "sleep", "sleep-pll-off"};
+
+static volatile bool woken = false;
+
+static int64_t wake_callback(alarm_id_t id, void *user_data) {
+    woken = true;
+    return 0;
+}
+
+void low_power_init(struct low_power *lp, enum low_power_mode mode, bool keep_usb) {
+    memset(lp, 0, sizeof(struct low_power));
+    lp->mode     = mode;
+    lp->keep_usb = keep_usb;
+    clock_stop(clk_adc);
+    clock_stop(clk_rtc);
+    if(!keep_usb){
+        clock_stop(clk_usb);
+        pll_deinit(pll_usb);
+    }
+    // during deep sleep only the timer (and USB: answers the host and wakes the core with its interrupts) is clocked
+    clocks_hw->sleep_en0 = 0;
+    clocks_hw->sleep_en1 = CLOCKS_SLEEP_EN1_CLK_SYS_TIMER_BITS;
+    if(keep_usb){
+        clocks_hw->sleep_en1 |= CLOCKS_SLEEP_EN1_CLK_SYS_USBCTRL_BITS | CLOCKS_SLEEP_EN1_CLK_USB_USBCTRL_BITS;
+    }
+    lp->active_start_us = time_us_64();
+}
+
+// glitch-free switch to the crystal (clk_ref), the timer ticks from clk_ref and is not affected
+static void system_clock_crystal() {
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF, 0, XOSC_HZ, XOSC_HZ);
+    pll_deinit(pll_sys);
+}
+
+// SDK default: 12 MHz * 125 / 6 / 2 = 125 MHz
+static void system_clock_pll() {
+    pll_init(pll_sys, 1, 1500 * MHZ, 6, 2);
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX, CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS,
+                    125 * MHZ, 125 * MHZ);
+}
+
+/*
+ * The flag is checked with interrupts disabled: __wfi also returns for an interrupt which is pending but masked,
+ * an alarm firing between the check and __wfi therefore cannot be missed. It is served after restore_interrupts.
+ */
+static void deep_sleep(bool pll_off) {
+    if(pll_off){
+        system_clock_crystal();
+    }
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+    uint32_t interrupts = save_and_disable_interrupts();
+    while(!woken){
+        __wfi();
+        restore_interrupts(interrupts);
+        interrupts = save_and_disable_interrupts();
+    }
+    restore_interrupts(interrupts);
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+    if(pll_off){
+        system_clock_pll();
+    }
+}
+
+void low_power_sleep_until(struct low_power *lp, absolute_time_t wake) {
+    uint64_t start_us = time_us_64();
+    lp->stats.active_us += start_us - lp->active_start_us;
+    lp->wake_us = to_us_since_boot(wake);
+    if(lp->mode == LOW_POWER_OFF){
+        sleep_until(wake);
+    }else{
+        woken = false;
+        if(add_alarm_at(wake, wake_callback, NULL, false) > 0){ // 0: already past
+            deep_sleep(lp->mode == LOW_POWER_SLEEP_PLL_OFF);
+        }
+    }
+    if(start_us >= lp->wake_us){
+        lp->stats.late++;
+    }
+    lp->active_start_us = time_us_64();
+    lp->stats.sleeps++;
+    lp->stats.sleep_us += lp->active_start_us - start_us;
+}
+
+void low_power_first_symbol(struct low_power *lp) {
+    uint64_t now = time_us_64();
+    uint32_t latency = (now > lp->wake_us) ? (uint32_t) (now - lp->wake_us) : 0;
+    lp->stats.frames++;
+    lp->stats.last_latency_us = latency;
+    lp->stats.max_latency_us  = max(lp->stats.max_latency_us, latency);
+    lp->stats.sum_latency_us += latency;
+}
+
+static uint32_t sleep_current_ua(const struct low_power *lp) {
+    switch(lp->mode){
+        case LOW_POWER_SLEEP:
+            return LOW_POWER_SLEEP_UA + (lp->keep_usb ? LOW_POWER_USB_UA : 0);
+        case LOW_POWER_SLEEP_PLL_OFF:
+            return LOW_POWER_SLEEP_PLL_OFF_UA + (lp->keep_usb ? LOW_POWER_USB_UA : 0);
+        default:
+            return LOW_POWER_IDLE_UA;
+    }
+}
+
+uint32_t low_power_average_current_ua(const struct low_power *lp) {
+    uint64_t active_us = lp->stats.active_us + (time_us_64() - lp->active_start_us);
+    uint64_t total_us  = active_us + lp->stats.sleep_us;
+    if(total_us == 0){
+        return LOW_POWER_ACTIVE_UA;
+    }
+    return (uint32_t) ((LOW_POWER_ACTIVE_UA * active_us + sleep_current_ua(lp) * lp->stats.sleep_us) / total_us);
+}
+
+void low_power_reset_stats(struct low_power *lp) {
+    memset(&lp->stats, 0, sizeof(struct low_power_stats));
+    lp->active_start_us = time_us_64();
+}
+
+void low_power_report(const struct low_power *lp) {
+    const struct low_power_stats *s = &lp->stats;
+    uint64_t active_us = s->active_us + (time_us_64() - lp->active_start_us);
+    uint64_t total_us  = max(active_us + s->sleep_us, 1);
+    uint32_t active    = (uint32_t) ((active_us * 10000) / total_us); // 0.01 %
+    uint32_t current   = low_power_average_current_ua(lp);
+    printf("power | mode %s | frames %u late %u | active %llu us sleep %llu us (%u.%02u %% active) | wake-to-first-symbol last %u us max %u us mean %u us | current %u.%02u mA (estimated)\n",
+           mode_names[lp->mode], s->frames, s->late, active_us, s->sleep_us, active / 100, active % 100,
+           s->last_latency_us, s->max_latency_us, (uint32_t) (s->sum_latency_us / max(s->frames, 1)),
+           current / 1000, (current % 1000) / 10);
+}
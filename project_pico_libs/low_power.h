@@ -0,0 +1,80 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Low-power operation between frames for the baseband tag. Unused clocks (ADC, RTC and without USB output
+ * also USB and its PLL) are stopped once. Between two frames the core goes to deep sleep (__wfi with
+ * SLEEPDEEP): while both cores sleep, all clocks not enabled in SLEEP_EN0/1 are gated, only the timer (and USB)
+ * keep running and a timer alarm wakes the core up. The PIO state-machine is clock-gated in its current
+ * state (stalled on the empty FIFO after a frame) and continues after the wake-up without reconfiguration.
+ *
+ * Modes:
+ * - LOW_POWER_OFF            sleep_until between frames, all clocks running (reference)
+ * - LOW_POWER_SLEEP          deep sleep with clock gating, the system PLL keeps running (fast wake-up)
+ * - LOW_POWER_SLEEP_PLL_OFF  additionally clk_sys runs from the crystal and the system PLL is powered down
+ *                            while sleeping, it is locked again after the wake-up (assumes the default
+ *                            125 MHz system clock, for which the PIO programs are generated)
+ * The dormant state is not used: it stops the crystal and therefore the timer, the tag has no other wake-up
+ * source (GPIO or external RTC clock).
+ *
+ * Reported: the wake-to-first-symbol latency (planned wake-up until the state-machine pulled the first word)
+ * and the average current, estimated from the active and sleep time with the currents below. These are
+ * typical values for a Pico at 5 V (VSYS), replace them with own measurements for accurate numbers.
+ *
+ */
+
+#ifndef LOW_POWER_LIB
+#define LOW_POWER_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#define LOW_POWER_ACTIVE_UA          25000 // 125 MHz, PIO running
+#define LOW_POWER_IDLE_UA            18000 // LOW_POWER_OFF: clocks running, core waiting
+#define LOW_POWER_SLEEP_UA            6000 // LOW_POWER_SLEEP
+#define LOW_POWER_SLEEP_PLL_OFF_UA    2000 // LOW_POWER_SLEEP_PLL_OFF
+#define LOW_POWER_USB_UA              4000 // added while sleeping if USB is kept running
+
+enum low_power_mode {
+  LOW_POWER_OFF = 0,
+  LOW_POWER_SLEEP,
+  LOW_POWER_SLEEP_PLL_OFF
+};
+
+struct low_power_stats {
+  uint32_t sleeps;
+  uint64_t sleep_us;
+  uint64_t active_us;
+  uint32_t frames;               // recorded first symbols
+  uint32_t last_latency_us;      // wake-to-first-symbol
+  uint32_t max_latency_us;
+  uint64_t sum_latency_us;
+  uint32_t late;                 // wake-ups after the planned time (alarm already past)
+};
+
+struct low_power {
+  enum low_power_mode    mode;
+  bool                   keep_usb;
+  uint64_t               wake_us;          // planned wake-up of the last sleep
+  uint64_t               active_start_us;
+  struct low_power_stats stats;
+};
+
+/* stop the unused clocks and configure the clocks which stay enabled during deep sleep */
+void low_power_init(struct low_power *lp, enum low_power_mode mode, bool keep_usb);
+
+/* sleep until wake (returns immediately if it has passed), the system clock is restored on return */
+void low_power_sleep_until(struct low_power *lp, absolute_time_t wake);
+
+/* the state-machine pulled the first word of a frame: record the wake-to-first-symbol latency */
+void low_power_first_symbol(struct low_power *lp);
+
+/* estimated average current [uA] since the last reset */
+uint32_t low_power_average_current_ua(const struct low_power *lp);
+
+void low_power_reset_stats(struct low_power *lp);
+
+/* print "power | ..." */
+void low_power_report(const struct low_power *lp);
+
+#endif
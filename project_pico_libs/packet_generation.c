@@ -11,7 +11,6 @@
 #include "pico/stdlib.h"
 #include "packet_generation.h"
 
-#define DEFAULT_SEED 0xABCD
 uint32_t seed = DEFAULT_SEED;
 
 uint8_t packet_hdr_2500[HEADER_LEN] = {0xaa, 0xaa, 0xaa, 0xaa, 0xd3, 0x91, 0xd3, 0x91, 0x00, 0x00};    // CC2500, the last two byte one for the payload length. and another is seq number
@@ -34,10 +33,35 @@ uint8_t *packet_hdr_template(uint16_t receiver){
  * generate of a uniform random number.
  */
 uint32_t rnd() {
-    const uint32_t A1 = 1664525;
-    const uint32_t C1 = 1013904223;
+    return rnd_r(&seed);
+}
+
+#define LCG_A 1664525
+#define LCG_C 1013904223
+
+uint32_t rnd_r(uint32_t *seed) {
+    const uint32_t A1 = LCG_A;
+    const uint32_t C1 = LCG_C;
     const uint32_t RAND_MAX1 = 0xFFFFFFFF;
-    seed = ((seed * A1 + C1) & RAND_MAX1);
+    *seed = ((*seed * A1 + C1) & RAND_MAX1);
+    return *seed;
+}
+
+/*
+ * steps LCG steps are again an LCG step x -> A*x + C (mod 2^32). Composing the step with itself doubles it:
+ * (a, c) -> (a*a, a*c + c). The bits of steps select which of the doubled steps are applied (square-and-multiply).
+ */
+uint32_t rnd_jump(uint32_t seed, uint32_t steps) {
+    uint32_t a = LCG_A;
+    uint32_t c = LCG_C;
+    while(steps > 0){
+        if(steps & 1){
+            seed = seed * a + c;
+        }
+        c = a * c + c;
+        a = a * a;
+        steps >>= 1;
+    }
     return seed;
 }
 
@@ -47,15 +71,37 @@ uint32_t rnd() {
  * Hint for compression: view the data distribution (this function implememnts a Box-Muller Transform)
  */
 uint16_t file_position = 0;
+static uint16_t seed_position = 0; // file_position matching seed
 uint16_t generate_sample(){
+    if (file_position != seed_position) {
+        seed = rnd_jump(DEFAULT_SEED, file_position); /* file_position has been set by the application */
+    }
     if (file_position == 0) {
         seed = DEFAULT_SEED; /* reset seed when exceeding uint16_t max */
     }
     file_position = file_position + 2;
+    seed_position = file_position;
+    return generate_sample_r(&seed);
+}
+
+void stream_seek(struct sample_stream *stream, uint16_t position) {
+    stream->seed     = rnd_jump(DEFAULT_SEED, position);
+    stream->position = position;
+}
+
+uint16_t stream_sample(struct sample_stream *stream) {
+    if (stream->position == 0) {
+        stream->seed = DEFAULT_SEED;
+    }
+    stream->position = stream->position + 2;
+    return generate_sample_r(&stream->seed);
+}
+
+uint16_t generate_sample_r(uint32_t *seed){
     double two_pi = 2.0 * M_PI;
     double u1, u2;
-    u1 = ((double) rnd())/ ((double) 0xFFFFFFFF);
-    u2 = ((double) rnd())/((double) 0xFFFFFFFF);
+    u1 = ((double) rnd_r(seed))/ ((double) 0xFFFFFFFF);
+    u2 = ((double) rnd_r(seed))/((double) 0xFFFFFFFF);
     double tmp = ((double) 0x7FF) * sqrt(-2.0 * log(u1));
     return max(0.0,min(((double) 0x3FFFFF),tmp * cos(two_pi * u2) + ((double) 0x1FFF)));
 }
@@ -83,6 +129,24 @@ void generate_data(uint8_t *buffer, uint8_t length, bool include_index) {
     }
 }
 
+void stream_generate_data(struct sample_stream *stream, uint8_t *buffer, uint8_t length, bool include_index) {
+    if(length % 2 != 0){
+        printf("WARNING: stream_generate_data has been used with an odd length.");
+    }
+
+    uint8_t data_start = 0;
+    if(include_index){
+        buffer[0] = (uint8_t) (stream->position >> 8);
+        buffer[1] = (uint8_t) (stream->position & 0x00FF);
+        data_start = 2;
+    }
+    for (uint8_t i=data_start; i < length; i=i+2) {
+        uint16_t sample = stream_sample(stream);
+        buffer[i]   = (uint8_t) (sample >> 8);
+        buffer[i+1] = (uint8_t) (sample & 0x00FF);
+    }
+}
+
 /* including a header to the packet:
  * - 8B header sequence
  * - 1B payload length
@@ -103,3 +167,36 @@ void add_header(uint8_t *packet, uint8_t seq, uint8_t *header_template) {
     packet[HEADER_LEN-1] = seq;
 }
 
+uint16_t packet_crc16(const uint8_t *data, uint8_t len) {
+    uint16_t crc = 0xFFFF;
+    for(uint8_t i = 0; i < len; i++){
+        uint8_t byte = data[i];
+        for(uint8_t bit = 0; bit < 8; bit++){
+            if(((crc & 0x8000) >> 8) ^ (byte & 0x80)){
+                crc = (crc << 1) ^ 0x8005;
+            }else{
+                crc = crc << 1;
+            }
+            byte = byte << 1;
+        }
+    }
+    return crc;
+}
+
+uint8_t build_frame(uint32_t *buffer, uint8_t seq, const uint8_t *payload, uint8_t len, uint8_t *header_template) {
+    uint8_t message[buffer_size(MAX_PAYLOADSIZE+CRC_LEN, HEADER_LEN)*4] = {0};
+    len = min(len, MAX_PAYLOADSIZE);
+    add_header(&message[0], seq, header_template);
+    message[HEADER_LEN-2] = 1 + len;
+    memcpy(&message[HEADER_LEN], payload, len);
+    uint16_t crc = packet_crc16(&message[HEADER_LEN-2], 2 + len); // length byte, sequence number and payload
+    message[HEADER_LEN+len]   = (uint8_t) (crc >> 8);
+    message[HEADER_LEN+len+1] = (uint8_t) (crc & 0x00FF);
+
+    /* casting for 32-bit fifo */
+    uint8_t words = buffer_size(len+CRC_LEN, HEADER_LEN);
+    for (uint8_t i=0; i < words; i++) {
+        buffer[i] = ((uint32_t) message[4*i+3]) | (((uint32_t) message[4*i+2]) << 8) | (((uint32_t) message[4*i+1]) << 16) | (((uint32_t)message[4*i]) << 24);
+    }
+    return words;
+}
@@ -14,8 +14,11 @@
 #include "pico/stdlib.h"
 #include "packet_generation.h"
 
+#define DEFAULT_SEED 0xABCD
 #define PAYLOADSIZE 14
 #define HEADER_LEN  10 // 8 header + length + seq
+#define MAX_PAYLOADSIZE 60 // largest payload fitting the CC2500 RX FIFO (64 byte: length, seq, payload and 2 status bytes)
+#define CRC_LEN      2
 #define buffer_size(x, y) (((x + y) % 4 == 0) ? ((x + y) / 4) : ((x + y) / 4 + 1)) // define the buffer size with ceil((PAYLOADSIZE+HEADER_LEN)/4)
 
 #ifndef MINMAX
@@ -34,13 +37,47 @@ uint8_t *packet_hdr_template(uint16_t receiver);
  */
 uint32_t rnd();
 
+/* 
+ * reentrant variant of rnd() operating on the provided seed
+ */
+uint32_t rnd_r(uint32_t *seed);
+
+/*
+ * seed after steps calls of rnd_r, in O(log steps) (jump-ahead of the LCG)
+ */
+uint32_t rnd_jump(uint32_t seed, uint32_t steps);
+
 /* 
  * generate compressible payload sample
- * file_position provides the index of the next data byte (increments by 2 each time the function is called)
+ * file_position provides the index of the next data byte (increments by 2 each time the function is called),
+ * it may be set to any position (e.g. to start mid-file): the generator then jumps to it
  */
 extern uint16_t file_position;
 uint16_t generate_sample();
 
+/* 
+ * reentrant variant of generate_sample() without file_position handling (consumes two numbers of the seed)
+ */
+uint16_t generate_sample_r(uint32_t *seed);
+
+/*
+ * sample stream: independent generator state with random access to any file_position
+ * the sample at position p uses the numbers p+1 and p+2 after DEFAULT_SEED (restarting when position wraps to 0)
+ */
+struct sample_stream {
+  uint32_t seed;
+  uint16_t position; // index of the next data byte
+};
+
+/* stream at position (O(log position)) */
+void stream_seek(struct sample_stream *stream, uint16_t position);
+
+/* next sample of the stream (as generate_sample) */
+uint16_t stream_sample(struct sample_stream *stream);
+
+/* as generate_data, on the stream */
+void stream_generate_data(struct sample_stream *stream, uint8_t *buffer, uint8_t length, bool include_index);
+
 /*
  * fill packet with 16-bit samples
  * include_index: shall the file index be included at the first two byte?
@@ -59,4 +96,20 @@ void generate_data(uint8_t *buffer, uint8_t length, bool include_index);
  */
 void add_header(uint8_t *packet, uint8_t seq, uint8_t *header_template);
 
+/*
+ * CRC-16 as computed by the CC2500 packet handler (polynomial 0x8005, initial value 0xFFFF, MSB first)
+ * data: length byte, sequence number and payload
+ */
+uint16_t packet_crc16(const uint8_t *data, uint8_t len);
+
+/* complete frame for the 32-bit PIO FIFO:
+ * - header (the length byte covers the sequence number and len payload bytes)
+ * - payload (len <= MAX_PAYLOADSIZE)
+ * - CRC-16 (checked by the receiver, PKTCTRL0.CRC_EN)
+ *
+ * buffer: at least buffer_size(len+CRC_LEN, HEADER_LEN) words
+ * returns the number of words to send
+ */
+uint8_t build_frame(uint32_t *buffer, uint8_t seq, const uint8_t *payload, uint8_t len, uint8_t *header_template);
+
 #endif
\ No newline at end of file
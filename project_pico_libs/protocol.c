@@ -0,0 +1,76 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Binary command protocol (see protocol.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "packet_generation.h"
+#include "protocol.h"
+
+void protocol_decoder_reset(struct protocol_decoder *decoder) {
+    decoder->pos = 0;
+}
+
+uint8_t protocol_feed(struct protocol_decoder *decoder, uint8_t byte, struct protocol_frame *frame) {
+    uint8_t *b = decoder->buffer;
+    if(decoder->pos == 0){
+        // LEN covers SEQ, TYPE and the values
+        if(byte < 2 || (byte - 2) % 4 != 0 || (byte - 2) / 4 > PROTOCOL_MAX_VALUES){
+            return PROTOCOL_INVALID;
+        }
+    }
+    b[decoder->pos++] = byte;
+    if(decoder->pos < 1 + b[0] + 2){
+        return PROTOCOL_PENDING;
+    }
+    uint16_t crc = (((uint16_t) b[decoder->pos-2]) << 8) | b[decoder->pos-1];
+    frame->seq   = b[1];
+    frame->type  = b[2];
+    frame->count = (b[0] - 2) / 4;
+    if(packet_crc16(b, 1 + b[0]) != crc){
+        return PROTOCOL_CRC_ERROR;
+    }
+    memset(frame->values, 0, sizeof(frame->values));
+    for(uint8_t i = 0; i < frame->count; i++){
+        const uint8_t *v = &b[3 + 4*i];
+        frame->values[i] = ((uint32_t) v[0]) | (((uint32_t) v[1]) << 8) | (((uint32_t) v[2]) << 16) | (((uint32_t) v[3]) << 24);
+    }
+    return PROTOCOL_OK;
+}
+
+void protocol_send(uint8_t type, uint8_t seq, const uint8_t *data, uint8_t len) {
+    uint8_t frame[4 + PROTOCOL_MAX_DATA + 2];
+    len = min(len, PROTOCOL_MAX_DATA);
+    frame[0] = PROTOCOL_SOF;
+    frame[1] = 2 + len;
+    frame[2] = seq;
+    frame[3] = type;
+    memcpy(&frame[4], data, len);
+    uint16_t crc = packet_crc16(&frame[1], 3 + len);
+    frame[4+len] = (uint8_t) (crc >> 8);
+    frame[5+len] = (uint8_t) (crc & 0x00FF);
+    for(uint8_t i = 0; i < 6 + len; i++){
+        putchar_raw(frame[i]); // no CRLF translation
+    }
+}
+
+void protocol_send_ack(uint8_t seq, uint8_t command, uint8_t status) {
+    uint8_t data[2] = {command, status};
+    protocol_send(PROTOCOL_ACK, seq, data, 2);
+}
+
+void protocol_send_values(uint8_t type, uint8_t seq, const uint32_t *values, uint8_t count) {
+    uint8_t data[PROTOCOL_MAX_DATA];
+    count = min(count, PROTOCOL_MAX_DATA / 4);
+    for(uint8_t i = 0; i < count; i++){
+        data[4*i]   = (uint8_t) (values[i] & 0xFF);
+        data[4*i+1] = (uint8_t) ((values[i] >> 8) & 0xFF);
+        data[4*i+2] = (uint8_t) ((values[i] >> 16) & 0xFF);
+        data[4*i+3] = (uint8_t) ((values[i] >> 24) & 0xFF);
+    }
+    protocol_send(type, seq, data, 4*count);
+}
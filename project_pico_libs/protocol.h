@@ -0,0 +1,66 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Binary command protocol on the USB serial port, next to the text commands:
+ *
+ *   SOF | LEN | SEQ | TYPE | DATA (LEN-2 byte) | CRC-16 (MSB first)
+ *
+ * - SOF (0x02) never starts a text command, the frames can therefore be mixed with text input
+ * - the CRC is computed over LEN, SEQ, TYPE and DATA (packet_crc16, the CC2500 CRC)
+ * - host -> board: TYPE is the command letter, DATA up to PROTOCOL_MAX_VALUES 32-bit values (little endian)
+ * - board -> host: PROTOCOL_ACK (DATA: command letter and protocol_status) for every command frame,
+ *   PROTOCOL_RESULT (DATA: 32-bit values) for streamed results
+ *
+ * The board's frames are written without CRLF translation (putchar_raw) and may appear between text lines.
+ *
+ */
+
+#ifndef PROTOCOL_LIB
+#define PROTOCOL_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#define PROTOCOL_SOF              0x02
+#define PROTOCOL_MAX_VALUES          5  // host -> board
+#define PROTOCOL_MAX_DATA           64  // board -> host
+#define PROTOCOL_BYTE_TIMEOUT_US 10000  // an incomplete frame is dropped after this pause
+
+enum protocol_type {
+  PROTOCOL_ACK    = 'A',
+  PROTOCOL_RESULT = 'R'
+};
+
+enum protocol_status {
+  PROTOCOL_OK = 0,
+  PROTOCOL_INVALID,     // unknown command or rejected values
+  PROTOCOL_CRC_ERROR,
+  PROTOCOL_BUSY,        // not possible while a measurement is running
+  PROTOCOL_PENDING      // decoder: frame incomplete
+};
+
+struct protocol_frame {
+  uint8_t  seq;
+  uint8_t  type;
+  uint8_t  count;       // number of values
+  uint32_t values[PROTOCOL_MAX_VALUES];
+};
+
+struct protocol_decoder {
+  uint8_t buffer[3 + 4*PROTOCOL_MAX_VALUES + 2]; // LEN, SEQ, TYPE, DATA, CRC
+  uint8_t pos;
+};
+
+void protocol_decoder_reset(struct protocol_decoder *decoder);
+
+/* feed the bytes following the SOF: PROTOCOL_PENDING until the frame is complete, then PROTOCOL_OK or an error */
+uint8_t protocol_feed(struct protocol_decoder *decoder, uint8_t byte, struct protocol_frame *frame);
+
+void protocol_send(uint8_t type, uint8_t seq, const uint8_t *data, uint8_t len);
+
+void protocol_send_ack(uint8_t seq, uint8_t command, uint8_t status);
+
+void protocol_send_values(uint8_t type, uint8_t seq, const uint32_t *values, uint8_t count);
+
+#endif
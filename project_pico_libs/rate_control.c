@@ -0,0 +1,122 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Adaptive rate control (see rate_control.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "packet_generation.h"
+#include "rate_control.h"
+
+#define FRAME_BITS    (buffer_size(PAYLOADSIZE+CRC_LEN, HEADER_LEN) * 32)
+#define PAYLOAD_BITS  (PAYLOADSIZE * 8)
+
+/*
+ * deviation = CLK/d1 - CLK/d0 over 2 (<= 380 kHz for the CC2500), bandwidth = baud + 2*deviation (<= 812 kHz)
+ * The deviation grows with the baud-rate to keep the modulation index >= 2.
+ */
+const struct rate_step rate_ladder[RATE_LADDER_STEPS] = {
+  {.d0 = 26, .d1 = 24, .baud =  10000, .min_rssi = -128}, // deviation 200 kHz
+  {.d0 = 24, .d1 = 22, .baud =  25000, .min_rssi =  -90}, // deviation 237 kHz
+  {.d0 = 22, .d1 = 20, .baud =  50000, .min_rssi =  -87}, // deviation 284 kHz
+  {.d0 = 20, .d1 = 18, .baud =  62500, .min_rssi =  -85}, // deviation 347 kHz
+  {.d0 = 20, .d1 = 18, .baud = 100000, .min_rssi =  -83}, // deviation 347 kHz
+};
+
+static void window_reset(struct rate_control *rc) {
+    rc->sent       = 0;
+    rc->received   = 0;
+    rc->rssi_sum   = 0;
+    rc->rssi_count = 0;
+}
+
+void rate_control_init(struct rate_control *rc, bool enabled, uint8_t step) {
+    memset(rc, 0, sizeof(struct rate_control));
+    rc->enabled = enabled;
+    rc->step    = min(step, RATE_LADDER_STEPS-1);
+    rc->holdoff = 1;
+}
+
+void rate_control_sent(struct rate_control *rc, uint64_t now_us) {
+    if(rc->sent == 0){
+        rc->window_start_us = now_us;
+    }
+    rc->sent++;
+}
+
+void rate_control_received(struct rate_control *rc, Packet_status status) {
+    if(status.overflowed){
+        return;
+    }
+    rc->rssi_sum += status.RSSI;
+    rc->rssi_count++;
+    if(status.CRCcheck){
+        rc->received++;
+    }
+}
+
+bool rate_control_window_done(const struct rate_control *rc) {
+    return rc->enabled && rc->sent >= RATE_WINDOW_FRAMES;
+}
+
+void rate_control_set_step(struct rate_control *rc, uint8_t step) {
+    rc->step = min(step, RATE_LADDER_STEPS-1);
+}
+
+uint32_t rate_control_period_us(uint8_t step) {
+    const struct rate_step *r = &rate_ladder[min(step, RATE_LADDER_STEPS-1)];
+    return (uint32_t) (((uint64_t) FRAME_BITS * 1000000 * 100) / ((uint64_t) r->baud * RATE_DUTY_PERCENT));
+}
+
+uint8_t rate_control_decide(struct rate_control *rc, uint64_t now_us) {
+    const struct rate_step *current = &rate_ladder[rc->step];
+    uint64_t elapsed  = max(now_us - rc->window_start_us, (uint64_t) 1);
+    uint32_t per      = (rc->sent > 0) ? ((rc->sent - min(rc->received, rc->sent)) * 1000) / rc->sent : 0; // permille
+    int32_t  rssi     = (rc->rssi_count > 0) ? rc->rssi_sum / (int32_t) rc->rssi_count : -128;
+    uint32_t goodput  = (uint32_t) (((uint64_t) rc->received * PAYLOAD_BITS * 1000000) / elapsed);
+    uint8_t  next     = rc->step;
+    const char *reason = "stay";
+
+    if(rc->probing){
+        rc->probing = false;
+        if(goodput <= rc->previous_goodput || per > RATE_DOWN_PER_PERMILLE){
+            next        = rc->step - 1;
+            rc->holdoff = min(rc->holdoff * 2, RATE_MAX_HOLDOFF);
+            reason      = "probe failed";
+        }else{
+            rc->holdoff = 1;
+            reason      = "probe ok";
+        }
+        rc->clean_windows = 0;
+    }else if(per > RATE_DOWN_PER_PERMILLE && rc->step > 0){
+        next              = rc->step - 1;
+        rc->clean_windows = 0;
+        reason            = "PER";
+    }else if(per <= RATE_UP_PER_PERMILLE && rc->step+1 < RATE_LADDER_STEPS && rssi >= rate_ladder[rc->step+1].min_rssi){
+        rc->clean_windows++;
+        if(rc->clean_windows >= rc->holdoff){
+            next              = rc->step + 1;
+            rc->probing       = true;
+            rc->clean_windows = 0;
+            reason            = "probe";
+        }
+    }else{
+        rc->clean_windows = 0;
+    }
+
+    printf("rate | window %u | step %u (b %u %u %u) | sent %u ok %u PER %u.%u%% RSSI %d | goodput %u bit/s | %s -> step %u\n",
+           rc->windows, rc->step, current->d0, current->d1, current->baud, rc->sent, rc->received, per / 10, per % 10, rssi, goodput, reason, next);
+
+    rc->previous_goodput = goodput;
+    rc->windows++;
+    if(next != rc->step){
+        rc->changes++;
+    }
+    rc->step = next;
+    window_reset(rc);
+    return next;
+}
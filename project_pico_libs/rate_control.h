@@ -0,0 +1,80 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Adaptive rate control for the combined board (carrier-receiver-baseband), which configures both
+ * the tag (PIO dividers d0/d1 and baud-rate) and the receiver.
+ *
+ * The controller walks a ladder of backscatter configurations from robust/slow to fast. After each
+ * window of RATE_WINDOW_FRAMES transmitted frames it computes the PER, the mean RSSI and the goodput
+ * (delivered payload bits per second of the window) and decides:
+ * - step down if the PER exceeds RATE_DOWN_PER_PERMILLE
+ * - probe the next step up if the link was clean (PER <= RATE_UP_PER_PERMILLE) for holdoff windows and
+ *   the RSSI reaches the minimum of the next step
+ * - after a probe, keep the new step if its goodput is higher, otherwise step back and double the holdoff
+ * Every decision is logged ("rate | ...").
+ *
+ * The frames of a step are sent every rate_control_period_us (RATE_DUTY_PERCENT airtime), so that a faster
+ * step also delivers more payload per second and not only per second of airtime.
+ *
+ */
+
+#ifndef RATE_CONTROL_LIB
+#define RATE_CONTROL_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+
+#define RATE_LADDER_STEPS            5
+#define RATE_WINDOW_FRAMES          20
+#define RATE_DOWN_PER_PERMILLE     100 // 10%
+#define RATE_UP_PER_PERMILLE        10 //  1%
+#define RATE_MAX_HOLDOFF            16 // windows
+#define RATE_DUTY_PERCENT           10 // TX period 10x the airtime of a frame (224 ms at 10 kBaud)
+
+struct rate_step {
+  uint16_t d0;        // clock divider symbol 0
+  uint16_t d1;        // clock divider symbol 1
+  uint32_t baud;
+  int8_t   min_rssi;  // [dBm] required to probe this step
+};
+
+extern const struct rate_step rate_ladder[RATE_LADDER_STEPS];
+
+struct rate_control {
+  bool     enabled;
+  uint8_t  step;
+  // current window
+  uint64_t window_start_us; // first frame sent
+  uint32_t sent;
+  uint32_t received;       // CRC pass
+  int32_t  rssi_sum;
+  uint32_t rssi_count;
+  // decision state
+  bool     probing;        // the current step is a probe
+  uint32_t previous_goodput;
+  uint8_t  clean_windows;
+  uint8_t  holdoff;
+  uint32_t windows;
+  uint32_t changes;
+};
+
+void rate_control_init(struct rate_control *rc, bool enabled, uint8_t step);
+
+void rate_control_sent(struct rate_control *rc, uint64_t now_us);
+
+void rate_control_received(struct rate_control *rc, Packet_status status);
+
+bool rate_control_window_done(const struct rate_control *rc);
+
+/* evaluate the window, log the decision, start the next window and return the step to use */
+uint8_t rate_control_decide(struct rate_control *rc, uint64_t now_us);
+
+/* TX period of a step [us] */
+uint32_t rate_control_period_us(uint8_t step);
+
+/* the applied step (e.g. to step back if the configuration could not be applied) */
+void rate_control_set_step(struct rate_control *rc, uint8_t step);
+
+#endif
@@ -16,15 +16,16 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
 #include "pico/stdlib.h"
 #include "pico/util/queue.h"
 #include "pico/binary_info.h"
 #include "hardware/spi.h"
+#include "cc2500.h"
 #include "receiver_CC2500.h"
 #include "carrier_CC2500.h"
+#include "trace.h"
 
-queue_t event_queue;
+CC2500 radio_rx = {.spi = RADIO_SPI, .csn = RX_CSN, .gdo0 = RX_GDO0_PIN, .name = "rx"};
 
 // Address Config = No address check
 // Base Frequency = 2456.596924
@@ -75,53 +76,64 @@ RF_setting cc2500_receiver[20] = {
   {.address = 0x26, .value = 0x11}, // CC2500_FSCAL0: Frequency Synthesizer Calibration
 };
 
+RF_profile rx_profiles[RX_PROFILE_COUNT];
+
+/* cached synthesizer calibration of the sweep steps */
+struct sweep_point {
+  uint8_t freq[3];   // FREQ2, FREQ1, FREQ0
+  uint8_t fscal[3];  // FSCAL3, FSCAL2, FSCAL1
+};
+static struct sweep_point sweep_points[SWEEP_MAX_STEPS];
+static uint32_t sweep_cached_start = 0;
+static uint32_t sweep_cached_step  = 0;
+static uint8_t  sweep_cached_steps = 0;
+
 void cs_select_rx() {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(RX_CSN, 0);  // Active low
-    asm volatile("nop \n nop \n nop");
+    cc2500_cs_select(&radio_rx);
 }
 
 void cs_deselect_rx() {
-    asm volatile("nop \n nop \n nop");
-    gpio_put(RX_CSN, 1);
-    asm volatile("nop \n nop \n nop");
+    cc2500_cs_deselect(&radio_rx);
 }
 
 void write_strobe_rx(uint8_t cmd) {
-    cs_select_rx();
-    spi_write_blocking(RADIO_SPI, &cmd, 1);
-    cs_deselect_rx();
+    cc2500_strobe(&radio_rx, cmd);
     sleep_ms(1);
 }
 
 void write_register_rx(RF_setting set) {
-    uint8_t buf[2];
-    buf[0] = set.address;
-    buf[1] = set.value;
-    cs_select_rx();
-    spi_write_blocking(RADIO_SPI, buf, 2);
-    cs_deselect_rx();
+    cc2500_write_register(&radio_rx, set.address, set.value);
     sleep_ms(1);
 }
 
 void write_registers_rx(RF_setting* sets, uint8_t len) {
-    uint8_t buf[2];
-    cs_select_rx();
-    for (int i = 0; i < len; i++) {
-        buf[0] = sets[i].address;
-        buf[1] = sets[i].value;
-        spi_write_blocking(RADIO_SPI, buf, 2);
-    }
-    cs_deselect_rx();
+    cc2500_write_registers(&radio_rx, sets, len);
+}
+
+void write_burst_rx(uint8_t address, const uint8_t *values, uint8_t len) {
+    cc2500_write_burst(&radio_rx, address, values, len);
+}
+
+void read_burst_rx(uint8_t address, uint8_t *values, uint8_t len) {
+    cc2500_read_burst(&radio_rx, address, values, len);
+}
+
+// status registers (0x30 - 0x3D) can only be accessed with the burst bit set
+uint8_t read_status_rx(uint8_t address) {
+    return cc2500_read_status(&radio_rx, address);
+}
+
+// command strobe without the additional delay of write_strobe_rx
+static void strobe_rx(uint8_t cmd) {
+    cc2500_strobe(&radio_rx, cmd);
+}
+
+static bool wait_idle_rx() {
+    return cc2500_wait_idle(&radio_rx);
 }
 
 RF_setting read_register_rx(uint8_t address) {
-    uint8_t buf[2] = {0, 0};
-    cs_select_rx();
-    spi_read_blocking(RADIO_SPI, address+0x80, buf, 2);
-    cs_deselect_rx();
-    sleep_ms(1);
-    return (RF_setting){.address = address, .value = buf[1]};
+    return (RF_setting){.address = address, .value = cc2500_read_register(&radio_rx, address)};
 }
 
 void print_registers_rx() {
@@ -129,9 +141,7 @@ void print_registers_rx() {
     uint8_t r = 0;
     for (r=0x00; r<=0x2e; r++)
     {
-        cs_select_rx();
-        spi_read_blocking(RADIO_SPI, r+0x80, buf, 2);
-        cs_deselect_rx();
+        cc2500_read_burst(&radio_rx, r, &buf[1], 1); // from the radio (not the shadow), also with a queued bus
         sleep_ms(1);
         printf("    {.address = 0x%02x, .value = 0x%02x},\n", r, buf[1]);
     }
@@ -140,84 +150,56 @@ void print_registers_rx() {
 /* ISR */
 void receiver_isr(uint gpio, uint32_t events)
 {
-    event_t evt;
-    switch(gpio){
-        case RX_GDO0_PIN:
-            switch(events){
-                case GPIO_IRQ_EDGE_RISE:
-                    evt = rx_assert_evt;
-                    queue_try_add(&event_queue, &evt);
-                    break;
-                case GPIO_IRQ_EDGE_FALL:
-                    evt = rx_deassert_evt;
-                    queue_try_add(&event_queue, &evt);
-                    break;
-            }
-        break;
-    }
+    cc2500_isr(gpio, events);
 }
 
-void setupReceiver(){
-    write_strobe_rx(SRES);  // in case of reset without power loss - reset manually
-    sleep_us(100);
-    write_strobe_rx(SIDLE); // ensure IDLE mode with command strobe: SIDLE
-    write_registers_rx(cc2500_receiver,20);
-
-    /* Event queue setup */
-    queue_init(&event_queue, sizeof(event_t), EVENT_QUEUE_LENGTH);
+void cc2500_setup_receiver(CC2500 *radio){
+    cc2500_reset(radio);                // in case of reset without power loss - reset manually
+    cc2500_strobe(radio, SIDLE);        // ensure IDLE mode with command strobe: SIDLE
+    cc2500_wait_idle(radio);
+    cc2500_write_registers(radio, cc2500_receiver, 20);
+    cc2500_enable_events(radio);        // event queue and GDO0 interrupt
+}
 
-    /* Reset the queue */
-    while(queue_try_remove(&event_queue, NULL));
+void cc2500_start_listen(CC2500 *radio){
+    trace_add(TRACE_RX_LISTEN, radio->gdo0);
+    cc2500_strobe(radio, SIDLE);
+    cc2500_wait_idle(radio);
+    cc2500_write_register(radio, 0x17, 0x00);    // after receiving a packet, return to idle
+    //cc2500_write_register(radio, 0x17, 0x0C);  // after receiving a packet, listen for next one
+    cc2500_strobe(radio, SFRX); // clear FIFO
+    cc2500_strobe(radio, SRX);  // start listening (enter RX mode with command strobe: SRX)
+}
 
-    /* GDO0 setup as interrupt */
-    gpio_set_irq_enabled_with_callback(RX_GDO0_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, &receiver_isr);
+void cc2500_stop_listen(CC2500 *radio){
+    cc2500_strobe(radio, SIDLE); // stop listening (enter IDLE mode with command strobe: SIDLE)
+}
 
+void setupReceiver(){
+    cc2500_setup_receiver(&radio_rx);
 }
 
 // continously listen for packets
 void RX_start_listen(){
-    write_strobe_rx(SIDLE);
-    RF_setting set = {.address = 0x17, .value = 0x00};    // after receiving a packet, return to idle
-    //RF_setting set = {.address = 0x17, .value = 0x0C}; // after receiving a packet, listen for next one
-    write_register_rx(set);
-    write_strobe_rx(SFRX); // clear FIFO
-    write_strobe_rx(SRX);  // start listening (enter RX mode with command strobe: SRX)
+    cc2500_start_listen(&radio_rx);
     printf("> Started listening.\n");
 }
 
 // stop listening
 void RX_stop_listen(){
-    write_strobe_rx(SIDLE); // stop listening (enter IDLE mode with command strobe: SIDLE)
+    cc2500_stop_listen(&radio_rx);
     printf("> Stopped receiver.\n");
 }
 
 Packet_status readPacket(uint8_t *buffer){
-    Packet_status status;
-    uint8_t tmp_buffer[2];
-    // since the provided length of a packet might be corrupted, read length from fifo status
-    cs_select_rx();
-    spi_read_blocking(RADIO_SPI, 0xFB, tmp_buffer, 2);               // read RX FIFO status
-    cs_deselect_rx();
-    status.overflowed = (bool) (tmp_buffer[1] & 0x80);
-    if (!status.overflowed){
-        status.len = (tmp_buffer[1] & 0x7F) - 2;
-        cs_select_rx();
-        spi_read_blocking(RADIO_SPI, 0xFF, tmp_buffer, 1);               // sart burst access to RX FIFO
-        spi_read_blocking(RADIO_SPI, 0xFF, buffer, min(min(status.len, 62), RX_BUFFER_SIZE));  // start reading from burst (max. 62 bytes of packet)
-        spi_read_blocking(RADIO_SPI, 0xFF, tmp_buffer,  2);              // read quality information
-        cs_deselect_rx();
-        status.CRCcheck = (bool) (tmp_buffer[1] & 0x80);
-        status.LinkQualityIndicator = (tmp_buffer[1] & 0x7F);
-        if(tmp_buffer[0] >= 128){
-            status.RSSI = (((int32_t) tmp_buffer[0]) - 256)/2 - 70;
-        }else{
-            status.RSSI = ((int32_t) tmp_buffer[0])/2 - 70;
-        }
-    }
+    trace_add(TRACE_READ_PACKET, 0);
+    Packet_status status = cc2500_read_packet(&radio_rx, buffer);
+    trace_add(TRACE_READ_PACKET_DONE, status.len);
     return status;
 }
 
 void printPacket(uint8_t *packet, Packet_status status, uint64_t time_us){
+    trace_add(TRACE_PRINT_PACKET, 0);
     // generate timestamp since boot-up
     uint64_t time_rem;
     uint32_t hours    = (int32_t) (time_us  / ((uint64_t) 36 * (uint64_t) 100000000));
@@ -242,108 +224,439 @@ void printPacket(uint8_t *packet, Packet_status status, uint64_t time_us){
             printf("CRC error\n");
         }
     }
+    trace_add(TRACE_PRINT_PACKET_DONE, 0);
 }
 
 event_t get_event(void)
 {
-    event_t evt = no_evt;
-    if (queue_try_remove(&event_queue, &evt))
-    {
-        return evt;
-    }
-    return no_evt;
+    return cc2500_get_event(&radio_rx);
 }
 
-uint32_t set_datarate_rx(uint32_t r_data)
+uint32_t cc2500_set_datarate(CC2500 *radio, uint32_t r_data)
 {
-    write_strobe_rx(SIDLE); // ensure IDLE mode with command strobe: SIDLE
-    
+    cc2500_strobe(radio, SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_wait_idle(radio);
+
     // see datasheet, section 12
-    uint8_t drate_e = floor(log2(((double) r_data * (1 << 20)) / ((double) F_XOSC)));
-    uint8_t drate_m = floor(((double) r_data * (1 << 28)) / ((double) F_XOSC * (1 << drate_e)) - 256.0);
-    
+    uint8_t drate_e, drate_m;
+    uint32_t r_data_calculated = datarate_fields(r_data, &drate_e, &drate_m);
+
     // print new value
-    uint32_t r_data_calculated = floor(((256.0+drate_m)*(1 << drate_e) * (double) F_XOSC) / ((double) (1 << 28)));
-    printf("set rx r_data: [%u %u] %u\n", drate_e, drate_m, r_data_calculated);
-    
+    printf("set %s r_data: [%u %u] %u\n", radio->name, drate_e, drate_m, r_data_calculated);
+
     // MDMCFG4, MDMCFG3
-    RF_setting mdmcfg3 = read_register_rx(0x10);
+    uint8_t mdmcfg4 = cc2500_read_register(radio, 0x10);
     RF_setting set[2] = {
-        {.address = 0x10, .value = (mdmcfg3.value & 0xf0) + (drate_e & 0x0f)},
+        {.address = 0x10, .value = (mdmcfg4 & 0xf0) + (drate_e & 0x0f)},
         {.address = 0x11, .value = drate_m}
     };
-    write_registers_rx(set,2);
+    cc2500_write_registers(radio, set, 2);
     return r_data_calculated;
 }
 
-uint32_t set_filter_bandwidth_rx(uint32_t bw)
+uint32_t cc2500_set_filter_bandwidth(CC2500 *radio, uint32_t bw)
 {
-    write_strobe_rx(SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_strobe(radio, SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_wait_idle(radio);
 
     // see datasheet, section 13
-    uint8_t chanbw_e = floor(log2(((double) F_XOSC)/((double) (1 << 5) * bw)/log2(2.0)));
-    uint8_t chanbw_m = floor(((double) F_XOSC)/((double) 8.0 * bw * (1 << chanbw_e)) - 4.0);
-    
+    uint8_t chanbw_e, chanbw_m;
+    uint32_t bw_calculated = filter_bandwidth_fields(bw, &chanbw_e, &chanbw_m);
+
     // print new value
-    uint32_t bw_calculated = floor(((double) F_XOSC) / ((double) 8.0*(4.0+chanbw_m)*(1 << chanbw_e)));
-    printf("set rx bw: [%u %u] %u\n", chanbw_e, chanbw_m, bw_calculated);
-    
-    // MDMCFG3
-    RF_setting mdmcfg3 = read_register_rx(0x10);
-    RF_setting set = (RF_setting){.address = 0x10, .value = ((chanbw_e & 0x03) << 6) + ((chanbw_m & 0x03) << 4) + (mdmcfg3.value & 0x0f)};
-    write_register_rx(set);
+    printf("set %s bw: [%u %u] %u\n", radio->name, chanbw_e, chanbw_m, bw_calculated);
+
+    // MDMCFG4
+    uint8_t mdmcfg4 = cc2500_read_register(radio, 0x10);
+    cc2500_write_register(radio, 0x10, ((chanbw_e & 0x03) << 6) + ((chanbw_m & 0x03) << 4) + (mdmcfg4 & 0x0f));
     return bw_calculated;
 }
 
-uint32_t set_frequency_deviation_rx(uint32_t f_dev)
+uint32_t cc2500_set_frequency_deviation(CC2500 *radio, uint32_t f_dev)
 {
-    write_strobe_rx(SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_strobe(radio, SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_wait_idle(radio);
 
     // see datasheet, section 16
-    uint8_t deviation_e = floor(log2(((double) f_dev) * (1 << 14) / ((double) F_XOSC)));
-    uint8_t deviation_m = floor((((double) f_dev) * (1 << 17)) / ((double) (1 << deviation_e) * F_XOSC) - 8.0);
+    uint8_t deviation_e, deviation_m;
+    uint32_t f_dev_calculated = deviation_fields(f_dev, &deviation_e, &deviation_m);
 
     // new value
-    uint32_t f_dev_calculated = floor(((double) F_XOSC) * (8.0 + (double) deviation_m + 1.0)*(1 << deviation_e) / ((double) (1 << 17)));
-    printf("set rx f_dev: [%u %u] %u\n", deviation_e, deviation_m, f_dev_calculated);
+    printf("set %s f_dev: [%u %u] %u\n", radio->name, deviation_e, deviation_m, f_dev_calculated);
 
     // DEVIATN
-    RF_setting set = {.address = 0x15, .value = ((deviation_e & 0x07) << 4) + (deviation_m & 0x07)};
-    write_register_rx(set);
+    cc2500_write_register(radio, 0x15, ((deviation_e & 0x07) << 4) + (deviation_m & 0x07));
     return f_dev_calculated;
 }
 
-uint32_t set_frecuency_rx(uint32_t f_carrier)
+uint32_t cc2500_set_frequency(CC2500 *radio, uint32_t f_carrier)
 {
-// Test read_register_rx
-//    RF_setting a = {.address = 0x13, .value = 0xab};
-//    write_register_rx(a);
-//    RF_setting b = read_register_rx(0x13);
-//    printf("debug return %02x\n", b.value);
-    
-    write_strobe_rx(SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_strobe(radio, SIDLE); // ensure IDLE mode with command strobe: SIDLE
+    cc2500_wait_idle(radio);
+
     // see datasheet, section 21
     // approach: chose start frequency as close as possible to f_carrier, correct with channel
-    uint32_t freq = floor(f_carrier *((double) (1 << 16)) / ((double) F_XOSC));
+    uint32_t freq = frequency_word(f_carrier);
     uint8_t channel = 0;
     uint8_t channspc_e = 0;
-    uint8_t channspc_m = floor(((((double) f_carrier) * (1 << 16)) / ((double) F_XOSC) - freq - (1 << 6)) * (1 << 2));
+    uint8_t channspc_m = channel_spacing_m(f_carrier);
 
-    // print new value
-    uint32_t f_carrier_calculated = floor(((double) F_XOSC) * (freq + (double) channel*(256+channspc_m)/((double) (1 << 2))) / ((double) (1 << 16)));
-    printf("set rx f_carrier [%u %u %u %u] %u\n", freq, channel, channspc_e, channspc_m, f_carrier_calculated);
-    
-    // CHANNR, FREQ2, FREQ1, FREQ0, MDMCFG1, MDMCFG1
-    RF_setting mdmcfg1 = read_register_rx(0x13);
+    // print new value (channel = 0)
+    uint32_t f_carrier_calculated = frequency_of_word(freq);
+    printf("set %s f_carrier [%u %u %u %u] %u\n", radio->name, freq, channel, channspc_e, channspc_m, f_carrier_calculated);
+
+    // CHANNR, FREQ2, FREQ1, FREQ0, MDMCFG1, MDMCFG0
+    uint8_t mdmcfg1 = cc2500_read_register(radio, 0x13);
     RF_setting set[6] = {
         {.address = 0x0a, .value = channel},
         {.address = 0x0d, .value = ((freq & 0x007f0000) >> 16)},
         {.address = 0x0e, .value = ((freq & 0x0000ff00) >> 8)},
         {.address = 0x0f, .value = (freq & 0x000000ff)},
-        {.address = 0x13, .value = (mdmcfg1.value & 0xf0) + (channspc_e & 0x03)},
+        {.address = 0x13, .value = (mdmcfg1 & 0xf0) + (channspc_e & 0x03)},
         {.address = 0x14, .value = channspc_m}
     };
-    //printf("debug %02x %02x %02x %02x %02x %02x\n", set[0].value, set[1].value, set[2].value, set[3].value, set[4].value, set[5].value);
-    write_registers_rx(set,6);
+    cc2500_write_registers(radio, set, 6);
     return f_carrier_calculated;
 }
+
+uint32_t set_datarate_rx(uint32_t r_data)
+{
+    return cc2500_set_datarate(&radio_rx, r_data);
+}
+
+uint32_t set_filter_bandwidth_rx(uint32_t bw)
+{
+    return cc2500_set_filter_bandwidth(&radio_rx, bw);
+}
+
+uint32_t set_frequency_deviation_rx(uint32_t f_dev)
+{
+    return cc2500_set_frequency_deviation(&radio_rx, f_dev);
+}
+
+uint32_t set_frecuency_rx(uint32_t f_carrier)
+{
+    return cc2500_set_frequency(&radio_rx, f_carrier);
+}
+
+/*
+ * Register field computations (integer only, no soft-float or libm on the M0+).
+ * The results are identical to the former double based formulas
+ *   e = floor(log2(...)), m = floor(...)
+ * for r_data >= 25 Baud, 1 Hz <= bw <= 812500 Hz and f_dev >= 1587 Hz (below, e would be negative).
+ * floor(log2(x)) is obtained as the largest e for which 2^e <= x holds.
+ */
+
+// see datasheet, section 12: R_data = (256+DRATE_M)*2^DRATE_E/2^28 * F_XOSC
+uint32_t datarate_fields(uint32_t r_data, uint8_t *drate_e, uint8_t *drate_m)
+{
+    uint8_t e = 0;
+    while(((uint64_t) F_XOSC << (e+1)) <= ((uint64_t) r_data << 20)){
+        e++;
+    }
+    *drate_e = e;
+    *drate_m = (uint8_t) ((((uint64_t) r_data << 28) / ((uint64_t) F_XOSC << e)) - 256);
+    return (uint32_t) ((((uint64_t) (256 + *drate_m) << e) * F_XOSC) >> 28);
+}
+
+// see datasheet, section 13: BW_channel = F_XOSC / (8*(4+CHANBW_M)*2^CHANBW_E)
+uint32_t filter_bandwidth_fields(uint32_t bw, uint8_t *chanbw_e, uint8_t *chanbw_m)
+{
+    uint8_t e = 0;
+    while((((uint64_t) bw << 5) << (e+1)) <= F_XOSC){
+        e++;
+    }
+    *chanbw_e = e;
+    *chanbw_m = (uint8_t) (F_XOSC / (((uint64_t) bw << 3) << e) - 4);
+    return (uint32_t) (F_XOSC / (((uint64_t) (4 + *chanbw_m) << 3) << e));
+}
+
+// see datasheet, section 16: f_dev = F_XOSC/2^17 * (8+DEVIATION_M)*2^DEVIATION_E (the returned value keeps the former +1)
+uint32_t deviation_fields(uint32_t f_dev, uint8_t *deviation_e, uint8_t *deviation_m)
+{
+    uint8_t e = 0;
+    while(((uint64_t) F_XOSC << (e+1)) <= ((uint64_t) f_dev << 14)){
+        e++;
+    }
+    *deviation_e = e;
+    *deviation_m = (uint8_t) ((((uint64_t) f_dev << 17) / ((uint64_t) F_XOSC << e)) - 8);
+    return (uint32_t) ((((uint64_t) F_XOSC * (8 + *deviation_m + 1)) << e) >> 17);
+}
+
+// see datasheet, section 21: f_carrier = F_XOSC/2^16 * FREQ
+uint32_t frequency_word(uint32_t f_carrier)
+{
+    return (uint32_t) (((uint64_t) f_carrier << 16) / F_XOSC);
+}
+
+uint32_t frequency_of_word(uint32_t freq)
+{
+    return (uint32_t) (((uint64_t) F_XOSC * freq) >> 16);
+}
+
+// remaining fraction of the frequency word in quarters (as written to MDMCFG0 with CHANNR = 0)
+uint8_t channel_spacing_m(uint32_t f_carrier)
+{
+    return (uint8_t) (((((uint64_t) f_carrier << 16) % F_XOSC) << 2) / F_XOSC);
+}
+
+/*
+ * Radio profiles:
+ * The synthesizer calibration (FS_AUTOCAL in MCSM0) takes ~720us at every IDLE->RX transition.
+ * Instead, each channel is calibrated once and the resulting FSCAL3/2/1 values are cached together
+ * with the remaining register block (FREQ2 ... FSCAL1). Switching to another channel then only
+ * requires one burst write (datasheet, section 28.2: frequency hopping without calibration).
+ */
+uint32_t calibrate_profile_rx(RF_profile *profile, uint32_t f_carrier)
+{
+    uint32_t freq = frequency_word(f_carrier);
+    strobe_rx(SIDLE);
+    wait_idle_rx();
+
+    // start from the currently configured modem settings (CHANNR = 0 is expected)
+    read_burst_rx(PROFILE_FIRST_REGISTER, profile->registers, PROFILE_BLOCK_SIZE);
+    profile->registers[PROFILE_REG(0x0D)] = (freq & 0x007f0000) >> 16;
+    profile->registers[PROFILE_REG(0x0E)] = (freq & 0x0000ff00) >> 8;
+    profile->registers[PROFILE_REG(0x0F)] = (freq & 0x000000ff);
+    profile->registers[PROFILE_REG(0x18)] &= 0xCF; // MCSM0: FS_AUTOCAL = 0 (never calibrate automatically)
+    write_burst_rx(PROFILE_FIRST_REGISTER, profile->registers, PROFILE_BLOCK_SIZE);
+
+    // calibrate once and cache FSCAL3, FSCAL2, FSCAL1
+    strobe_rx(SCAL);
+    profile->calibrated = wait_idle_rx();
+    read_burst_rx(0x23, &profile->registers[PROFILE_REG(0x23)], 3);
+    profile->f_carrier = frequency_of_word(freq);
+    return profile->f_carrier;
+}
+
+uint8_t calibrate_profiles_rx(uint32_t f_start, uint32_t f_step, uint8_t count)
+{
+    uint8_t calibrated = 0;
+    write_register_rx((RF_setting){.address = 0x0a, .value = 0x00}); // CHANNR = 0
+    for(uint8_t i = 0; i < min(count, RX_PROFILE_COUNT); i++){
+        calibrate_profile_rx(&rx_profiles[i], f_start + i*f_step);
+        if(rx_profiles[i].calibrated){
+            calibrated++;
+        }
+    }
+    return calibrated;
+}
+
+bool select_profile_rx(const RF_profile *profile)
+{
+    if(!profile->calibrated){
+        return false;
+    }
+    strobe_rx(SIDLE); // frequency and calibration registers may only be changed in IDLE
+    wait_idle_rx();
+    write_burst_rx(PROFILE_FIRST_REGISTER, profile->registers, PROFILE_BLOCK_SIZE);
+    return true;
+}
+
+/*
+ * Automatic frequency tracking:
+ * FREQEST (datasheet, section 14.1) is the offset of the last packet relative to the current setting including FSCTRL0.
+ * A single estimate is noisy, therefore the estimates are averaged with an exponential filter and FSCTRL0 is
+ * only changed once the filtered residual exceeds half a step. The filter is then restarted since all following
+ * estimates are relative to the new FSCTRL0.
+ */
+void cc2500_afc_init(struct afc_state *afc, CC2500 *radio, bool enabled)
+{
+    memset(afc, 0, sizeof(struct afc_state));
+    afc->radio   = radio;
+    afc->enabled = enabled;
+    cc2500_write_register(radio, FSCTRL0, 0x00);
+}
+
+void afc_init_rx(struct afc_state *afc, bool enabled)
+{
+    cc2500_afc_init(afc, &radio_rx, enabled);
+}
+
+bool afc_update_rx(struct afc_state *afc, Packet_status status)
+{
+    if(!afc->enabled || status.overflowed || !status.CRCcheck){
+        return false;
+    }
+    int8_t estimate    = (int8_t) cc2500_read_status(afc->radio, FREQEST);
+    afc->last_estimate = estimate;
+    afc->filtered     += ((((int32_t) estimate) << 8) - afc->filtered) >> AFC_FILTER_SHIFT;
+    // round the residual to full FSCTRL0 steps
+    int32_t correction = (afc->filtered >= 0) ? ((afc->filtered + 128) >> 8) : -((-afc->filtered + 128) >> 8);
+    if(correction == 0){
+        return false;
+    }
+    int32_t freqoff = max(-AFC_MAX_FREQOFF, min(AFC_MAX_FREQOFF, afc->freqoff + correction));
+    if(freqoff == afc->freqoff){
+        return false; // at the limit: keep the estimate for the report
+    }
+    afc->freqoff  = (int8_t) freqoff;
+    afc->filtered = 0;
+    afc->updates++;
+    cc2500_write_register(afc->radio, FSCTRL0, (uint8_t) afc->freqoff);
+    return true;
+}
+
+void afc_set_offset_rx(struct afc_state *afc, int8_t freqoff)
+{
+    afc->freqoff  = (int8_t) max(-AFC_MAX_FREQOFF, min(AFC_MAX_FREQOFF, freqoff));
+    afc->filtered = 0;
+    cc2500_write_register(afc->radio, FSCTRL0, (uint8_t) afc->freqoff);
+}
+
+void afc_print_rx(const struct afc_state *afc)
+{
+    printf("afc | %s %s | FSCTRL0 %d (%d Hz) | last FREQEST %d (%d Hz) | updates %u\n", afc->radio->name, afc->enabled ? "enabled" : "disabled",
+           afc->freqoff, AFC_STEP_HZ(afc->freqoff), afc->last_estimate, AFC_STEP_HZ(afc->last_estimate), afc->updates);
+}
+
+/*
+ * Spectrum sweep:
+ * The synthesizer is stepped across the band with the same fast retuning as the profiles
+ * (cached FSCAL3/2/1, no calibration at IDLE->RX). The RSSI is measured with the current filter bandwidth.
+ */
+static int16_t rssi_dbm(uint8_t raw)
+{
+    // see datasheet, section 17.3 (same offset as readPacket)
+    if(raw >= 128){
+        return (((int16_t) raw) - 256)/2 - 70;
+    }
+    return ((int16_t) raw)/2 - 70;
+}
+
+static void calibrate_sweep_rx(uint32_t f_start, uint32_t f_step, uint8_t steps)
+{
+    if(sweep_cached_start == f_start && sweep_cached_step == f_step && sweep_cached_steps >= steps){
+        return;
+    }
+    for(uint8_t i = 0; i < steps; i++){
+        uint32_t freq = frequency_word(f_start + i*f_step);
+        sweep_points[i].freq[0] = (freq & 0x007f0000) >> 16;
+        sweep_points[i].freq[1] = (freq & 0x0000ff00) >> 8;
+        sweep_points[i].freq[2] = (freq & 0x000000ff);
+        write_burst_rx(0x0D, sweep_points[i].freq, 3);
+        strobe_rx(SCAL);
+        wait_idle_rx();
+        read_burst_rx(0x23, sweep_points[i].fscal, 3);
+    }
+    sweep_cached_start = f_start;
+    sweep_cached_step  = f_step;
+    sweep_cached_steps = steps;
+}
+
+uint8_t sweep_spectrum_rx(struct spectrum_sweep *sweep, uint32_t f_start, uint32_t f_step, uint8_t steps, uint8_t passes, uint32_t dwell_us)
+{
+    steps = min(steps, SWEEP_MAX_STEPS);
+    sweep->f_start = f_start;
+    sweep->f_step  = f_step;
+    sweep->steps   = steps;
+    for(uint8_t i = 0; i < steps; i++){
+        sweep->rssi[i] = INT16_MIN;
+    }
+
+    // keep the current configuration
+    uint8_t channr, freq[3], mcsm0, fscal[3];
+    strobe_rx(SIDLE);
+    wait_idle_rx();
+    read_burst_rx(0x0A, &channr, 1);
+    read_burst_rx(0x0D, freq, 3);
+    read_burst_rx(0x18, &mcsm0, 1);
+    read_burst_rx(0x23, fscal, 3);
+
+    uint8_t value = 0x00;
+    write_burst_rx(0x0A, &value, 1);        // CHANNR = 0
+    value = mcsm0 & 0xCF;
+    write_burst_rx(0x18, &value, 1);        // MCSM0: FS_AUTOCAL = 0
+    calibrate_sweep_rx(f_start, f_step, steps);
+
+    for(uint8_t pass = 0; pass < passes; pass++){
+        for(uint8_t i = 0; i < steps; i++){
+            write_burst_rx(0x0D, sweep_points[i].freq, 3);
+            write_burst_rx(0x23, sweep_points[i].fscal, 3);
+            strobe_rx(SRX);
+            cc2500_sync(&radio_rx);
+            sleep_us(SWEEP_SETTLE_US);
+            absolute_time_t dwell_end = delayed_by_us(get_absolute_time(), dwell_us);
+            do{
+                sweep->rssi[i] = max(sweep->rssi[i], rssi_dbm(read_status_rx(RSSI_STATUS)));
+            }while(!time_reached(dwell_end));
+            strobe_rx(SIDLE);
+            wait_idle_rx();
+        }
+    }
+
+    // restore the previous configuration
+    write_burst_rx(0x0A, &channr, 1);
+    write_burst_rx(0x0D, freq, 3);
+    write_burst_rx(0x18, &mcsm0, 1);
+    write_burst_rx(0x23, fscal, 3);
+    strobe_rx(SFRX);
+    return steps;
+}
+
+struct subcarrier_lock find_subcarrier_rx(const struct spectrum_sweep *sweep, uint32_t f_carrier)
+{
+    struct subcarrier_lock lock = {.found = false};
+    int16_t peak = INT16_MIN;
+    uint8_t peak_index = 0;
+    uint8_t upper = sweep->steps; // first bin of the upper sideband
+    lock.noise_floor = INT16_MAX;
+
+    // noise floor outside of the carrier guard, strongest bin above it (the lower sideband carries swapped FSK tones)
+    for(uint8_t i = 0; i < sweep->steps; i++){
+        uint32_t f = sweep->f_start + i*sweep->f_step;
+        uint32_t distance = (f > f_carrier) ? (f - f_carrier) : (f_carrier - f);
+        if(distance < SWEEP_CARRIER_GUARD){
+            continue;
+        }
+        lock.noise_floor = min(lock.noise_floor, sweep->rssi[i]);
+        if(f < f_carrier){
+            continue;
+        }
+        upper = min(upper, i);
+        if(sweep->rssi[i] > peak){
+            peak = sweep->rssi[i];
+            peak_index = i;
+        }
+    }
+    if(peak == INT16_MIN || peak - lock.noise_floor < SWEEP_MIN_SNR_DB){
+        return lock;
+    }
+
+    // centroid of the lobe (both FSK tones), weighted with the level above the noise floor
+    uint8_t first = peak_index, last = peak_index;
+    while(first > upper && sweep->rssi[first-1] >= peak - SWEEP_LOBE_DB){
+        first--;
+    }
+    while(last+1 < sweep->steps && sweep->rssi[last+1] >= peak - SWEEP_LOBE_DB){
+        last++;
+    }
+    uint64_t weighted = 0;
+    uint32_t weights  = 0;
+    for(uint8_t i = first; i <= last; i++){
+        uint32_t w = sweep->rssi[i] - lock.noise_floor + 1;
+        weighted += (uint64_t) w * i;
+        weights  += w;
+    }
+    lock.f_subcarrier = sweep->f_start + (uint32_t) ((weighted * sweep->f_step + weights/2) / weights);
+    lock.rssi         = peak;
+    lock.found        = true;
+
+    // the mirror image: the lower sideband
+    lock.f_mirror    = 2*f_carrier - lock.f_subcarrier;
+    lock.mirror_rssi = INT16_MIN;
+    if(lock.f_mirror >= sweep->f_start && sweep->f_step > 0){
+        uint32_t i = (lock.f_mirror - sweep->f_start + sweep->f_step/2) / sweep->f_step;
+        if(i < sweep->steps){
+            lock.mirror_rssi = sweep->rssi[i];
+        }
+    }
+    return lock;
+}
+
+void print_spectrum_rx(const struct spectrum_sweep *sweep)
+{
+    for(uint8_t i = 0; i < sweep->steps; i++){
+        printf("sweep | %u %d\n", sweep->f_start + i*sweep->f_step, sweep->rssi[i]);
+    }
+}
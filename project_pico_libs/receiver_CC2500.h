@@ -23,6 +23,7 @@
 #include "pico/util/queue.h"
 #include "pico/binary_info.h"
 #include "hardware/spi.h"
+#include "cc2500.h"
 
 #define RADIO_SPI             spi0
 #define RADIO_MISO              16
@@ -39,6 +40,13 @@
 #define   SRX                 0x34
 #define  SFRX                 0x3A
 #define  SRES                 0x30
+#define  SCAL                 0x33
+
+#define MARCSTATE             0x35
+#define MARCSTATE_IDLE        0x01
+#define RSSI_STATUS           0x34
+#define FREQEST               0x32
+#define FSCTRL0               0x0C
 
 #define F_XOSC            26000000
 
@@ -57,23 +65,65 @@ struct rf_setting {
 typedef struct rf_setting RF_setting;
 #endif
 
-struct packet_status {
-  bool overflowed;
-  uint8_t len;
-  int32_t RSSI;
-  bool CRCcheck;
-  uint8_t LinkQualityIndicator;
+#ifndef RF_PROFILE
+#define RF_PROFILE
+/* 
+ * A profile is a snapshot of the register block FREQ2 (0x0D) ... FSCAL1 (0x25).
+ * It contains the frequency word, the modem settings and the cached synthesizer calibration (FSCAL3/2/1).
+ * Switching to a profile is one burst write without a calibration step (see datasheet, section 19.2 & 28.2).
+ */
+#define PROFILE_FIRST_REGISTER  0x0D // FREQ2
+#define PROFILE_LAST_REGISTER   0x25 // FSCAL1
+#define PROFILE_BLOCK_SIZE      (PROFILE_LAST_REGISTER - PROFILE_FIRST_REGISTER + 1)
+#define PROFILE_REG(address)    ((address) - PROFILE_FIRST_REGISTER)
+struct rf_profile {
+  uint32_t f_carrier;                       // resulting carrier frequency [Hz]
+  uint8_t  registers[PROFILE_BLOCK_SIZE];   // FREQ2 ... FSCAL1
+  bool     calibrated;
 };
-typedef struct rf_setting RF_setting;
-typedef struct rf_power RF_power;
-typedef struct packet_status Packet_status;
+typedef struct rf_profile RF_profile;
+#endif
+
+#define RX_PROFILE_COUNT        16
+
+/* spectrum sweep (see sweep_spectrum_rx) */
+#define SWEEP_MAX_STEPS        128
+#define SWEEP_SETTLE_US        300 // IDLE->RX without calibration and RSSI estimate (datasheet, section 17.3)
+#define SWEEP_CARRIER_GUARD 1500000 // Hz around the carrier which are not considered as subcarrier
+#define SWEEP_LOBE_DB            6 // bins within this range of the peak contribute to the centroid
+#define SWEEP_MIN_SNR_DB         6 // minimal peak above the noise floor
+
+struct spectrum_sweep {
+  uint32_t f_start;                  // frequency of the first step [Hz]
+  uint32_t f_step;                   // [Hz]
+  uint8_t  steps;
+  int16_t  rssi[SWEEP_MAX_STEPS];    // peak hold over all passes [dBm]
+};
+
+struct subcarrier_lock {
+  bool     found;
+  uint32_t f_subcarrier;  // centroid of the upper sideband [Hz]
+  int16_t  rssi;          // peak RSSI of the upper sideband [dBm]
+  uint32_t f_mirror;      // expected mirror image (2*f_carrier - f_subcarrier) [Hz]
+  int16_t  mirror_rssi;   // [dBm]
+  int16_t  noise_floor;   // [dBm]
+};
+
+/* automatic frequency tracking (see afc_update_rx) */
+#define AFC_FILTER_SHIFT         2 // exponential filter of FREQEST: 1/4 of each new estimate
+#define AFC_MAX_FREQOFF         48 // limit of FSCTRL0 [F_XOSC/2^14 = 1587 Hz steps], i.e. +-76kHz
+#define AFC_STEP_HZ(x)          ((int32_t) ((((int64_t) F_XOSC) * (x)) >> 14))
 
-/* Event queue */
-typedef enum _event_t{
-    no_evt          = 0,
-    rx_assert_evt   = 1,
-    rx_deassert_evt = 2
-} event_t;
+struct afc_state {
+  CC2500  *radio;
+  bool     enabled;
+  int32_t  filtered;      // filtered residual offset (FREQEST steps, Q8 fixed point)
+  int8_t   freqoff;       // currently applied FSCTRL0
+  int8_t   last_estimate; // last FREQEST
+  uint32_t updates;       // FSCTRL0 writes
+};
+
+typedef struct rf_power RF_power;
 
 // Address Config = No address check 
 // Base Frequency = 2456.596924 
@@ -99,6 +149,11 @@ typedef enum _event_t{
 
 extern RF_setting cc2500_receiver[20];
 
+extern RF_profile rx_profiles[RX_PROFILE_COUNT];
+
+// default receiver instance (RX_CSN, RX_GDO0_PIN) used by the ..._rx functions
+extern CC2500 radio_rx;
+
 void cs_select_rx();
 
 void cs_deselect_rx();
@@ -109,6 +164,14 @@ void write_register_rx(RF_setting set);
 
 void write_registers_rx(RF_setting* sets, uint8_t len);
 
+void write_burst_rx(uint8_t address, const uint8_t *values, uint8_t len);
+
+void read_burst_rx(uint8_t address, uint8_t *values, uint8_t len);
+
+RF_setting read_register_rx(uint8_t address);
+
+uint8_t read_status_rx(uint8_t address);
+
 /* ISR */
 void receiver_isr(uint gpio, uint32_t events);
 
@@ -128,6 +191,21 @@ void printPacket(uint8_t *packet, Packet_status status, uint64_t time_us);
 
 event_t get_event(void);
 
+/* receiver functions for any radio instance (e.g. several receivers, see diversity.h) */
+void cc2500_setup_receiver(CC2500 *radio);
+
+void cc2500_start_listen(CC2500 *radio);
+
+void cc2500_stop_listen(CC2500 *radio);
+
+uint32_t cc2500_set_datarate(CC2500 *radio, uint32_t r_data);
+
+uint32_t cc2500_set_filter_bandwidth(CC2500 *radio, uint32_t bw);
+
+uint32_t cc2500_set_frequency_deviation(CC2500 *radio, uint32_t f_dev);
+
+uint32_t cc2500_set_frequency(CC2500 *radio, uint32_t f_carrier);
+
 //set datarate [baud]
 uint32_t set_datarate_rx(uint32_t r_data);
 
@@ -140,4 +218,63 @@ uint32_t set_frequency_deviation_rx(uint32_t f_dev);
 //set carrier frequency [Hz]
 uint32_t set_frecuency_rx(uint32_t f_carrier);
 
+/* integer register field computations, returning the resulting value */
+uint32_t datarate_fields(uint32_t r_data, uint8_t *drate_e, uint8_t *drate_m);
+
+uint32_t filter_bandwidth_fields(uint32_t bw, uint8_t *chanbw_e, uint8_t *chanbw_m);
+
+uint32_t deviation_fields(uint32_t f_dev, uint8_t *deviation_e, uint8_t *deviation_m);
+
+// frequency control word FREQ[23:0] for the carrier f_carrier [Hz] (CHANNR = 0)
+uint32_t frequency_word(uint32_t f_carrier);
+
+// carrier frequency [Hz] of the frequency control word
+uint32_t frequency_of_word(uint32_t freq);
+
+uint8_t channel_spacing_m(uint32_t f_carrier);
+
+// capture the current modem settings at f_carrier [Hz] and calibrate the synthesizer once
+uint32_t calibrate_profile_rx(RF_profile *profile, uint32_t f_carrier);
+
+// fill rx_profiles[0..count-1] with the channels f_start + i*f_step [Hz], returns the number of calibrated profiles
+uint8_t calibrate_profiles_rx(uint32_t f_start, uint32_t f_step, uint8_t count);
+
+// switch to a calibrated profile (one burst write, no calibration). The receiver is left in IDLE.
+bool select_profile_rx(const RF_profile *profile);
+
+/*
+ * Automatic frequency tracking: the tag subcarrier (RP2040 crystal) and the carrier (CC2500 crystal) drift with
+ * temperature, while FOCCFG only compensates within a packet. After each CRC-valid packet, FREQEST is filtered and
+ * the receiver offset FSCTRL0 is adjusted between packets (the radio has to be in IDLE, i.e. before RX_start_listen).
+ */
+void afc_init_rx(struct afc_state *afc, bool enabled);
+
+void cc2500_afc_init(struct afc_state *afc, CC2500 *radio, bool enabled);
+
+// returns true if FSCTRL0 has been updated
+bool afc_update_rx(struct afc_state *afc, Packet_status status);
+
+void afc_print_rx(const struct afc_state *afc);
+
+// start the tracking from a fixed FSCTRL0 offset (e.g. a calibration), limited to +-AFC_MAX_FREQOFF
+void afc_set_offset_rx(struct afc_state *afc, int8_t freqoff);
+
+/*
+ * measure the RSSI at f_start + i*f_step (i < steps) with peak hold over several passes
+ * Per pass, each step samples the RSSI for dwell_us. The tag only backscatters while sending a frame: passes * dwell_us
+ * has to cover at least one TX period of the tag (plus one frame) for every step to see a frame.
+ * Each step is calibrated once (cached until the sweep range changes). The receiver is left in IDLE with
+ * its previous frequency and calibration settings.
+ */
+uint8_t sweep_spectrum_rx(struct spectrum_sweep *sweep, uint32_t f_start, uint32_t f_step, uint8_t steps, uint8_t passes, uint32_t dwell_us);
+
+/*
+ * find the upper backscatter sideband of the carrier f_carrier [Hz] in the spectrum
+ * The double-sideband tag produces near-equal lobes at f_carrier +- f_subcarrier, but the lower one carries the FSK
+ * tones swapped (every bit inverted): it is only reported as mirror.
+ */
+struct subcarrier_lock find_subcarrier_rx(const struct spectrum_sweep *sweep, uint32_t f_carrier);
+
+void print_spectrum_rx(const struct spectrum_sweep *sweep);
+
 #endif
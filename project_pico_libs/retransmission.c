@@ -0,0 +1,112 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Selective retransmission (see retransmission.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "retransmission.h"
+
+void arq_init(struct arq *arq, bool enabled, uint64_t time_us) {
+    memset(arq, 0, sizeof(struct arq));
+    arq->enabled  = enabled;
+    arq->start_us = time_us;
+}
+
+static void enqueue(struct arq *arq, uint8_t seq) {
+    if(arq->queue_level >= ARQ_QUEUE_LENGTH){
+        arq->state[seq] = ARQ_FREE;
+        arq->counters.failed++;
+        return;
+    }
+    arq->queue[(arq->queue_head + arq->queue_level) % ARQ_QUEUE_LENGTH] = seq;
+    arq->queue_level++;
+    arq->state[seq] = ARQ_QUEUED;
+}
+
+static bool dequeue(struct arq *arq, uint8_t *seq) {
+    while(arq->queue_level > 0){
+        *seq = arq->queue[arq->queue_head];
+        arq->queue_head = (arq->queue_head + 1) % ARQ_QUEUE_LENGTH;
+        arq->queue_level--;
+        if(arq->state[*seq] == ARQ_QUEUED){ // skip entries which have been abandoned meanwhile
+            return true;
+        }
+    }
+    return false;
+}
+
+// the previous frame was not received (in time): retransmit it if the budget allows
+static void resolve_last(struct arq *arq) {
+    if(!arq->last_valid || arq->state[arq->last_seq] != ARQ_IN_FLIGHT){
+        return;
+    }
+    if(arq->attempts[arq->last_seq] < ARQ_MAX_ATTEMPTS){
+        enqueue(arq, arq->last_seq);
+    }else{
+        arq->state[arq->last_seq] = ARQ_FREE;
+        arq->counters.failed++;
+    }
+}
+
+uint8_t arq_next_frame(struct arq *arq, bool *retransmission) {
+    resolve_last(arq);
+    uint8_t seq;
+    *retransmission = false;
+    if(arq->retransmit_turns < ARQ_INTERLEAVE && dequeue(arq, &seq)){
+        *retransmission = true;
+        arq->retransmit_turns++;
+        arq->counters.retransmissions++;
+    }else{
+        seq = arq->next_seq++;
+        if(arq->state[seq] == ARQ_QUEUED || arq->state[seq] == ARQ_IN_FLIGHT){
+            arq->counters.failed++; // sequence number reused before the old frame was delivered
+        }
+        arq->attempts[seq]     = 0;
+        arq->retransmit_turns  = 0;
+        arq->counters.frames++;
+    }
+    arq->state[seq] = ARQ_IN_FLIGHT;
+    arq->attempts[seq]++;
+    arq->counters.transmissions++;
+    arq->last_seq   = seq;
+    arq->last_valid = true;
+    return seq;
+}
+
+void arq_received(struct arq *arq, const uint8_t *packet, Packet_status status) {
+    if(status.overflowed || !status.CRCcheck){
+        return; // resolved at the next TX slot
+    }
+    uint8_t seq = packet[1];
+    switch(arq->state[seq]){
+        case ARQ_IN_FLIGHT:
+        case ARQ_QUEUED:
+            arq->state[seq] = ARQ_DELIVERED;
+            if(arq->attempts[seq] <= 1){
+                arq->counters.delivered_first++;
+            }else{
+                arq->counters.delivered_retry++;
+            }
+            break;
+        case ARQ_DELIVERED:
+            arq->counters.duplicates++;
+            break;
+        default:
+            break;
+    }
+}
+
+void arq_report(struct arq *arq, uint64_t time_us, uint32_t payload_len) {
+    struct arq_counters *c = &arq->counters;
+    uint32_t delivered = c->delivered_first + c->delivered_retry;
+    uint64_t elapsed   = (time_us > arq->start_us) ? (time_us - arq->start_us) : 1;
+    uint32_t goodput   = (uint32_t) (((uint64_t) delivered * payload_len * 8 * 1000000) / elapsed);
+    printf("arq | %s | frames %u transmissions %u retransmissions %u | delivered first-try %u after-retry %u | failed %u duplicates %u queued %u | goodput %u bit/s\n",
+           arq->enabled ? "enabled" : "disabled", c->frames, c->transmissions, c->retransmissions, c->delivered_first, c->delivered_retry,
+           c->failed, c->duplicates, arq->queue_level, goodput);
+}
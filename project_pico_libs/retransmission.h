@@ -0,0 +1,67 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Selective retransmission for the combined board (carrier-receiver-baseband): the board knows which
+ * sequence numbers it sent and which of them arrived with a valid CRC. A frame which was not received
+ * correctly until the next TX slot is put into the retransmission queue and resent with the same sequence
+ * number, interleaved with new frames (ARQ_INTERLEAVE retransmissions per new frame), until it is
+ * delivered or ARQ_MAX_ATTEMPTS transmissions have been used.
+ *
+ */
+
+#ifndef RETRANSMISSION_LIB
+#define RETRANSMISSION_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+
+#define ARQ_MAX_ATTEMPTS     4 // first transmission + 3 retransmissions
+#define ARQ_QUEUE_LENGTH    16
+#define ARQ_INTERLEAVE       1 // retransmissions between two new frames
+
+enum arq_frame_state {
+  ARQ_FREE = 0,
+  ARQ_IN_FLIGHT,   // sent, outcome not yet known
+  ARQ_QUEUED,      // waiting for a retransmission
+  ARQ_DELIVERED
+};
+
+struct arq_counters {
+  uint32_t frames;            // new frames
+  uint32_t transmissions;     // incl. retransmissions
+  uint32_t retransmissions;
+  uint32_t delivered_first;   // delivered with the first transmission
+  uint32_t delivered_retry;   // delivered after at least one retransmission
+  uint32_t failed;            // retry budget exhausted or dropped (queue full)
+  uint32_t duplicates;        // received again after delivery
+};
+
+struct arq {
+  bool     enabled;
+  uint8_t  next_seq;
+  uint8_t  state[256];        // per sequence number
+  uint8_t  attempts[256];
+  uint8_t  queue[ARQ_QUEUE_LENGTH];
+  uint8_t  queue_head;
+  uint8_t  queue_level;
+  bool     last_valid;
+  uint8_t  last_seq;
+  uint8_t  retransmit_turns;  // retransmissions since the last new frame
+  uint64_t start_us;
+  struct arq_counters counters;
+};
+
+void arq_init(struct arq *arq, bool enabled, uint64_t time_us);
+
+/* sequence number of the next frame to send (resolves the outcome of the previous frame first) */
+uint8_t arq_next_frame(struct arq *arq, bool *retransmission);
+
+/* a frame has been received */
+void arq_received(struct arq *arq, const uint8_t *packet, Packet_status status);
+
+/* print the counters and the reliable goodput (delivered payload bits per second) */
+void arq_report(struct arq *arq, uint64_t time_us, uint32_t payload_len);
+
+#endif
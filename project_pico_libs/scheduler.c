@@ -0,0 +1,148 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Cooperative scheduler (see scheduler.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "scheduler.h"
+#include "trace.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+static void release(struct task *task, uint64_t time_us, bool period) {
+    if(task->pending){
+        if(period && task->period_pending){
+            task->stats.overruns++; // the previous period has not been served yet
+        }
+        task->period_pending |= period;
+        return;                     // event releases: the task serves all events in one run
+    }
+    task->release_us     = time_us;
+    task->period_pending = period;
+    task->pending        = true;
+    __sev();
+}
+
+static bool timer_callback(repeating_timer_t *rt) {
+    release((struct task *) rt->user_data, time_us_64(), true);
+    return true;
+}
+
+void scheduler_init(struct scheduler *sched) {
+    memset(sched, 0, sizeof(struct scheduler));
+    sched->window_start_us = time_us_64();
+}
+
+int8_t scheduler_add_task(struct scheduler *sched, const char *name, task_function run, void *context, task_ready_check ready) {
+    if(sched->count >= SCHEDULER_MAX_TASKS){
+        return -1;
+    }
+    struct task *task = &sched->tasks[sched->count];
+    memset(task, 0, sizeof(struct task));
+    task->name    = name;
+    task->run     = run;
+    task->context = context;
+    task->ready   = ready;
+    return sched->count++;
+}
+
+bool scheduler_set_period(struct scheduler *sched, int8_t task, uint32_t period_us) {
+    struct task *t = &sched->tasks[task];
+    if(t->periodic){
+        cancel_repeating_timer(&t->timer);
+    }
+    // negative delay: period between the starts of the callbacks (no drift)
+    t->periodic = add_repeating_timer_us(-((int64_t) period_us), timer_callback, t, &t->timer);
+    return t->periodic;
+}
+
+void scheduler_release(struct scheduler *sched, int8_t task) {
+    release(&sched->tasks[task], time_us_64(), false);
+}
+
+static int64_t alarm_callback(alarm_id_t id, void *user_data) {
+    release((struct task *) user_data, time_us_64(), false);
+    return 0; // one-shot
+}
+
+bool scheduler_release_at(struct scheduler *sched, int8_t task, absolute_time_t time) {
+    return add_alarm_at(time, alarm_callback, &sched->tasks[task], true) >= 0;
+}
+
+static void run_task(struct scheduler *sched, struct task *task) {
+    // a release from now on runs the task again: take the release time and clear the flags together
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint64_t release_us  = task->release_us;
+    task->pending        = false;
+    task->period_pending = false;
+    restore_interrupts(interrupts);
+    uint64_t start = time_us_64();
+    uint32_t latency = (uint32_t) (start - release_us);
+    trace_add(TRACE_TASK_START, task - sched->tasks);
+    task->run(task->context);
+    trace_add(TRACE_TASK_END, task - sched->tasks);
+    uint32_t runtime = (uint32_t) (time_us_64() - start);
+
+    task->stats.runs++;
+    task->stats.sum_latency_us += latency;
+    task->stats.max_latency_us  = max(task->stats.max_latency_us, latency);
+    task->stats.sum_runtime_us += runtime;
+    task->stats.max_runtime_us  = max(task->stats.max_runtime_us, runtime);
+    sched->busy_us             += runtime;
+}
+
+void scheduler_run(struct scheduler *sched) {
+    while(true){
+        // tasks waiting for a condition (e.g. filled by the other core)
+        uint64_t now = time_us_64();
+        for(uint8_t i = 0; i < sched->count; i++){
+            struct task *task = &sched->tasks[i];
+            if(task->ready && !task->pending && task->ready()){
+                uint32_t interrupts = save_and_disable_interrupts();
+                if(!task->pending){
+                    task->release_us = now;
+                    task->pending    = true;
+                }
+                restore_interrupts(interrupts);
+            }
+        }
+        // run the pending task with the highest priority, then check again
+        struct task *next = NULL;
+        for(uint8_t i = 0; i < sched->count; i++){
+            if(sched->tasks[i].pending){
+                next = &sched->tasks[i];
+                break;
+            }
+        }
+        if(next != NULL){
+            run_task(sched, next);
+        }else{
+            __wfe(); // sleep until an interrupt or __sev() (an event set since the last __wfe returns immediately)
+        }
+    }
+}
+
+void scheduler_report(struct scheduler *sched) {
+    uint64_t now     = time_us_64();
+    uint64_t elapsed = max(now - sched->window_start_us, (uint64_t) 1);
+    uint32_t load    = (uint32_t) ((sched->busy_us * 10000) / elapsed);
+    printf("sched | window %u ms | load %u.%02u%%\n", (uint32_t) (elapsed / 1000), load / 100, load % 100);
+    for(uint8_t i = 0; i < sched->count; i++){
+        struct task_stats *s = &sched->tasks[i].stats;
+        printf("sched | %-8s runs %u overruns %u | latency [us] mean %u max %u | runtime [us] mean %u max %u\n", sched->tasks[i].name, s->runs, s->overruns,
+               s->runs ? (uint32_t) (s->sum_latency_us / s->runs) : 0, s->max_latency_us,
+               s->runs ? (uint32_t) (s->sum_runtime_us / s->runs) : 0, s->max_runtime_us);
+        memset(s, 0, sizeof(struct task_stats));
+    }
+    sched->window_start_us = time_us_64();
+    sched->busy_us         = 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Cooperative run-to-completion scheduler: tasks are released by hardware alarms (periodic or one-shot),
+ * by interrupt handlers (scheduler_release) or by a ready-check evaluated after every wake-up
+ * (e.g. a queue filled by the other core, which signals with __sev()). The core sleeps with __wfe()
+ * while no task is pending. The pending task with the lowest index runs first.
+ *
+ * Per task, the latency (release -> start), the runtime and the overruns (released by its period again
+ * before the previous period started, event releases meanwhile are merged and not counted) are recorded.
+ * The CPU load is the sum of the runtimes over the elapsed time.
+ *
+ */
+
+#ifndef SCHEDULER_LIB
+#define SCHEDULER_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#define SCHEDULER_MAX_TASKS     8
+
+typedef void (*task_function)(void *context);
+typedef bool (*task_ready_check)(void);
+
+struct task_stats {
+  uint32_t runs;
+  uint32_t overruns;
+  uint32_t max_latency_us;
+  uint64_t sum_latency_us;
+  uint32_t max_runtime_us;
+  uint64_t sum_runtime_us;
+};
+
+struct task {
+  const char       *name;
+  task_function     run;
+  void             *context;
+  task_ready_check  ready;        // optional: polled after every wake-up
+  volatile bool     pending;
+  volatile bool     period_pending; // the pending release includes one of the period
+  volatile uint64_t release_us;
+  repeating_timer_t timer;
+  bool              periodic;
+  struct task_stats stats;
+};
+
+struct scheduler {
+  struct task tasks[SCHEDULER_MAX_TASKS];
+  uint8_t     count;
+  uint64_t    window_start_us;
+  uint64_t    busy_us;             // runtime of all tasks since window_start_us
+};
+
+void scheduler_init(struct scheduler *sched);
+
+/* add a task (the order defines the priority), returns its index or -1 */
+int8_t scheduler_add_task(struct scheduler *sched, const char *name, task_function run, void *context, task_ready_check ready);
+
+/* release the task every period_us (hardware alarm, drift-free) */
+bool scheduler_set_period(struct scheduler *sched, int8_t task, uint32_t period_us);
+
+/* release a task (safe to call from interrupt handlers of this core) */
+void scheduler_release(struct scheduler *sched, int8_t task);
+
+/* release a task once at the given time (hardware alarm, released immediately if already past) */
+bool scheduler_release_at(struct scheduler *sched, int8_t task, absolute_time_t time);
+
+/* run the pending tasks, sleep otherwise - never returns */
+void scheduler_run(struct scheduler *sched);
+
+/* print the task statistics and the CPU load, then restart the statistics */
+void scheduler_report(struct scheduler *sched);
+
+#endif
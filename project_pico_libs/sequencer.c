@@ -0,0 +1,171 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Experiment sequencer (see sequencer.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "packet_generation.h"
+#include "bit_errors.h"
+#include "protocol.h"
+#include "sequencer.h"
+
+void seq_init(struct sequencer *seq, uint8_t pattern) {
+    memset(seq, 0, sizeof(struct sequencer));
+    seq->pattern = pattern;
+}
+
+bool seq_add_step(struct sequencer *seq, struct seq_step step) {
+    if(seq->running || seq->count >= SEQ_MAX_STEPS){
+        return false;
+    }
+    switch(step.type){
+        case SEQ_STEP_CONFIG:
+        case SEQ_STEP_POWER:
+        case SEQ_STEP_PAUSE:
+            break;
+        case SEQ_STEP_FRAMES:
+            if(step.arg[0] < 1 || step.arg[0] > SEQ_MAX_FRAMES || step.arg[1] < 1 || step.arg[1] > MAX_PAYLOADSIZE){
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+    seq->steps[seq->count++] = step;
+    return true;
+}
+
+void seq_clear(struct sequencer *seq) {
+    if(!seq->running){
+        seq->count = 0;
+    }
+}
+
+bool seq_start(struct sequencer *seq, uint32_t repeat, bool binary, uint64_t time_us) {
+    if(seq->running || seq->count == 0){
+        return false;
+    }
+    seq->repeat             = max(repeat, 1);
+    seq->binary             = binary;
+    seq->iteration          = 0;
+    seq->current            = 0;
+    seq->started            = false;
+    seq->iteration_start_us = time_us;
+    seq->running            = true;
+    return true;
+}
+
+void seq_stop(struct sequencer *seq) {
+    if(seq->running && !seq->binary){
+        printf("seq | aborted at iteration %u step %u\n", seq->iteration, seq->current);
+    }
+    seq->running = false;
+}
+
+const struct seq_step *seq_current(const struct sequencer *seq) {
+    return &seq->steps[seq->current];
+}
+
+uint64_t seq_due_us(const struct sequencer *seq) {
+    const struct seq_step *step = seq_current(seq);
+    return (step->start_us > 0) ? seq->iteration_start_us + step->start_us : 0;
+}
+
+void seq_step_begin(struct sequencer *seq, uint64_t time_us) {
+    const struct seq_step *step = seq_current(seq);
+    memset(&seq->result, 0, sizeof(struct seq_result));
+    seq->result.iteration = seq->iteration;
+    seq->result.step      = seq->current;
+    seq->result.type      = step->type;
+    seq->result.start_us  = (uint32_t) (time_us - seq->iteration_start_us);
+    seq->result.late_us   = (step->start_us > 0 && seq->result.start_us > step->start_us) ? seq->result.start_us - step->start_us : 0;
+    seq->rssi_sum         = 0;
+    seq->step_start_us    = time_us;
+    seq->started          = true;
+    if(step->type == SEQ_STEP_FRAMES){
+        ber_init(&seq->ber, BER_FIXED_PATTERN, seq->pattern, step->arg[1]);
+    }
+}
+
+void seq_step_rejected(struct sequencer *seq) {
+    seq->result.status = 1;
+}
+
+void seq_sent(struct sequencer *seq) {
+    seq->result.sent++;
+}
+
+void seq_received(struct sequencer *seq, const uint8_t *packet, Packet_status status) {
+    seq->result.received++;
+    if(!status.overflowed && status.CRCcheck){
+        seq->result.crc_pass++;
+    }
+    seq->rssi_sum += status.RSSI;
+    ber_add_frame(&seq->ber, packet, status);
+}
+
+uint64_t seq_step_end_us(const struct sequencer *seq) {
+    const struct seq_step *step = seq_current(seq);
+    return (step->type == SEQ_STEP_PAUSE) ? seq->step_start_us + step->arg[0] : 0;
+}
+
+bool seq_step_done(const struct sequencer *seq, uint64_t time_us) {
+    const struct seq_step *step = seq_current(seq);
+    switch(step->type){
+        case SEQ_STEP_FRAMES:
+            return seq->result.status != 0 || seq->result.sent >= step->arg[0];
+        case SEQ_STEP_PAUSE:
+            return time_us >= seq_step_end_us(seq);
+        default:
+            return true;
+    }
+}
+
+static void seq_report(struct sequencer *seq) {
+    struct seq_result *r = &seq->result;
+    if(seq->binary){
+        uint32_t values[13] = {r->iteration, r->step, r->type, r->status, r->start_us, r->late_us, r->duration_us,
+                               r->sent, r->received, r->crc_pass, r->bit_errors, r->bits, (uint32_t) r->rssi};
+        protocol_send_values(PROTOCOL_RESULT, seq->result_seq++, values, 13);
+        return;
+    }
+    printf("seq | iteration %u step %u type %u%s | start %u us late %u us duration %u us", r->iteration, r->step, r->type,
+           r->status ? " rejected" : "", r->start_us, r->late_us, r->duration_us);
+    if(r->type == SEQ_STEP_FRAMES){
+        printf(" | sent %u recv %u crc-ok %u | bit errors %u of %u | RSSI %d", r->sent, r->received, r->crc_pass, r->bit_errors, r->bits, r->rssi);
+    }
+    printf("\n");
+}
+
+bool seq_next_step(struct sequencer *seq, uint64_t time_us) {
+    struct seq_result *r = &seq->result;
+    r->duration_us = (uint32_t) (time_us - seq->step_start_us);
+    r->bit_errors  = (uint32_t) seq->ber.counters.bit_errors;
+    r->bits        = (uint32_t) seq->ber.counters.bits;
+    r->rssi        = (r->received > 0) ? seq->rssi_sum / (int32_t) r->received : 0;
+    if(r->type != SEQ_STEP_FRAMES){
+        r->bit_errors = 0;
+        r->bits       = 0;
+    }
+    seq_report(seq);
+
+    seq->started = false;
+    seq->current++;
+    if(seq->current >= seq->count){
+        seq->current = 0;
+        seq->iteration++;
+        seq->iteration_start_us = time_us;
+        if(seq->iteration >= seq->repeat){
+            seq->running = false;
+            if(!seq->binary){
+                printf("seq | done (%u iterations)\n", seq->iteration);
+            }
+        }
+    }
+    return seq->running;
+}
@@ -0,0 +1,111 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Experiment sequencer for the combined board (carrier-receiver-baseband): an uploaded list of steps is
+ * executed on the board, optionally repeated (e.g. to alternate two configurations under the same channel
+ * conditions). A step starts at its offset from the start of the iteration (0: right after the previous
+ * step). The board sleeps until shortly before the start (hardware alarm) and busy-waits the last
+ * SEQ_SPIN_US, the reported start time therefore deviates only by a few microseconds.
+ *
+ * Steps:
+ * - SEQ_STEP_CONFIG  d0 d1 baud   reconfigure the tag and the receiver
+ * - SEQ_STEP_POWER   dBm          carrier output power
+ * - SEQ_STEP_FRAMES  count len    send count frames back to back with len payload bytes
+ * - SEQ_STEP_PAUSE   duration_us
+ *
+ * After every step a result is reported (as text line "seq | ..." or as binary PROTOCOL_RESULT frame).
+ *
+ */
+
+#ifndef SEQUENCER_LIB
+#define SEQUENCER_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "receiver_CC2500.h"
+#include "bit_errors.h"
+
+#define SEQ_MAX_STEPS     32
+#define SEQ_SPIN_US      200 // busy-wait before a timed step (covers the alarm and wake-up latency)
+#define SEQ_MAX_FRAMES 10000 // per step
+
+enum seq_step_type {
+  SEQ_STEP_CONFIG = 1,
+  SEQ_STEP_POWER,
+  SEQ_STEP_FRAMES,
+  SEQ_STEP_PAUSE
+};
+
+struct seq_step {
+  uint8_t  type;
+  uint32_t start_us;    // offset from the start of the iteration, 0: after the previous step
+  uint32_t arg[3];
+};
+
+/* reported after every step (in this order as values of a PROTOCOL_RESULT frame) */
+struct seq_result {
+  uint32_t iteration;
+  uint32_t step;
+  uint32_t type;
+  uint32_t status;      // 0: ok, 1: rejected (configuration)
+  uint32_t start_us;    // actual start, relative to the iteration
+  uint32_t late_us;     // actual - planned start (timed steps)
+  uint32_t duration_us;
+  uint32_t sent;
+  uint32_t received;
+  uint32_t crc_pass;
+  uint32_t bit_errors;
+  uint32_t bits;
+  int32_t  rssi;        // mean of the received frames
+};
+
+struct sequencer {
+  struct seq_step   steps[SEQ_MAX_STEPS];
+  uint8_t           count;
+  bool              running;
+  bool              binary;       // report results as PROTOCOL_RESULT frames
+  uint8_t           current;
+  bool              started;      // the current step has started
+  uint32_t          iteration;
+  uint32_t          repeat;
+  uint64_t          iteration_start_us;
+  uint64_t          step_start_us;
+  uint8_t           result_seq;
+  int32_t           rssi_sum;
+  struct seq_result result;
+  struct ber_engine ber;
+  uint8_t           pattern;      // payload byte
+};
+
+void seq_init(struct sequencer *seq, uint8_t pattern);
+
+/* sequence editing (not while running), returns false if the step is invalid or the list is full */
+bool seq_add_step(struct sequencer *seq, struct seq_step step);
+void seq_clear(struct sequencer *seq);
+
+bool seq_start(struct sequencer *seq, uint32_t repeat, bool binary, uint64_t time_us);
+void seq_stop(struct sequencer *seq);
+
+const struct seq_step *seq_current(const struct sequencer *seq);
+
+/* start time of the current step (before it has started) */
+uint64_t seq_due_us(const struct sequencer *seq);
+
+void seq_step_begin(struct sequencer *seq, uint64_t time_us);
+
+void seq_step_rejected(struct sequencer *seq);
+
+void seq_sent(struct sequencer *seq);
+
+void seq_received(struct sequencer *seq, const uint8_t *packet, Packet_status status);
+
+/* time at which the current step is done (SEQ_STEP_PAUSE), otherwise 0 */
+uint64_t seq_step_end_us(const struct sequencer *seq);
+
+bool seq_step_done(const struct sequencer *seq, uint64_t time_us);
+
+/* report the result of the current step and advance, returns false once the sequence is finished */
+bool seq_next_step(struct sequencer *seq, uint64_t time_us);
+
+#endif
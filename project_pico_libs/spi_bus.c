@@ -0,0 +1,267 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Prioritised SPI bus (see spi_bus.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "spi_bus.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#define SPI_BUS_MAX_BUSES   2 // spi0, spi1
+
+// queues of all buses: submitted from both cores and from interrupt handlers, modified in the DMA interrupt
+static critical_section_t lock;
+static struct spi_bus *buses[SPI_BUS_MAX_BUSES];
+static uint8_t bus_count = 0;
+
+static struct spi_bus_device *find_device(struct spi_bus *bus, uint8_t csn) {
+    for(uint8_t i = 0; i < bus->device_count; i++){
+        if(bus->devices[i].csn == csn){
+            return &bus->devices[i];
+        }
+    }
+    if(bus->device_count >= SPI_BUS_MAX_DEVICES){
+        return NULL;
+    }
+    struct spi_bus_device *device = &bus->devices[bus->device_count++];
+    device->csn  = csn;
+    device->head = -1;
+    device->tail = -1;
+    return device;
+}
+
+// priority of the first transaction of a device: the most urgent one queued behind it
+static uint8_t effective_priority(struct spi_bus *bus, struct spi_bus_device *device) {
+    uint8_t priority = SPI_PRIO_COUNT;
+    for(int8_t i = device->head; i >= 0; i = bus->slots[i].next){
+        priority = min(priority, bus->slots[i].request.priority);
+    }
+    return priority;
+}
+
+// requires the lock and an idle bus
+static void start_next(struct spi_bus *bus) {
+    struct spi_bus_device *next = NULL;
+    uint8_t next_priority = SPI_PRIO_COUNT;
+    for(uint8_t i = 0; i < bus->device_count; i++){
+        struct spi_bus_device *device = &bus->devices[i];
+        if(device->head < 0){
+            continue;
+        }
+        uint8_t priority = effective_priority(bus, device);
+        // equal priority: the earlier submission
+        if(next == NULL || priority < next_priority ||
+           (priority == next_priority && bus->slots[device->head].submit_us < bus->slots[next->head].submit_us)){
+            next          = device;
+            next_priority = priority;
+        }
+    }
+    if(next == NULL){
+        bus->active = -1;
+        return;
+    }
+    int8_t index = next->head;
+    struct spi_slot *slot = &bus->slots[index];
+    next->head = slot->next;
+    if(next->head < 0){
+        next->tail = -1;
+    }
+    bus->active          = index;
+    bus->active_start_us = time_us_64();
+
+    uint32_t wait = (uint32_t) (bus->active_start_us - slot->submit_us);
+    struct spi_bus_priority_stats *s = &bus->stats.priority[slot->request.priority];
+    s->transactions++;
+    s->sum_wait_us += wait;
+    s->max_wait_us  = max(s->max_wait_us, wait);
+    s->bytes       += slot->request.len;
+
+    dma_channel_config rx_config = dma_channel_get_default_config(bus->dma_rx);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_dreq(&rx_config, spi_get_dreq(bus->spi, false));
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, slot->request.rx != NULL);
+    dma_channel_config tx_config = dma_channel_get_default_config(bus->dma_tx);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
+    channel_config_set_dreq(&tx_config, spi_get_dreq(bus->spi, true));
+    channel_config_set_write_increment(&tx_config, false);
+
+    gpio_put(slot->request.csn, 0); // active low
+    dma_channel_configure(bus->dma_rx, &rx_config, (slot->request.rx != NULL) ? slot->request.rx : &bus->discard,
+                          &spi_get_hw(bus->spi)->dr, slot->request.len, false);
+    dma_channel_configure(bus->dma_tx, &tx_config, &spi_get_hw(bus->spi)->dr, slot->tx, slot->request.len, false);
+    dma_start_channel_mask((1u << bus->dma_tx) | (1u << bus->dma_rx));
+}
+
+// the last byte has been received: the transfer is complete, requires the lock
+static struct spi_request complete(struct spi_bus *bus) {
+    struct spi_slot *slot = &bus->slots[bus->active];
+    struct spi_request request = slot->request;
+    gpio_put(request.csn, 1);
+    bus->stats.busy_us += time_us_64() - bus->active_start_us;
+    slot->next = bus->free;
+    bus->free  = bus->active;
+    start_next(bus);
+    return request;
+}
+
+// the callbacks run without the lock (they may submit the next transaction)
+static void dma_handler() {
+    for(uint8_t i = 0; i < bus_count; i++){
+        struct spi_bus *bus = buses[i];
+        if(!dma_channel_get_irq0_status(bus->dma_rx)){
+            continue;
+        }
+        dma_channel_acknowledge_irq0(bus->dma_rx);
+        critical_section_enter_blocking(&lock);
+        struct spi_request request = complete(bus);
+        critical_section_exit(&lock);
+        if(request.done != NULL){
+            *request.done = true;
+        }
+        if(request.callback != NULL){
+            request.callback(request.context);
+        }
+    }
+}
+
+void spi_bus_init(struct spi_bus *bus, spi_inst_t *spi) {
+    memset(bus, 0, sizeof(struct spi_bus));
+    bus->spi    = spi;
+    bus->active = -1;
+    for(uint8_t i = 0; i < SPI_BUS_QUEUE_LENGTH; i++){
+        bus->slots[i].next = (i + 1 < SPI_BUS_QUEUE_LENGTH) ? i + 1 : -1;
+    }
+    bus->free   = 0;
+    bus->dma_tx = dma_claim_unused_channel(true);
+    bus->dma_rx = dma_claim_unused_channel(true);
+    bus->stats.window_start_us = time_us_64();
+    if(bus_count == 0){
+        critical_section_init(&lock);
+        irq_add_shared_handler(DMA_IRQ_0, dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+    }
+    if(bus_count < SPI_BUS_MAX_BUSES){
+        buses[bus_count++] = bus;
+    }
+    dma_channel_set_irq0_enabled(bus->dma_rx, true);
+}
+
+static bool valid(const struct spi_request *request) {
+    return request->len > 0 && request->len <= SPI_BUS_MAX_LEN && request->priority < SPI_PRIO_COUNT;
+}
+
+// count_full: a waiting submission is counted once (not on every retry)
+static bool enqueue(struct spi_bus *bus, const struct spi_request *request, bool count_full) {
+    critical_section_enter_blocking(&lock);
+    struct spi_bus_device *device = find_device(bus, request->csn);
+    if(bus->free < 0 || device == NULL){
+        if(count_full){
+            bus->stats.full++;
+        }
+        critical_section_exit(&lock);
+        return false;
+    }
+    int8_t index = bus->free;
+    struct spi_slot *slot = &bus->slots[index];
+    bus->free = slot->next;
+    slot->request   = *request;
+    slot->submit_us = time_us_64();
+    slot->next      = -1;
+    memcpy(slot->tx, request->tx, request->len);
+    if(device->tail >= 0){
+        bus->slots[device->tail].next = index;
+    }else{
+        device->head = index;
+    }
+    device->tail = index;
+    if(bus->active < 0){
+        start_next(bus);
+    }
+    critical_section_exit(&lock);
+    return true;
+}
+
+bool spi_bus_submit(struct spi_bus *bus, const struct spi_request *request) {
+    if(!valid(request)){
+        return false;
+    }
+    return enqueue(bus, request, true);
+}
+
+// a full queue drains within microseconds: wait for a slot (counted once)
+static bool enqueue_waiting(struct spi_bus *bus, const struct spi_request *request) {
+    if(!valid(request)){
+        return false;
+    }
+    bool first = true;
+    while(!enqueue(bus, request, first)){
+        first = false;
+        tight_loop_contents();
+    }
+    return true;
+}
+
+// an interrupt handler of this core must not wait: it would delay the DMA interrupt which frees the slots
+bool spi_bus_post(struct spi_bus *bus, uint8_t csn, uint8_t priority, const uint8_t *tx, uint8_t len) {
+    struct spi_request request = {.csn = csn, .priority = priority, .len = len, .tx = tx};
+    if(__get_current_exception() != 0){
+        return spi_bus_submit(bus, &request);
+    }
+    return enqueue_waiting(bus, &request);
+}
+
+void spi_bus_transfer(struct spi_bus *bus, uint8_t csn, uint8_t priority, const uint8_t *tx, uint8_t *rx, uint8_t len) {
+    volatile bool done = false;
+    struct spi_request request = {.csn = csn, .priority = priority, .len = len, .tx = tx, .rx = rx, .done = &done};
+    if(!enqueue_waiting(bus, &request)){
+        return;
+    }
+    while(!done){
+        tight_loop_contents();
+    }
+}
+
+void spi_bus_sync(struct spi_bus *bus, uint8_t csn) {
+    while(true){
+        critical_section_enter_blocking(&lock);
+        struct spi_bus_device *device = find_device(bus, csn);
+        bool pending = (device != NULL && device->head >= 0) || (bus->active >= 0 && bus->slots[bus->active].request.csn == csn);
+        critical_section_exit(&lock);
+        if(!pending){
+            return;
+        }
+        tight_loop_contents();
+    }
+}
+
+void spi_bus_report(struct spi_bus *bus) {
+    static const char *names[SPI_PRIO_COUNT] = {"fifo", "strobe", "config"};
+    critical_section_enter_blocking(&lock);
+    struct spi_bus_stats stats = bus->stats;
+    memset(&bus->stats, 0, sizeof(struct spi_bus_stats));
+    bus->stats.window_start_us = time_us_64();
+    critical_section_exit(&lock);
+
+    uint64_t elapsed     = max(bus->stats.window_start_us - stats.window_start_us, (uint64_t) 1);
+    uint32_t utilisation = (uint32_t) ((stats.busy_us * 10000) / elapsed);
+    printf("spibus | window %u ms | utilisation %u.%02u%% | queue full %u\n", (uint32_t) (elapsed / 1000), utilisation / 100, utilisation % 100, stats.full);
+    for(uint8_t i = 0; i < SPI_PRIO_COUNT; i++){
+        struct spi_bus_priority_stats *s = &stats.priority[i];
+        printf("spibus | %-6s transactions %u bytes %llu | queueing [us] mean %u max %u\n", names[i], s->transactions, s->bytes,
+               s->transactions ? (uint32_t) (s->sum_wait_us / s->transactions) : 0, s->max_wait_us);
+    }
+}
@@ -0,0 +1,128 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Prioritised SPI bus (build option SPI_BUS): the radios sharing one SPI instance queue their transactions instead
+ * of taking the bus synchronously. A transaction (chip select, bytes to send, optional destination of the received
+ * bytes) runs through two DMA channels, the DMA interrupt releases the chip select and starts the next one:
+ * - the next transaction is the most urgent one (SPI_PRIO_FIFO > SPI_PRIO_STROBE > SPI_PRIO_CONFIG)
+ * - the transactions of one device keep their order, the first one inherits the priority of the most urgent one
+ *   queued behind it (a FIFO read is never overtaken by, but also never waits behind, the other radio)
+ * An RX FIFO read therefore waits at most for the transaction in flight (SPI_BUS_MAX_LEN bytes, 110 us at 5 MHz)
+ * and for earlier transactions of the receiver itself, however much the carrier is being reconfigured.
+ *
+ * Writes and strobes are posted: spi_bus_post copies the bytes and returns (also from interrupt handlers),
+ * reads wait for their result (spi_bus_transfer, not from interrupt handlers) or complete with a callback in the
+ * DMA interrupt (spi_bus_submit). Per priority, the queueing delay (submit -> start) and the bus utilisation
+ * are recorded.
+ *
+ * Without SPI_BUS (or without a bus of the radio), the drivers use the blocking SDK functions as before.
+ *
+ */
+
+#ifndef SPI_BUS_LIB
+#define SPI_BUS_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+
+#ifndef SPI_BUS
+#define SPI_BUS 0
+#endif
+
+#define SPI_BUS_QUEUE_LENGTH   32
+#define SPI_BUS_MAX_LEN        68 // header, 64 FIFO bytes, status bytes
+#define SPI_BUS_MAX_DEVICES     4
+
+enum spi_priority {
+  SPI_PRIO_FIFO = 0, // RX/TX FIFO access
+  SPI_PRIO_STROBE,   // command strobes and status registers
+  SPI_PRIO_CONFIG,   // configuration registers, PATABLE
+  SPI_PRIO_COUNT
+};
+
+/* called in the DMA interrupt after the chip select has been released */
+typedef void (*spi_bus_callback)(void *context);
+
+struct spi_request {
+  uint8_t           csn;
+  uint8_t           priority;
+  uint8_t           len;
+  const uint8_t    *tx;       // copied on submit
+  uint8_t          *rx;       // NULL: discard the received bytes
+  volatile bool    *done;     // optional: set on completion
+  spi_bus_callback  callback; // optional
+  void             *context;
+};
+
+struct spi_slot {
+  struct spi_request request;
+  uint8_t            tx[SPI_BUS_MAX_LEN];
+  uint64_t           submit_us;
+  int8_t             next;    // next slot of the same device (or of the free list), -1: none
+};
+
+struct spi_bus_priority_stats {
+  uint32_t transactions;
+  uint64_t sum_wait_us;
+  uint32_t max_wait_us;
+  uint64_t bytes;
+};
+
+struct spi_bus_stats {
+  struct spi_bus_priority_stats priority[SPI_PRIO_COUNT];
+  uint32_t full;              // submissions rejected (queue full)
+  uint64_t busy_us;           // chip select asserted
+  uint64_t window_start_us;
+};
+
+struct spi_bus_device {
+  uint8_t csn;
+  int8_t  head, tail;         // queued slots (in order)
+};
+
+struct spi_bus {
+  spi_inst_t            *spi;
+  uint                   dma_tx, dma_rx;
+  struct spi_slot        slots[SPI_BUS_QUEUE_LENGTH];
+  int8_t                 free;
+  struct spi_bus_device  devices[SPI_BUS_MAX_DEVICES];
+  uint8_t                device_count;
+  volatile int8_t        active;       // slot in flight, -1: idle
+  uint64_t               active_start_us;
+  uint8_t                discard;      // DMA destination of discarded bytes
+  struct spi_bus_stats   stats;
+};
+
+#if SPI_BUS
+
+/* claim two DMA channels and the DMA interrupt for a bus (call after spi_init, before the drivers use it) */
+void spi_bus_init(struct spi_bus *bus, spi_inst_t *spi);
+
+/* queue a transaction (interrupt-safe, never blocks), false if the queue is full or the request invalid */
+bool spi_bus_submit(struct spi_bus *bus, const struct spi_request *request);
+
+/* queue a write (the bytes are copied): waits for a free slot outside of interrupt handlers, returns false if dropped */
+bool spi_bus_post(struct spi_bus *bus, uint8_t csn, uint8_t priority, const uint8_t *tx, uint8_t len);
+
+/* queue a transaction and wait for its completion (not from interrupt handlers) */
+void spi_bus_transfer(struct spi_bus *bus, uint8_t csn, uint8_t priority, const uint8_t *tx, uint8_t *rx, uint8_t len);
+
+/* wait until all queued transactions of the device have completed (e.g. before a delay after a strobe) */
+void spi_bus_sync(struct spi_bus *bus, uint8_t csn);
+
+/* print "spibus | ..." (utilisation, queueing delay per priority) and restart the statistics */
+void spi_bus_report(struct spi_bus *bus);
+
+#else
+
+// never called: without SPI_BUS, the radios have no bus
+static inline bool spi_bus_post(struct spi_bus *bus, uint8_t csn, uint8_t priority, const uint8_t *tx, uint8_t len) { return false; }
+static inline void spi_bus_transfer(struct spi_bus *bus, uint8_t csn, uint8_t priority, const uint8_t *tx, uint8_t *rx, uint8_t len) {}
+static inline void spi_bus_sync(struct spi_bus *bus, uint8_t csn) {}
+static inline void spi_bus_report(struct spi_bus *bus) {}
+
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Tag clock pre-compensation (see tag_calibration.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "receiver_CC2500.h"
+#include "tag_calibration.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+static int32_t round_div(int64_t numerator, int64_t denominator) {
+    return (int32_t) ((numerator >= 0) ? (numerator + denominator/2) / denominator : (numerator - denominator/2) / denominator);
+}
+
+void tag_cal_init(struct tag_calibration *cal) {
+    memset(cal, 0, sizeof(struct tag_calibration));
+}
+
+void tag_cal_restore(struct tag_calibration *cal, bool valid, int32_t offset_hz) {
+    tag_cal_init(cal);
+    cal->valid     = valid;
+    cal->offset_hz = valid ? offset_hz : 0;
+}
+
+void tag_cal_start(struct tag_calibration *cal) {
+    cal->freqest_sum = 0;
+    cal->frames      = 0;
+    cal->sent        = 0;
+}
+
+void tag_cal_add(struct tag_calibration *cal, bool received, int8_t freqest) {
+    cal->sent++;
+    if(received){
+        cal->freqest_sum += freqest;
+        cal->frames++;
+    }
+}
+
+bool tag_cal_finish(struct tag_calibration *cal) {
+    if(cal->frames < TAG_CAL_MIN_FRAMES){
+        return false;
+    }
+    // mean FREQEST in Hz (F_XOSC/2^14 per step)
+    cal->offset_hz = round_div((int64_t) F_XOSC * cal->freqest_sum, ((int64_t) cal->frames) << 14);
+    cal->valid     = true;
+    return true;
+}
+
+void tag_cal_split(struct tag_calibration *cal, uint32_t center_offset) {
+    cal->frac         = 0;
+    cal->tag_shift_hz = 0;
+    if(cal->valid && cal->offset_hz > 0 && (uint32_t) cal->offset_hz < center_offset){
+        // center*256/(256+frac) = center - offset
+        int32_t frac = round_div((int64_t) cal->offset_hz * 256, (int64_t) center_offset - cal->offset_hz);
+        cal->frac         = (uint8_t) min(frac, TAG_CAL_MAX_FRAC);
+        cal->tag_shift_hz = round_div((int64_t) center_offset * cal->frac, 256 + cal->frac);
+    }
+    int32_t remaining = cal->valid ? cal->offset_hz - cal->tag_shift_hz : 0;
+    int32_t freqoff   = round_div(((int64_t) remaining) << 14, F_XOSC);
+    cal->freqoff      = (int8_t) max(-AFC_MAX_FREQOFF, min(AFC_MAX_FREQOFF, freqoff));
+    cal->residual_hz  = remaining - AFC_STEP_HZ(cal->freqoff);
+}
+
+void tag_cal_apply(const struct tag_calibration *cal, PIO pio, uint sm, struct afc_state *afc) {
+    pio_sm_set_clkdiv_int_frac(pio, sm, 1, cal->frac);
+    afc_set_offset_rx(afc, cal->freqoff);
+}
+
+uint32_t tag_cal_airtime_us(const struct tag_calibration *cal, uint32_t airtime_us) {
+    return (uint32_t) (((uint64_t) airtime_us * (256 + cal->frac) + 255) / 256);
+}
+
+void tag_cal_print(const struct tag_calibration *cal, uint32_t baud) {
+    if(!cal->valid){
+        printf("calibration | none\n");
+        return;
+    }
+    printf("calibration | offset %d Hz | tag: clock divider 1+%u/256, %d Hz, baud %u | receiver: FSCTRL0 %d (%d Hz) | residual %d Hz\n",
+           cal->offset_hz, cal->frac, cal->tag_shift_hz, (uint32_t) (((uint64_t) baud * 256) / (256 + cal->frac)),
+           cal->freqoff, AFC_STEP_HZ(cal->freqoff), cal->residual_hz);
+}
@@ -0,0 +1,68 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Tag clock pre-compensation: the subcarrier offsets CLKFREQ/d0 and CLKFREQ/d1 assume exactly 125 MHz, every
+ * crystal error (tag, carrier and receiver) shifts the received tones. The offset is measured by the receiver
+ * (mean FREQEST of CRC-valid frames, with FSCTRL0 = 0) and compensated before the frame is sent:
+ * - tag: the PIO clock divider 1 + frac/256 lowers the subcarrier (and the baud-rate) by the factor 256/(256+frac).
+ *   A divider cannot speed the clock up and one step shifts the subcarrier by ~0.4 % (~19 kHz at 4.8 MHz),
+ *   hence only positive offsets of at least half a step are compensated on the tag, at most TAG_CAL_MAX_FRAC steps.
+ *   The fractional divider repeats a PIO cycle every 256/frac cycles (8 ns phase jitter of the subcarrier).
+ * - receiver: the remaining offset (below one divider step or negative) is the start value of the frequency
+ *   tracking (FSCTRL0, 1587 Hz steps).
+ * The measured offset (Hz) is stored per board and split again for every configuration (center offset).
+ *
+ */
+
+#ifndef TAG_CALIBRATION_LIB
+#define TAG_CALIBRATION_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "receiver_CC2500.h"
+
+#define TAG_CAL_FRAMES        50 // frames sent for a calibration
+#define TAG_CAL_MIN_FRAMES    10 // CRC-valid frames required
+#define TAG_CAL_MAX_FRAC       3 // PIO clock divider <= 1 + 3/256 (baud-rate -1.2 %)
+
+struct tag_calibration {
+  bool     valid;
+  int32_t  offset_hz;       // measured offset of the received tones (received - expected)
+  /* measurement */
+  int32_t  freqest_sum;
+  uint16_t frames;
+  uint16_t sent;
+  /* split for the active configuration (tag_cal_split) */
+  uint8_t  frac;            // PIO clock divider 1 + frac/256
+  int32_t  tag_shift_hz;    // compensated by the tag
+  int8_t   freqoff;         // FSCTRL0 start value
+  int32_t  residual_hz;     // expected remaining offset
+};
+
+void tag_cal_init(struct tag_calibration *cal);
+
+/* restore a stored calibration (valid == false: no correction) */
+void tag_cal_restore(struct tag_calibration *cal, bool valid, int32_t offset_hz);
+
+/* measurement: add one sent frame and its FREQEST (if it was received with a valid CRC) */
+void tag_cal_start(struct tag_calibration *cal);
+void tag_cal_add(struct tag_calibration *cal, bool received, int8_t freqest);
+
+/* compute the offset, false if too few frames were received (the previous calibration is kept) */
+bool tag_cal_finish(struct tag_calibration *cal);
+
+/* split the offset into tag and receiver correction for a subcarrier center offset [Hz] */
+void tag_cal_split(struct tag_calibration *cal, uint32_t center_offset);
+
+/* apply the split: PIO clock divider of the state-machine and FSCTRL0 */
+void tag_cal_apply(const struct tag_calibration *cal, PIO pio, uint sm, struct afc_state *afc);
+
+/* airtime of a frame with the slower symbol clock of the tag correction */
+uint32_t tag_cal_airtime_us(const struct tag_calibration *cal, uint32_t airtime_us);
+
+/* print "calibration | ..." */
+void tag_cal_print(const struct tag_calibration *cal, uint32_t baud);
+
+#endif
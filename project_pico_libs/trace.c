@@ -0,0 +1,47 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Hot-path event trace (see trace.h)
+ *
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "trace.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+struct trace_ring trace_rings[TRACE_CORES];
+volatile bool trace_enabled = true;
+
+static const char *event_names[TRACE_EVENT_COUNT] = {
+    "-", "GDO0_RISE", "GDO0_FALL", "READ_PACKET", "READ_PACKET_DONE", "PRINT_PACKET", "PRINT_PACKET_DONE",
+    "RX_LISTEN", "CARRIER_START", "CARRIER_ON", "CARRIER_STOP", "BACKSCATTER_START", "BACKSCATTER_DONE",
+    "TASK_START", "TASK_END"
+};
+
+/*
+ * Printing takes far longer than the rings hold, the trace is therefore paused meanwhile. The other core may still
+ * finish the record it started before the pause (a few cycles), the wait below covers it.
+ */
+void trace_dump() {
+    trace_enabled = false;
+    busy_wait_us(10);
+    for(uint8_t core = 0; core < TRACE_CORES; core++){
+        struct trace_ring *ring = &trace_rings[core];
+        uint32_t count = min(ring->head, TRACE_SIZE);
+        printf("trace | core %u | %u records (%u overwritten)\n", core, count, ring->head - count);
+        for(uint32_t i = ring->head - count; i != ring->head; i++){
+            struct trace_record *record = &ring->records[i & (TRACE_SIZE - 1)];
+            const char *name = (record->event < TRACE_EVENT_COUNT) ? event_names[record->event] : "?";
+            printf("trace | %u %10u %2u %-17s %u\n", core, record->time_us, record->event, name, record->arg);
+        }
+        ring->head = 0;
+    }
+    printf("trace | end\n");
+    trace_enabled = true;
+}
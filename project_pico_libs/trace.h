@@ -0,0 +1,89 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * Hot-path event trace (build option TRACE): trace_add writes a record (timestamp, event, argument) into a RAM
+ * ring of the calling core. A record costs a few cycles (timer read, three stores, interrupts masked meanwhile),
+ * there is no lock between the cores and nothing is printed on the hot path. When the ring is full, the oldest
+ * records are overwritten. trace_dump (command z) prints both rings and restarts the trace, the host tool
+ * carrier-receiver-baseband/trace-viewer.py renders the timeline and latency histograms.
+ *
+ * Record: | time [us] {4B, lower 32 bit of the timer, wraps after 71 minutes} | event {2B} | argument {2B} |
+ *
+ * Without TRACE, the functions below are no-ops (no code in the hot path).
+ *
+ */
+
+#ifndef TRACE_LIB
+#define TRACE_LIB
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+
+#ifndef TRACE
+#define TRACE 0
+#endif
+
+#define TRACE_SIZE   1024 // records per core (power of two)
+#define TRACE_CORES     2
+
+enum trace_event {
+  TRACE_GDO0_RISE = 1,     // argument: GDO0 pin
+  TRACE_GDO0_FALL,         // argument: GDO0 pin
+  TRACE_READ_PACKET,
+  TRACE_READ_PACKET_DONE,  // argument: packet length
+  TRACE_PRINT_PACKET,
+  TRACE_PRINT_PACKET_DONE,
+  TRACE_RX_LISTEN,         // argument: GDO0 pin
+  TRACE_CARRIER_START,
+  TRACE_CARRIER_ON,        // argument: start latency [us]
+  TRACE_CARRIER_STOP,
+  TRACE_BACKSCATTER_START, // argument: symbol words
+  TRACE_BACKSCATTER_DONE,  // argument: 0 timeout, 1 all symbols sent
+  TRACE_TASK_START,        // argument: scheduler task
+  TRACE_TASK_END,          // argument: scheduler task
+  TRACE_EVENT_COUNT
+};
+
+struct trace_record {
+  uint32_t time_us;
+  uint16_t event;
+  uint16_t arg;
+};
+
+struct trace_ring {
+  struct trace_record records[TRACE_SIZE];
+  uint32_t head; // free-running, only written by the own core
+};
+
+#if TRACE
+
+#include "hardware/sync.h"
+#include "hardware/structs/timer.h"
+
+extern struct trace_ring trace_rings[TRACE_CORES];
+extern volatile bool trace_enabled;
+
+static inline void trace_add(uint16_t event, uint16_t arg) {
+    if(!trace_enabled){
+        return;
+    }
+    uint32_t interrupts = save_and_disable_interrupts(); // an ISR on the same core must not take the same slot
+    struct trace_ring *ring = &trace_rings[get_core_num()];
+    struct trace_record *record = &ring->records[ring->head++ & (TRACE_SIZE - 1)];
+    record->time_us = timer_hw->timerawl;
+    record->event   = event;
+    record->arg     = arg;
+    restore_interrupts(interrupts);
+}
+
+/* print "trace | core time event name arg" (oldest first, per core) and restart the trace */
+void trace_dump();
+
+#else
+
+static inline void trace_add(uint16_t event, uint16_t arg) {}
+static inline void trace_dump() { printf("trace | disabled (build with -DTRACE=ON)\n"); }
+
+#endif
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * TinyUSB configuration of the USB packet stream (usb_stream.h): CDC console and vendor bulk interface.
+ * Only on the include path of builds with USB_STREAM (pico_stdio_usb brings its own configuration).
+ *
+ */
+
+#ifndef _TUSB_CONFIG_H_
+#define _TUSB_CONFIG_H_
+
+#define CFG_TUSB_RHPORT0_MODE       OPT_MODE_DEVICE
+#define CFG_TUD_ENDPOINT0_SIZE      64
+
+#define CFG_TUD_CDC                 1
+#define CFG_TUD_CDC_RX_BUFSIZE      256
+#define CFG_TUD_CDC_TX_BUFSIZE      256
+
+#define CFG_TUD_VENDOR              1
+#define CFG_TUD_VENDOR_EPSIZE       64
+#define CFG_TUD_VENDOR_RX_BUFSIZE   64
+#define CFG_TUD_VENDOR_TX_BUFSIZE   4096 // endpoint FIFO, refilled from the ring buffer
+
+#endif
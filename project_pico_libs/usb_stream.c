@@ -0,0 +1,266 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * USB packet stream (see usb_stream.h)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/stdio/driver.h"
+#include "pico/mutex.h"
+#include "pico/unique_id.h"
+#include "hardware/sync.h"
+#include "tusb.h"
+#include "receiver_CC2500.h"
+#include "usb_stream.h"
+
+#ifndef MINMAX
+#define MINMAX
+#define max(x, y) (((x) > (y)) ? (x) : (y))
+#define min(x, y) (((x) < (y)) ? (x) : (y))
+#endif
+
+#define USB_TASK_INTERVAL_US     1000
+#define CONSOLE_TIMEOUT_US     500000 // drop console output if the host does not read it
+#define MUTEX_TIMEOUT_MS         1000
+
+/* ---------------------------------------- descriptors ---------------------------------------- */
+
+enum {
+  ITF_CDC = 0,
+  ITF_CDC_DATA,
+  ITF_VENDOR,
+  ITF_COUNT
+};
+
+#define EP_CDC_NOTIFY   0x81
+#define EP_CDC_OUT      0x02
+#define EP_CDC_IN       0x82
+#define EP_VENDOR_OUT   0x03
+#define EP_VENDOR_IN    0x83
+#define CONFIG_LENGTH   (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
+
+static const tusb_desc_device_t device_descriptor = {
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = 0x0200,
+    .bDeviceClass       = TUSB_CLASS_MISC, // interface association (CDC)
+    .bDeviceSubClass    = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol    = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor           = USB_STREAM_VID,
+    .idProduct          = USB_STREAM_PID,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 1,
+    .iProduct           = 2,
+    .iSerialNumber      = 3,
+    .bNumConfigurations = 1
+};
+
+static const uint8_t configuration_descriptor[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_COUNT, 0, CONFIG_LENGTH, 0, 100),
+    TUD_CDC_DESCRIPTOR(ITF_CDC, 4, EP_CDC_NOTIFY, 8, EP_CDC_OUT, EP_CDC_IN, 64),
+    TUD_VENDOR_DESCRIPTOR(ITF_VENDOR, 5, EP_VENDOR_OUT, EP_VENDOR_IN, 64)
+};
+
+static const char *strings[] = {"", "Uppsala University", "Backscatter board", "" /* board id */, "Backscatter console", "Backscatter stream"};
+
+const uint8_t *tud_descriptor_device_cb(void) {
+    return (const uint8_t *) &device_descriptor;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index) {
+    return configuration_descriptor;
+}
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    static uint16_t descriptor[33];
+    static char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+    uint8_t length = 0;
+    if(index == 0){
+        descriptor[1] = 0x0409; // English
+        length = 1;
+    }else{
+        if(index >= count_of(strings)){
+            return NULL;
+        }
+        const char *string = strings[index];
+        if(index == 3){
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            string = serial;
+        }
+        for(; length < 32 && string[length] != 0; length++){
+            descriptor[1 + length] = string[length];
+        }
+    }
+    descriptor[0] = (TUSB_DESC_STRING << 8) | (2 * length + 2);
+    return descriptor;
+}
+
+/* ---------------------------------------- stream ---------------------------------------- */
+
+// TinyUSB is not thread-safe: every access holds the mutex (the background task skips a round if it is taken)
+static mutex_t usb_mutex;
+static repeating_timer_t usb_timer;
+
+// free-running indices: head is only written by usb_stream_add_frame, tail only with the mutex
+static uint8_t ring[USB_STREAM_BUFFER_SIZE];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static volatile bool streaming = false;
+static struct usb_stream_stats stats = {0};
+
+// move as much as possible into the endpoint FIFO (large bulk transfers), requires the mutex
+static void drain() {
+    if(!tud_vendor_mounted()){
+        return;
+    }
+    uint32_t used;
+    while((used = ring_head - ring_tail) > 0){
+        uint32_t space = tud_vendor_write_available();
+        if(space == 0){
+            break;
+        }
+        uint32_t offset  = ring_tail % USB_STREAM_BUFFER_SIZE;
+        uint32_t written = tud_vendor_write(&ring[offset], min(min(used, space), USB_STREAM_BUFFER_SIZE - offset));
+        if(written == 0){
+            break;
+        }
+        ring_tail   += written;
+        stats.bytes += written;
+    }
+    tud_vendor_write_flush();
+}
+
+// open/close requests of the reader, requires the mutex
+static void poll_reader() {
+    while(tud_vendor_available()){
+        uint8_t request;
+        tud_vendor_read(&request, 1);
+        if(request == USB_STREAM_OPEN){
+            ring_tail = ring_head; // start with the next record
+            streaming = true;
+        }else if(request == USB_STREAM_CLOSE){
+            streaming = false;
+        }
+    }
+    if(!tud_mounted()){
+        streaming = false;
+    }
+}
+
+static bool usb_background(repeating_timer_t *rt) {
+    if(mutex_try_enter(&usb_mutex, NULL)){
+        tud_task();
+        poll_reader();
+        drain();
+        mutex_exit(&usb_mutex);
+    }
+    return true;
+}
+
+static void ring_write(uint32_t position, const uint8_t *data, uint32_t length) {
+    uint32_t offset = position % USB_STREAM_BUFFER_SIZE;
+    uint32_t first  = min(length, USB_STREAM_BUFFER_SIZE - offset);
+    memcpy(&ring[offset], data, first);
+    memcpy(&ring[0], &data[first], length - first);
+}
+
+bool usb_stream_add_frame(const uint8_t *packet, Packet_status status, uint64_t time_us) {
+    uint8_t length   = status.overflowed ? 0 : min(status.len, RX_BUFFER_SIZE);
+    uint32_t sequence = stats.records++;
+    if(USB_STREAM_BUFFER_SIZE - (ring_head - ring_tail) < USB_STREAM_RECORD_SIZE + length){
+        stats.dropped++;
+        return false;
+    }
+    uint8_t header[USB_STREAM_RECORD_SIZE] = {0};
+    header[0] = USB_STREAM_SYNC;
+    header[1] = length;
+    header[2] = (status.CRCcheck ? USB_STREAM_FLAG_CRC : 0) | (status.overflowed ? USB_STREAM_FLAG_OVERFLOW : 0);
+    header[3] = (uint8_t) (int8_t) status.RSSI;
+    header[4] = status.LinkQualityIndicator;
+    memcpy(&header[8], &sequence, 4);  // little endian
+    memcpy(&header[12], &time_us, 8);
+    ring_write(ring_head, header, USB_STREAM_RECORD_SIZE);
+    ring_write(ring_head + USB_STREAM_RECORD_SIZE, packet, length);
+    __dmb(); // the record is complete before it is published
+    ring_head += USB_STREAM_RECORD_SIZE + length;
+    if(mutex_try_enter(&usb_mutex, NULL)){
+        drain();
+        mutex_exit(&usb_mutex);
+    }
+    return true;
+}
+
+bool usb_stream_active() {
+    return streaming;
+}
+
+struct usb_stream_stats usb_stream_stats() {
+    return stats;
+}
+
+void usb_stream_report() {
+    printf("stream | %s | records %u dropped %u | %llu bytes\n", streaming ? "open" : "closed", stats.records, stats.dropped, stats.bytes);
+}
+
+/* ---------------------------------------- stdio over CDC ---------------------------------------- */
+
+static void console_out_chars(const char *buf, int length) {
+    if(!mutex_try_enter_block_until(&usb_mutex, make_timeout_time_ms(MUTEX_TIMEOUT_MS))){
+        return;
+    }
+    uint64_t last_progress_us = time_us_64();
+    for(int i = 0; i < length && tud_cdc_connected();){
+        uint32_t written = tud_cdc_write(&buf[i], min((uint32_t) (length - i), tud_cdc_write_available()));
+        tud_task();
+        tud_cdc_write_flush();
+        if(written > 0){
+            i += written;
+            last_progress_us = time_us_64();
+        }else if(time_us_64() > last_progress_us + CONSOLE_TIMEOUT_US){
+            break;
+        }
+    }
+    mutex_exit(&usb_mutex);
+}
+
+static void console_out_flush(void) {
+    if(mutex_try_enter_block_until(&usb_mutex, make_timeout_time_ms(MUTEX_TIMEOUT_MS))){
+        tud_task();
+        tud_cdc_write_flush();
+        mutex_exit(&usb_mutex);
+    }
+}
+
+static int console_in_chars(char *buf, int length) {
+    int count = 0;
+    if(tud_cdc_connected() && tud_cdc_available()){
+        mutex_enter_blocking(&usb_mutex);
+        count = (int) tud_cdc_read(buf, (uint32_t) length);
+        mutex_exit(&usb_mutex);
+    }
+    return (count > 0) ? count : PICO_ERROR_NO_DATA;
+}
+
+static stdio_driver_t console_driver = {
+    .out_chars = console_out_chars,
+    .out_flush = console_out_flush,
+    .in_chars  = console_in_chars,
+#if PICO_STDIO_ENABLE_CRLF_SUPPORT
+    .crlf_enabled = PICO_STDIO_DEFAULT_CRLF
+#endif
+};
+
+bool usb_stream_console_connected() {
+    return tud_cdc_connected();
+}
+
+void usb_stream_init() {
+    mutex_init(&usb_mutex);
+    tusb_init();
+    stdio_set_driver_enabled(&console_driver, true);
+    add_repeating_timer_us(-USB_TASK_INTERVAL_US, usb_background, NULL, &usb_timer);
+}
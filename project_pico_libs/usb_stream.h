@@ -0,0 +1,82 @@
+/**
+ * Tobias Mages & Wenqing Yan
+ *
+ * USB packet stream (build option USB_STREAM): the board is a composite TinyUSB device with
+ * - a CDC interface for stdio (command console, summaries), replacing pico_stdio_usb
+ * - a vendor interface with two bulk endpoints streaming binary frame records to the host reader
+ *   (carrier-receiver-baseband/stream-reader.py)
+ *
+ * Records are appended to a RAM ring buffer without blocking and moved to the bulk endpoint in large chunks by
+ * the USB background task (every millisecond) and after every record. If the host does not keep up, whole records
+ * are dropped and counted, the receive path is never delayed. The stream is opened by the reader (it sends
+ * USB_STREAM_OPEN to the OUT endpoint), until then frames are printed on the console as before.
+ *
+ * Record (little endian, USB_STREAM_RECORD_SIZE byte header followed by length packet bytes):
+ * | sync 0xA5 {1B} | length {1B} | flags {1B} | RSSI {1B, signed} | LQI {1B} | reserved {3B} | sequence {4B} | time [us] {8B} |
+ * flags: bit 0 CRC pass, bit 1 RX FIFO overflow. Gaps in the sequence number are dropped records.
+ *
+ * Without USB_STREAM, the functions below are no-ops and stdio uses pico_stdio_usb.
+ *
+ */
+
+#ifndef USB_STREAM_LIB
+#define USB_STREAM_LIB
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "cc2500.h"
+
+#ifndef USB_STREAM
+#define USB_STREAM 0
+#endif
+
+#define USB_STREAM_VID            0xCAFE // TinyUSB test VID, change for a distributed device
+#define USB_STREAM_PID            0x4253
+#define USB_STREAM_BUFFER_SIZE     16384 // ring buffer (> 200 records of maximal length)
+#define USB_STREAM_SYNC             0xA5
+#define USB_STREAM_RECORD_SIZE        20
+#define USB_STREAM_FLAG_CRC         0x01
+#define USB_STREAM_FLAG_OVERFLOW    0x02
+#define USB_STREAM_OPEN              'S' // reader -> board
+#define USB_STREAM_CLOSE             'E'
+
+struct usb_stream_stats {
+  uint32_t records;
+  uint32_t dropped;   // ring buffer full
+  uint64_t bytes;     // handed to the bulk endpoint
+};
+
+#if USB_STREAM
+
+/* start TinyUSB and register the CDC stdio driver (after stdio_init_all) */
+void usb_stream_init();
+
+/* the console (CDC) is opened by a terminal */
+bool usb_stream_console_connected();
+
+/* the reader has opened the stream */
+bool usb_stream_active();
+
+/* append a received frame (never blocks), false if it was dropped */
+bool usb_stream_add_frame(const uint8_t *packet, Packet_status status, uint64_t time_us);
+
+struct usb_stream_stats usb_stream_stats();
+
+/* print "stream | ..." */
+void usb_stream_report();
+
+#else
+
+#include "pico/stdio_usb.h"
+
+static inline void usb_stream_init() {}
+static inline bool usb_stream_console_connected() { return stdio_usb_connected(); }
+static inline bool usb_stream_active() { return false; }
+static inline bool usb_stream_add_frame(const uint8_t *packet, Packet_status status, uint64_t time_us) { return false; }
+static inline struct usb_stream_stats usb_stream_stats() { struct usb_stream_stats stats = {0}; return stats; }
+static inline void usb_stream_report() {}
+
+#endif
+
+#endif
@@ -23,16 +23,36 @@
 #include <string.h>
 #include <stdint.h>
 #include "pico/stdlib.h"
-#include "pico/stdio_usb.h"
 #include "pico/util/queue.h"
 #include "pico/binary_info.h"
 #include "hardware/spi.h"
 #include "receiver_CC2500.h"
+#include "link_stats.h"
+#include "bit_errors.h"
+#include "diversity.h"
+#include "config_store.h"
+#include "usb_stream.h"
 #include "pico/multicore.h" 
 
 # define COMMAND_QUEUE_LENGTH 10
 
 #define CARRIER_FEQ     2450000000
+#define STATS_INTERVAL_MS    10000 // link statistics summary interval while the per-frame output is disabled (0: only on command)
+#define BER_REFERENCE  BER_SAMPLE_STREAM // expected payload: generate_data(..., true) as sent by the baseband tag
+#define BER_PATTERN             0xA5 // expected payload byte if BER_REFERENCE is BER_FIXED_PATTERN
+#define AFC_ENABLED         true // track the frequency offset of the tag (FREQEST -> FSCTRL0)
+#define DIVERSITY_RADIOS       1 // number of receivers listening to the tag (receive diversity, see README)
+#define RX2_CSN               20 // second receiver: chip select
+#define RX2_GDO0_PIN          22 // second receiver: GDO0
+#define SWEEP_COARSE_STEP    1000000 // default sweep: 12 coarse steps above the carrier guard (1.5 ... 12.5 MHz from CARRIER_FEQ)
+#define SWEEP_COARSE_STEPS        12
+#define SWEEP_FINE_STEP       200000 // then 13 fine steps around the strongest coarse bin (+-1.2 MHz)
+#define SWEEP_FINE_SPAN      1200000
+#define TAG_TX_PERIOD_MS         250 // TX_DURATION of the baseband tag
+#define SWEEP_DWELL_US        ((TAG_TX_PERIOD_MS + 5) * 1000) // RSSI peak hold per step and pass: one TX period and a frame (about 6.4s for the default sweep)
+#define PERSIST_CONFIG        true // save c/f/w changes in flash and restore them at boot ('d' restores the defaults)
+#define USB_WAIT_MS           5000 // without a persisted configuration: wait at most this long for the USB serial connection at boot (0: no wait)
+#define CONFIG_VERSION           1 // layout of struct persisted_config
 /* 
  * The following macros are defined in the generated PIO header file 
  * We define them here manually here since this example does not require a PIO state machine.
@@ -53,9 +73,21 @@ struct cmd_struct {
 typedef struct cmd_struct command_struct;
 queue_t command_queue;
 
+struct link_stats stats;
+struct ber_engine ber;
+struct spectrum_sweep spectrum;
+CC2500 radio_rx2 = {.spi = RADIO_SPI, .csn = RX2_CSN, .gdo0 = RX2_GDO0_PIN, .name = "rx2"};
+CC2500 *receivers[2] = {&radio_rx, &radio_rx2};
+struct diversity_combiner diversity;
+bool print_frames = true;
+bool config_persisted = false; // the active configuration is the one in flash (restored at boot or saved by c/f/w)
+
 void printControlInfo(){
-    printf("The configuration can be changed using the following commands:\n   h (print this help message)\n   s (start receiving)\n   t (terminate/stop receiving)\n   c A B C D (configure A=center, B=deviation, C=baud, D=bandswidth all in Hz)\n");
-    printf("The initial configuration is:\n  c 2456597222 ");  // somehow the macro sum doesn't print here
+    printf("The configuration can be changed using the following commands:\n   h (print this help message)\n   s (start receiving)\n   t (terminate/stop receiving)\n   c A B C D (configure A=center, B=deviation, C=baud, D=bandswidth all in Hz)\n   l (print link statistics, bit error rate and frequency tracking)\n   q (toggle per-frame output, summaries every %u ms while disabled)\n   f (toggle automatic frequency tracking)\n   w (sweep above the carrier, coarse then fine, and lock to the upper tag sideband)\n   w A B C D (sweep A=start, B=step in Hz, C=steps, D=passes and lock)\n   d (remove the persisted configuration, c/f/w changes are restored at boot)\n", STATS_INTERVAL_MS);
+    if(config_persisted){
+        printf("The configuration persisted in flash is active (d removes it). ");
+    }
+    printf("The default configuration is:\n  c 2456597222 ");  // somehow the macro sum doesn't print here
     printf("%u ", PIO_DEVIATION);
     printf("%u ", PIO_BAUDRATE);
     printf("%u\n\n", PIO_MIN_RX_BW);
@@ -65,6 +97,7 @@ static char command[100];
 static int buff_pos = 0;  
 
 void readInput_core1(){
+    multicore_lockout_victim_init(); // core 0 pauses this core while writing the configuration to flash
     while(true){
         /* read input, parse input and put commands into the command queue */
         int input = getchar();
@@ -109,6 +142,46 @@ void readInput_core1(){
                             cmd_event.value4 = 0;
                             queue_try_add(&command_queue, &cmd_event);
                             break;
+                        case 'd':
+                            cmd_event.cmd = 'd';
+                            cmd_event.value1 = 0;
+                            cmd_event.value2 = 0;
+                            cmd_event.value3 = 0;
+                            cmd_event.value4 = 0;
+                            queue_try_add(&command_queue, &cmd_event);
+                            break;
+                        case 'l':
+                            cmd_event.cmd = 'l';
+                            cmd_event.value1 = 0;
+                            cmd_event.value2 = 0;
+                            cmd_event.value3 = 0;
+                            cmd_event.value4 = 0;
+                            queue_try_add(&command_queue, &cmd_event);
+                            break;
+                        case 'q':
+                            cmd_event.cmd = 'q';
+                            cmd_event.value1 = 0;
+                            cmd_event.value2 = 0;
+                            cmd_event.value3 = 0;
+                            cmd_event.value4 = 0;
+                            queue_try_add(&command_queue, &cmd_event);
+                            break;
+                        case 'f':
+                            cmd_event.cmd = 'f';
+                            cmd_event.value1 = 0;
+                            cmd_event.value2 = 0;
+                            cmd_event.value3 = 0;
+                            cmd_event.value4 = 0;
+                            queue_try_add(&command_queue, &cmd_event);
+                            break;
+                        case 'w':
+                            cmd_event.cmd = 'w'; // no steps: the default coarse/fine sweep
+                            cmd_event.value1 = 0;
+                            cmd_event.value2 = 0;
+                            cmd_event.value3 = 0;
+                            cmd_event.value4 = 1;
+                            queue_try_add(&command_queue, &cmd_event);
+                            break;
                         default:
                             cmd_event.cmd = 'e'; // e for invalid input (error)
                             cmd_event.value1 = 0;
@@ -129,6 +202,14 @@ void readInput_core1(){
                         cmd_event.value4 = value4;
                         queue_try_add(&command_queue, &cmd_event);
                         break;
+                    case 'w':
+                        cmd_event.cmd = 'w';
+                        cmd_event.value1 = value1;
+                        cmd_event.value2 = value2;
+                        cmd_event.value3 = max(min(value3, SWEEP_MAX_STEPS), 1);
+                        cmd_event.value4 = max(value4, 1);
+                        queue_try_add(&command_queue, &cmd_event);
+                        break;
                     default:
                         cmd_event.cmd = 'e'; // e for invalid input (error)
                         cmd_event.value1 = 0;
@@ -147,6 +228,44 @@ void readInput_core1(){
     }
 }
 
+/* persisted configuration: the register block is restored at boot without computing it again */
+struct persisted_config {
+  uint8_t  rx_registers[PROFILE_BLOCK_SIZE]; // FREQ2 ... FSCAL1 (first receiver)
+  bool     afc;
+};
+
+void persist_configuration(){
+    if(!PERSIST_CONFIG){
+        return;
+    }
+    struct persisted_config persisted;
+    memset(&persisted, 0, sizeof(struct persisted_config));
+    cc2500_read_burst(receivers[0], PROFILE_FIRST_REGISTER, persisted.rx_registers, PROFILE_BLOCK_SIZE);
+    persisted.afc = diversity.afc[0].enabled;
+    config_persisted = config_store_save(&persisted, sizeof(struct persisted_config), CONFIG_VERSION, true);
+}
+
+// set up and configure all receivers with the same settings
+void configure_receivers(uint32_t center, uint32_t deviation, uint32_t baud, uint32_t bandwidth, bool afc_enabled){
+    for(uint8_t i = 0; i < DIVERSITY_RADIOS; i++){
+        cc2500_setup_receiver(receivers[i]);
+        cc2500_set_frequency(receivers[i], center);
+        cc2500_set_frequency_deviation(receivers[i], deviation);
+        cc2500_set_datarate(receivers[i], baud);
+        cc2500_set_filter_bandwidth(receivers[i], bandwidth);
+    }
+    diversity_init(&diversity, receivers, DIVERSITY_RADIOS, afc_enabled);
+}
+
+// set up all receivers with a persisted register block
+void restore_receivers(const struct persisted_config *persisted){
+    for(uint8_t i = 0; i < DIVERSITY_RADIOS; i++){
+        cc2500_setup_receiver(receivers[i]);
+        cc2500_write_burst(receivers[i], PROFILE_FIRST_REGISTER, persisted->rx_registers, PROFILE_BLOCK_SIZE);
+    }
+    diversity_init(&diversity, receivers, DIVERSITY_RADIOS, persisted->afc);
+}
+
 void do_commands(){
     if(!queue_is_empty(&command_queue)){
         command_struct cmd_event;
@@ -159,19 +278,81 @@ void do_commands(){
                     printControlInfo();
                     break;
                 case 's':
-                    RX_start_listen();
+                    diversity_start_listen(&diversity);
                     break;
                 case 't':
-                    RX_stop_listen();
+                    diversity_stop_listen(&diversity);
                     break;
                 case 'c':
-                    RX_stop_listen();
-                    setupReceiver();
-                    set_frecuency_rx(cmd_event.value1);
-                    set_frequency_deviation_rx(cmd_event.value2);
-                    set_datarate_rx(cmd_event.value3);
-                    set_filter_bandwidth_rx(cmd_event.value4);
-                    RX_start_listen();
+                    diversity_stop_listen(&diversity);
+                    configure_receivers(cmd_event.value1, cmd_event.value2, cmd_event.value3, cmd_event.value4, diversity.afc[0].enabled);
+                    ber_new_configuration(&ber, stats.total.lost);
+                    link_stats_init(&stats, to_us_since_boot(get_absolute_time())); // new configuration: restart statistics
+                    diversity_start_listen(&diversity);
+                    persist_configuration();
+                    break;
+                case 'd':
+                    config_store_erase(true);
+                    config_persisted = false;
+                    printf("Persisted configuration removed, the next boot uses the defaults.\n");
+                    break;
+                case 'l':
+                    link_stats_report(&stats, to_us_since_boot(get_absolute_time()));
+                    ber_report(&ber, stats.total.lost);
+                    diversity_report(&diversity);
+                    usb_stream_report();
+                    break;
+                case 'f':
+                    diversity_stop_listen(&diversity);
+                    diversity_init(&diversity, receivers, DIVERSITY_RADIOS, !diversity.afc[0].enabled);
+                    afc_print_rx(&diversity.afc[0]);
+                    diversity_start_listen(&diversity);
+                    persist_configuration();
+                    break;
+                case 'q':
+                    print_frames = !print_frames;
+                    printf("Per-frame output %s.\n", print_frames ? "enabled" : "disabled");
+                    break;
+                case 'w':
+                    diversity_stop_listen(&diversity);
+                    uint64_t sweep_start = to_us_since_boot(get_absolute_time());
+                    struct subcarrier_lock lock;
+                    if(cmd_event.value3 == 0){
+                        // default: coarse over the upper side, then fine around its strongest lobe (keeps the coarse lock if the fine one fails)
+                        sweep_spectrum_rx(&spectrum, CARRIER_FEQ + SWEEP_CARRIER_GUARD, SWEEP_COARSE_STEP, SWEEP_COARSE_STEPS, 1, SWEEP_DWELL_US);
+                        print_spectrum_rx(&spectrum);
+                        lock = find_subcarrier_rx(&spectrum, CARRIER_FEQ);
+                        if(lock.found){
+                            sweep_spectrum_rx(&spectrum, lock.f_subcarrier - SWEEP_FINE_SPAN, SWEEP_FINE_STEP, 2*SWEEP_FINE_SPAN/SWEEP_FINE_STEP + 1, 1, SWEEP_DWELL_US);
+                            print_spectrum_rx(&spectrum);
+                            struct subcarrier_lock fine = find_subcarrier_rx(&spectrum, CARRIER_FEQ);
+                            if(fine.found){
+                                lock = fine;
+                            }
+                        }
+                    }else{
+                        sweep_spectrum_rx(&spectrum, cmd_event.value1, cmd_event.value2, cmd_event.value3, cmd_event.value4, SWEEP_DWELL_US);
+                        print_spectrum_rx(&spectrum);
+                        lock = find_subcarrier_rx(&spectrum, CARRIER_FEQ);
+                    }
+                    uint32_t sweep_ms = (uint32_t) ((to_us_since_boot(get_absolute_time()) - sweep_start) / 1000);
+                    if(lock.found){
+                        printf("sweep | %u ms | subcarrier %u Hz (%d dBm), noise floor %d dBm", sweep_ms, lock.f_subcarrier, lock.rssi, lock.noise_floor);
+                        if(lock.mirror_rssi != INT16_MIN){
+                            printf(", mirror %u Hz (%d dBm)", lock.f_mirror, lock.mirror_rssi);
+                        }
+                        printf("\n");
+                        for(uint8_t i = 0; i < DIVERSITY_RADIOS; i++){
+                            cc2500_set_frequency(receivers[i], lock.f_subcarrier);
+                        }
+                        diversity_init(&diversity, receivers, DIVERSITY_RADIOS, diversity.afc[0].enabled);
+                        ber_new_configuration(&ber, stats.total.lost);
+                        link_stats_init(&stats, to_us_since_boot(get_absolute_time())); // new configuration: restart statistics
+                        persist_configuration();
+                    }else{
+                        printf("sweep | %u ms | no subcarrier found (noise floor %d dBm), keeping the configuration\n", sweep_ms, lock.noise_floor);
+                    }
+                    diversity_start_listen(&diversity);
                     break;
                 default:
                     printf("Invalid command obtained.\n");
@@ -184,6 +365,7 @@ void do_commands(){
 void main() {
     // stdio init
     stdio_init_all();
+    usb_stream_init();
     // Setup USB input on second core
     queue_init(&command_queue, sizeof(command_struct), COMMAND_QUEUE_LENGTH); /* command queue setup */
     while(queue_try_remove(&command_queue, NULL));                            /* Reset the queue     */
@@ -199,44 +381,49 @@ void main() {
     bi_decl(bi_3pins_with_func(RADIO_MOSI, RADIO_MISO, RADIO_SCK, GPIO_FUNC_SPI));
 
     // Chip select is active-low, so we'll initialise it to a driven-high state
-    gpio_init(RX_CSN);
-    gpio_set_dir(RX_CSN, GPIO_OUT);
-    gpio_put(RX_CSN, 1);
+    for(uint8_t i = 0; i < DIVERSITY_RADIOS; i++){
+        cc2500_init_pins(receivers[i]);
+    }
 
     // Make the CS pin available to picotool
     bi_decl(bi_1pin_with_name(RX_CSN, "SPI CS"));
 
-    // Start receiver
-    sleep_ms(5000);
-    event_t evt = no_evt;
-    Packet_status status;
-    uint8_t buffer[RX_BUFFER_SIZE];
-    setupReceiver();
-    set_frecuency_rx(CARRIER_FEQ + PIO_CENTER_OFFSET);
-    set_frequency_deviation_rx(PIO_DEVIATION);
-    set_datarate_rx(PIO_BAUDRATE);
-    set_filter_bandwidth_rx(PIO_MIN_RX_BW);
-    sleep_ms(1);
-    RX_start_listen();
+    // Start receiver (with the persisted configuration or the defaults)
+    struct diversity_frame frame;
+    struct persisted_config persisted;
+    if(PERSIST_CONFIG && config_store_load(&persisted, sizeof(struct persisted_config), CONFIG_VERSION)){
+        restore_receivers(&persisted);
+        config_persisted = true;
+    }else{
+        if(USB_WAIT_MS > 0){
+            absolute_time_t usb_timeout = make_timeout_time_ms(USB_WAIT_MS);
+            while(!usb_stream_console_connected() && !time_reached(usb_timeout)){
+                sleep_ms(1);
+            }
+        }
+        configure_receivers(CARRIER_FEQ + PIO_CENTER_OFFSET, PIO_DEVIATION, PIO_BAUDRATE, PIO_MIN_RX_BW, AFC_ENABLED);
+        sleep_ms(1);
+    }
+    diversity_start_listen(&diversity);
+    link_stats_init(&stats, to_us_since_boot(get_absolute_time()));
+    ber_init(&ber, BER_REFERENCE, BER_PATTERN, PAYLOADSIZE);
     printControlInfo();
 
     while (true) {
         do_commands();
-        evt = get_event();
-        switch(evt){
-            case rx_assert_evt:
-                // started receiving
-            break;
-            case rx_deassert_evt:
-                // finished receiving
-                uint64_t time_us = to_us_since_boot(get_absolute_time());
-                status = readPacket(buffer);
-                printPacket(buffer,status,time_us);
-                RX_start_listen();
-            break;
-            case no_evt:
-            break;
+        // finished receiving: best copy of all receivers (the receivers listen again already)
+        if(diversity_poll(&diversity, &frame, to_us_since_boot(get_absolute_time()))){
+            link_stats_add(&stats, frame.buffer, frame.status, frame.time_us);
+            ber_add_frame(&ber, frame.buffer, frame.status);
+            if(print_frames && usb_stream_active()){
+                usb_stream_add_frame(frame.buffer, frame.status, frame.time_us);
+            }else if(print_frames){
+                printPacket(frame.buffer, frame.status, frame.time_us);
+            }
+        }else if(!print_frames && STATS_INTERVAL_MS > 0 && link_stats_window_elapsed(&stats, to_us_since_boot(get_absolute_time()), STATS_INTERVAL_MS)){
+            link_stats_report(&stats, to_us_since_boot(get_absolute_time()));
+            ber_report(&ber, stats.total.lost);
         }
     }
-    RX_stop_listen(); // never reached
+    diversity_stop_listen(&diversity); // never reached
 }